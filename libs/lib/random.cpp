@@ -32,35 +32,53 @@ RandomGen::~RandomGen()
     writeSeedFile(seedfile_);
 }
 
+static double g(double x)
+{
+  double a = 17.49731196;
+  double b = 2.36785163;
+  double c = 2.15787544;
+  double absx = fabs(x);
+  double result = a*exp(-x*x/2.0);
+  if(absx<1.0)
+    result -= 2.0*b*(3.0-x*x)+c*(1.5-absx);
+  else if(absx<1.5)
+    result -= b*(3.0-absx)*(3.0-absx)+c*(1.5-absx);
+  else
+    result -=b*(3.0-absx)*(3.0-absx);
+  return result;
+
+}
+
 //
 // Marsaglia-Bray's method, see Ripley, p. 84.
 //
-double RandomGen::rnorm01()
+template <class Source>
+static double marsagliaBray(Source & source)
 {
   double u, u1, u2, u3;
   double c, x, v1, v2, w, s, t;
 
-  u = unif01();
+  u = source.unif01();
   if(u<0.8638)
 
   {
-    u1 = unif01();
-    u2 = unif01();
-    u3 = unif01();
+    u1 = source.unif01();
+    u2 = source.unif01();
+    u3 = source.unif01();
     x = 2.0*(u1+u2+u3)-3.0;
   }
   else if(u<0.9745)
   {
-    u1 = unif01();
-    u2 = unif01();
+    u1 = source.unif01();
+    u2 = source.unif01();
     x = 1.5*(u1+u2-1.0);
   }
   else if(u<0.9973002039)
   {
     do
     {
-      u1 = unif01();
-      u2 = unif01();
+      u1 = source.unif01();
+      u2 = source.unif01();
       x = 6.0*u1-3.0;
     }
     while(0.358*u2>g(x));
@@ -71,8 +89,8 @@ double RandomGen::rnorm01()
     {
       do
       {
-        u1 = unif01();
-        u2 = unif01();
+        u1 = source.unif01();
+        u2 = source.unif01();
         v1 = 2.0*u1-1.0;
         v2 = 2.0*u2-1.0;
         w = v1*v1+v2*v2;
@@ -89,25 +107,21 @@ double RandomGen::rnorm01()
       x = t;
   }
   return x;
-
-
 }
 
-double RandomGen::g(double x)
+//
+// Gives RandomGen's static generator the interface of a stream
+//
+class RandomGenSource
 {
-  double a = 17.49731196;
-  double b = 2.36785163;
-  double c = 2.15787544;
-  double absx = fabs(x);
-  double result = a*exp(-x*x/2.0);
-  if(absx<1.0)
-    result -= 2.0*b*(3.0-x*x)+c*(1.5-absx);
-  else if(absx<1.5)
-    result -= b*(3.0-absx)*(3.0-absx)+c*(1.5-absx);
-  else
-    result -=b*(3.0-absx)*(3.0-absx);
-  return result;
+public:
+  double unif01() { return RandomGen::unif01() ;}
+};
 
+double RandomGen::rnorm01()
+{
+  RandomGenSource source;
+  return marsagliaBray(source);
 }
 
 double RandomGen::unif01()
@@ -118,6 +132,12 @@ double RandomGen::unif01()
   return x;
 }
 
+unsigned int RandomGen::drawSeed()
+{
+  seed_ = MULTIPLIER * seed_ +SHIFT;
+  return seed_;
+}
+
 int RandomGen::writeSeedFile(const std::string & filename) const
 {
   FILE *file;
@@ -134,3 +154,31 @@ int RandomGen::writeSeedFile(const std::string & filename) const
 }
 
 unsigned int RandomGen::seed_ = 23665; //Default seed
+
+RandomStream::RandomStream(unsigned int seed, unsigned int i0, unsigned int i1, unsigned int i2)
+{
+  // Each index is mixed in separately, so that e.g. (1,0) and (0,1) give unrelated streams.
+  state_ = mix(seed);
+  state_ = mix(state_ ^ i0);
+  state_ = mix(state_ ^ i1);
+  state_ = mix(state_ ^ i2);
+}
+
+double RandomStream::rnorm01()
+{
+  return marsagliaBray(*this);
+}
+
+double RandomStream::unif01()
+{
+  state_ += 0x9E3779B97F4A7C15ULL;
+  // 53 random bits, shifted half a step so that 0 and 1 are never returned
+  return (static_cast<double>(mix(state_) >> 11) + 0.5) * (1.0/9007199254740992.0);
+}
+
+unsigned long long RandomStream::mix(unsigned long long z)
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
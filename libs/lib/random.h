@@ -24,12 +24,28 @@ public:
 
   static double rnorm01();
   static double unif01();
+  static unsigned int drawSeed();   // Advances the generator and returns the new state
 
 private:
-  static double g(double x);
-
   static unsigned int seed_;
   std::string         seedfile_;
 
 };
+
+// An independent random stream, identified by a seed and up to three indices,
+// e.g. realisation, grid and plane. The numbers drawn from a stream only depend
+// on these, so streams may be used in any order and from any thread, and any
+// one of them can be regenerated alone. The stream is counter based (splitmix64).
+class RandomStream{
+public:
+  RandomStream(unsigned int seed, unsigned int i0 = 0, unsigned int i1 = 0, unsigned int i2 = 0);
+
+  double rnorm01();
+  double unif01();
+
+private:
+  static unsigned long long mix(unsigned long long z);
+
+  unsigned long long state_;
+};
 #endif
@@ -27,11 +27,19 @@
 #define BOOST_FILESYSTEM_VERSION 2
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <locale>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#ifdef PARALLEL
+#include <omp.h>
+#endif
 
 using namespace NRLib::NRLibPrivate;
 using namespace NRLib;
@@ -336,6 +344,17 @@ NRLib::FindFileSize(const std::string& filename)
 }
 
 
+long long
+NRLib::FindFileTime(const std::string& filename)
+{
+  if ( !boost::filesystem::exists(filename) ) {
+    throw IOError("File " + filename + " does not exist.");
+  }
+
+  return static_cast<long long>(boost::filesystem::last_write_time(filename));
+}
+
+
 int NRLib::FindGridFileType(const std::string& filename )
 {
   unsigned long long length = FindFileSize(filename);
@@ -561,6 +580,265 @@ float NRLib::ReadBinaryFloat(std::istream& stream,
   return f;
 }
 
+void NRLib::WriteBinaryFloatArray(std::ostream& stream,
+                                  const float* f,
+                                  size_t n,
+                                  Endianess number_representation)
+{
+  const size_t block_size = 65536;
+  std::vector<char> buffer(4*std::min(n, block_size));
+
+  for (size_t first = 0; first < n; first += block_size) {
+    size_t n_block = std::min(block_size, n - first);
+    switch (number_representation) {
+    case END_BIG_ENDIAN:
+      WriteIEEEFloatArrayBE(&buffer[0], f + first, n_block);
+      break;
+    case END_LITTLE_ENDIAN:
+      WriteIEEEFloatArrayLE(&buffer[0], f + first, n_block);
+      break;
+    default:
+      throw Exception("Invalid number representation.");
+    }
+    if (!stream.write(&buffer[0], static_cast<std::streamsize>(4*n_block))) {
+      throw Exception("Error writing to stream.");
+    }
+  }
+}
+
+
+void NRLib::ReadBinaryFloatArray(std::istream& stream,
+                                 float* f,
+                                 size_t n,
+                                 Endianess number_representation)
+{
+  if (n == 0)
+    return;
+
+  if (!stream.read(reinterpret_cast<char*>(f), static_cast<std::streamsize>(4*n))) {
+    if (stream.eof()) {
+      throw EndOfFile();
+    }
+    else {
+      throw Exception("Error reading from stream (j).");
+    }
+  }
+
+  switch (number_representation) {
+  case END_BIG_ENDIAN:
+    ParseIEEEFloatArrayBE(f, n);
+    break;
+  case END_LITTLE_ENDIAN:
+    ParseIEEEFloatArrayLE(f, n);
+    break;
+  default:
+    throw Exception("Invalid number representation.");
+  }
+}
+
+
+namespace {
+  inline bool IsBlank(char c)
+  {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+  }
+
+  size_t CountTokens(const char* begin, const char* end)
+  {
+    size_t n        = 0;
+    bool   in_token = false;
+    for (const char* p = begin; p != end; ++p) {
+      bool blank = IsBlank(*p);
+      if (!blank && !in_token)
+        ++n;
+      in_token = !blank;
+    }
+    return n;
+  }
+
+  // Parses n tokens from the text starting at p. The text must be followed by a blank
+  // or a terminating zero. Returns a pointer to the end of the last token.
+  const char* ParseFloatTokens(const char*   p,
+                               float*        f,
+                               size_t        n,
+                               size_t        first_index,
+                               std::string&  error)
+  {
+    for (size_t i = 0; i < n; ++i) {
+      while (IsBlank(*p))
+        ++p;
+      const char* token = p;
+      while (*p != '\0' && !IsBlank(*p))
+        ++p;
+      char* stop;
+      f[i] = static_cast<float>(strtod(token, &stop));
+      if (stop != p || token == p) {
+        error = "Failure during reading element " + ToString(first_index + i) +
+                " of array. Next token is " + std::string(token, p) + "\n";
+        return p;
+      }
+    }
+    return p;
+  }
+}
+
+
+void NRLib::ReadAsciiFloatArrayParallel(std::istream& stream,
+                                        float* f,
+                                        size_t n,
+                                        int n_threads)
+{
+  std::streampos start = stream.tellg();
+  if (start == std::streampos(-1)) {
+    // We must be able to go back to the end of the last value read.
+    ReadAsciiArrayFast(stream, f, n);
+    return;
+  }
+  if (n_threads < 1)
+    n_threads = 1;
+
+  const size_t block_size = 16*1024*1024;
+  const int    n_chunks   = 4*n_threads;
+
+  std::vector<char>   buffer;
+  std::vector<size_t> chunk_start(n_chunks + 1);
+  std::vector<size_t> chunk_count(n_chunks);
+  std::vector<size_t> chunk_offset(n_chunks);
+
+  size_t n_read     = 0;   // Values parsed so far
+  size_t buffer_pos = 0;   // Position of buffer[0] relative to start
+  size_t end_pos    = 0;   // Position after the last value read, relative to start
+
+  while (n_read < n) {
+    // The buffer starts with the part of a token left over from the previous block.
+    size_t n_old = buffer.size();
+    buffer.resize(n_old + block_size);
+    stream.read(&buffer[n_old], static_cast<std::streamsize>(block_size));
+    bool at_end = (static_cast<size_t>(stream.gcount()) < block_size);
+    buffer.resize(n_old + static_cast<size_t>(stream.gcount()));
+
+    size_t n_usable = buffer.size();
+    if (!at_end) {
+      while (n_usable > 0 && !IsBlank(buffer[n_usable - 1]))
+        --n_usable;
+    }
+    buffer.push_back('\0');
+
+    // Split at blanks, so that no token is shared by two chunks.
+    chunk_start[0] = 0;
+    for (int c = 1; c < n_chunks; c++) {
+      size_t pos = std::max(chunk_start[c - 1], (n_usable*c)/n_chunks);
+      while (pos < n_usable && !IsBlank(buffer[pos]))
+        ++pos;
+      chunk_start[c] = pos;
+    }
+    chunk_start[n_chunks] = n_usable;
+
+#ifdef PARALLEL
+#pragma omp parallel for num_threads(n_threads)
+#endif
+    for (int c = 0; c < n_chunks; c++)
+      chunk_count[c] = CountTokens(&buffer[0] + chunk_start[c], &buffer[0] + chunk_start[c + 1]);
+
+    size_t n_tokens = 0;
+    for (int c = 0; c < n_chunks; c++) {
+      chunk_offset[c] = n_tokens;
+      n_tokens       += chunk_count[c];
+    }
+    size_t n_wanted = std::min(n_tokens, n - n_read);
+
+    std::string err_text = "";
+#ifdef PARALLEL
+#pragma omp parallel for num_threads(n_threads)
+#endif
+    for (int c = 0; c < n_chunks; c++) {
+      if (chunk_offset[c] < n_wanted) {
+        size_t      n_chunk = std::min(chunk_count[c], n_wanted - chunk_offset[c]);
+        std::string error   = "";
+        const char* p_end   = ParseFloatTokens(&buffer[0] + chunk_start[c],
+                                               f + n_read + chunk_offset[c],
+                                               n_chunk,
+                                               n_read + chunk_offset[c],
+                                               error);
+        if (error != "") {
+#ifdef PARALLEL
+#pragma omp critical(read_ascii_float_array)
+#endif
+          err_text += error;
+        }
+        if (chunk_offset[c] + n_chunk == n_wanted)
+          end_pos = buffer_pos + static_cast<size_t>(p_end - &buffer[0]);
+      }
+    }
+    if (err_text != "")
+      throw Exception(err_text);
+
+    n_read += n_wanted;
+    if (n_read < n && at_end)
+      throw EndOfFile();
+
+    buffer.pop_back();
+    buffer.erase(buffer.begin(), buffer.begin() + n_usable);
+    buffer_pos += n_usable;
+  }
+
+  stream.clear();
+  stream.seekg(start + static_cast<std::streamoff>(end_pos));
+}
+
+
+void NRLib::WriteAsciiFloatArrayParallel(std::ostream& stream,
+                                         const float* f,
+                                         size_t n,
+                                         const char* format,
+                                         size_t values_per_line,
+                                         bool blank_before_newline,
+                                         int n_threads,
+                                         size_t n_before)
+{
+  if (n_threads < 1)
+    n_threads = 1;
+
+  const size_t block_size = 65536;
+  size_t n_blocks = (n + block_size - 1)/block_size;
+
+  std::vector<std::string> text(n_threads);
+
+  for (size_t first_block = 0; first_block < n_blocks; first_block += n_threads) {
+    int n_batch = static_cast<int>(std::min(static_cast<size_t>(n_threads), n_blocks - first_block));
+
+#ifdef PARALLEL
+#pragma omp parallel for num_threads(n_threads)
+#endif
+    for (int b = 0; b < n_batch; b++) {
+      size_t       first = (first_block + b)*block_size;
+      size_t       last  = std::min(n, first + block_size);
+      std::string& s     = text[b];
+      char         value[64];
+      s.clear();
+      s.reserve(16*(last - first));
+      for (size_t i = first; i < last; ++i) {
+        s.append(value, sprintf(value, format, f[i]));
+        if (values_per_line > 0 && (n_before + i + 1) % values_per_line == 0) {
+          if (blank_before_newline)
+            s += ' ';
+          s += '\n';
+        }
+        else {
+          s += ' ';
+        }
+      }
+    }
+
+    for (int b = 0; b < n_batch; b++) {
+      if (!stream.write(text[b].data(), static_cast<std::streamsize>(text[b].size()))) {
+        throw Exception("Error writing to stream.");
+      }
+    }
+  }
+}
+
+
 
 void NRLib::WriteBinaryDouble(std::ostream& stream,
                                double d,
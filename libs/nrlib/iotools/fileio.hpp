@@ -77,6 +77,10 @@ namespace NRLib {
   /// \return Size of file in bytes.
   unsigned long long FindFileSize(const std::string & filename);
 
+  /// \brief Finds the last modification time of a file. Throws IOError if file not found.
+  /// \return Modification time in seconds since epoch.
+  long long FindFileTime(const std::string & filename);
+
   /// \brief Find type of file, for 3D grid files.
   /// \todo Move to a suitable place.
   int FindGridFileType(const std::string& filename);
@@ -169,6 +173,30 @@ namespace NRLib {
   template <typename I>
   I ReadAsciiArrayFastRestOfFile(std::istream& stream, I begin, size_t n);
 
+  /// \brief Reads n floats written as text. The stream is read in large blocks,
+  ///        and the text of each block is parsed by n_threads threads. The stream
+  ///        is left just after the last value read, so it must be seekable.
+  /// \throw EndOfFile if the stream holds less than n values.
+  void ReadAsciiFloatArrayParallel(std::istream& stream,
+                                   float* f,
+                                   size_t n,
+                                   int n_threads = 1);
+
+  /// \brief Writes n floats as text with the printf format given, e.g. "%.4g".
+  ///        Values are separated by blanks, and a line break follows every
+  ///        values_per_line'th value, counted from n_before values already on
+  ///        the stream. With blank_before_newline set, the blank is also written
+  ///        in front of the line break. The text is formatted by n_threads threads,
+  ///        and written in order.
+  void WriteAsciiFloatArrayParallel(std::ostream& stream,
+                                    const float* f,
+                                    size_t n,
+                                    const char* format,
+                                    size_t values_per_line,
+                                    bool blank_before_newline,
+                                    int n_threads = 1,
+                                    size_t n_before = 0);
+
   // ---------------------------------
   // Binary read and write
   //
@@ -258,6 +286,20 @@ namespace NRLib {
                          size_t n,
                          Endianess number_representation = END_BIG_ENDIAN);
 
+  /// \brief Write n floats on standard IEEE format. The bytes are made in a
+  ///        buffer of limited size, so no copy of the whole array is made.
+  void WriteBinaryFloatArray(std::ostream& stream,
+                             const float* f,
+                             size_t n,
+                             Endianess number_representation = END_BIG_ENDIAN);
+
+  /// \brief Read n floats on standard IEEE format straight into f, and convert
+  ///        them in place.
+  void ReadBinaryFloatArray(std::istream& stream,
+                            float* f,
+                            size_t n,
+                            Endianess number_representation = END_BIG_ENDIAN);
+
   // ---------------------------------
   // 8-byte IEEE floating point number
   // ---------------------------------
@@ -352,6 +394,24 @@ bool IgnoreComment(std::ifstream& file,
   /// Parse IEEE double-precision float from big-endian buffer.
   inline void ParseIBMFloatBE(const char* buffer, float& f);
 
+  /// Parse n IBM floats from big-endian buffer. Gives the same values as ParseIBMFloatBE,
+  /// but has no table lookups or branches, so that the loop can be vectorized.
+  inline void ParseIBMFloatArrayBE(const char* buffer, float* f, size_t n);
+
+  /// Write n IBM floats to big-endian buffer. Gives the same bytes as writing the values
+  /// one by one, but has no table lookups or branches, so that the loop can be vectorized.
+  inline void WriteIBMFloatArrayBE(char* buffer, const float* f, size_t n);
+
+  /// Convert n IEEE floats read as raw bytes into f from big-endian (BE) or
+  /// little-endian (LE) order to native floats, in place. The loops only
+  /// shift and mask, so that they can be vectorized.
+  inline void ParseIEEEFloatArrayBE(float* f, size_t n);
+  inline void ParseIEEEFloatArrayLE(float* f, size_t n);
+
+  /// Write n IEEE floats to buffer in big-endian (BE) or little-endian (LE) order.
+  inline void WriteIEEEFloatArrayBE(char* buffer, const float* f, size_t n);
+  inline void WriteIEEEFloatArrayLE(char* buffer, const float* f, size_t n);
+
 namespace NRLibPrivate {
   /// \todo Use stdint.h if available.
   // typedef unsigned int uint32_t;
@@ -1155,6 +1215,35 @@ void NRLib::ParseIBMFloatBE(const char* buffer, float& f)
 }
 
 
+// Big endian number representation.
+void NRLib::ParseIBMFloatArrayBE(const char* buffer, float* f, size_t n)
+{
+  const unsigned char * b = reinterpret_cast<const unsigned char *>(buffer);
+  for (size_t i = 0; i < n; ++i) {
+    /*uint32_t*/ unsigned int in = (static_cast<unsigned int>(b[4*i])     << 24) |
+                                   (static_cast<unsigned int>(b[4*i + 1]) << 16) |
+                                   (static_cast<unsigned int>(b[4*i + 2]) <<  8) |
+                                    static_cast<unsigned int>(b[4*i + 3]);
+
+    // As Ibm2Ieee, with the shift of the mantissa (mt = 1 << shift) and the exponent
+    // correction (it) computed from the three leading mantissa bits instead of tables.
+    unsigned int manthi = in & 0x00ffffff;
+    unsigned int ix     = manthi >> 21;
+    unsigned int shift  = (ix < 1) + (ix < 2) + (ix < 4);
+    unsigned int iexp   = ( ( in & 0x7f000000 ) - ( 0x20c00000 + (shift << 22) ) ) << 1;
+    manthi              = ( manthi << shift ) + iexp;
+    unsigned int inabs  = in & 0x7fffffff;
+    manthi              = ( inabs > IEMAXIB ) ? IEEEMAX : manthi;
+    manthi              = manthi | ( in & 0x80000000 );
+    in                  = ( inabs < IEMINIB ) ? 0 : manthi;
+
+    NRLibPrivate::FloatAsInt tmp;
+    tmp.ui = in;
+    f[i]   = tmp.f;
+  }
+}
+
+
 // Little endian number representation.
 void NRLib::NRLibPrivate::ParseIBMFloatLE(const char* buffer, float& f)
 {
@@ -1170,6 +1259,87 @@ void NRLib::NRLibPrivate::ParseIBMFloatLE(const char* buffer, float& f)
 }
 
 
+void NRLib::ParseIEEEFloatArrayBE(float* f, size_t n)
+{
+  unsigned char * b = reinterpret_cast<unsigned char *>(f);
+  for (size_t i = 0; i < n; ++i) {
+    NRLibPrivate::FloatAsInt tmp;
+    tmp.ui = (static_cast<unsigned int>(b[4*i])     << 24) |
+             (static_cast<unsigned int>(b[4*i + 1]) << 16) |
+             (static_cast<unsigned int>(b[4*i + 2]) <<  8) |
+              static_cast<unsigned int>(b[4*i + 3]);
+    f[i] = tmp.f;
+  }
+}
+
+
+void NRLib::ParseIEEEFloatArrayLE(float* f, size_t n)
+{
+  unsigned char * b = reinterpret_cast<unsigned char *>(f);
+  for (size_t i = 0; i < n; ++i) {
+    NRLibPrivate::FloatAsInt tmp;
+    tmp.ui = (static_cast<unsigned int>(b[4*i + 3]) << 24) |
+             (static_cast<unsigned int>(b[4*i + 2]) << 16) |
+             (static_cast<unsigned int>(b[4*i + 1]) <<  8) |
+              static_cast<unsigned int>(b[4*i]);
+    f[i] = tmp.f;
+  }
+}
+
+
+void NRLib::WriteIEEEFloatArrayBE(char* buffer, const float* f, size_t n)
+{
+  unsigned char * b = reinterpret_cast<unsigned char *>(buffer);
+  for (size_t i = 0; i < n; ++i) {
+    NRLibPrivate::FloatAsInt tmp;
+    tmp.f = f[i];
+    b[4*i]     = static_cast<unsigned char>(tmp.ui >> 24);
+    b[4*i + 1] = static_cast<unsigned char>(tmp.ui >> 16);
+    b[4*i + 2] = static_cast<unsigned char>(tmp.ui >>  8);
+    b[4*i + 3] = static_cast<unsigned char>(tmp.ui);
+  }
+}
+
+
+void NRLib::WriteIEEEFloatArrayLE(char* buffer, const float* f, size_t n)
+{
+  unsigned char * b = reinterpret_cast<unsigned char *>(buffer);
+  for (size_t i = 0; i < n; ++i) {
+    NRLibPrivate::FloatAsInt tmp;
+    tmp.f = f[i];
+    b[4*i]     = static_cast<unsigned char>(tmp.ui);
+    b[4*i + 1] = static_cast<unsigned char>(tmp.ui >>  8);
+    b[4*i + 2] = static_cast<unsigned char>(tmp.ui >> 16);
+    b[4*i + 3] = static_cast<unsigned char>(tmp.ui >> 24);
+  }
+}
+
+
+void NRLib::WriteIBMFloatArrayBE(char* buffer, const float* f, size_t n)
+{
+  unsigned char * b = reinterpret_cast<unsigned char *>(buffer);
+  for (size_t i = 0; i < n; ++i) {
+    NRLibPrivate::FloatAsInt tmp;
+    tmp.f = f[i];
+    /*uint32_t*/ unsigned int in = tmp.ui;
+
+    // As Ieee2Ibm, with the mantissa multiplier (mt = 1 << shift) and the exponent
+    // offset (it) computed from the two lowest exponent bits instead of tables.
+    unsigned int ix     = ( in & 0x01800000 ) >> 23;
+    unsigned int shift  = ( ix + 1 ) & 3;
+    unsigned int iexp   = ( ( in & 0x7e000000 ) >> 1 ) + 0x21000000 + ( 0x00100000 << shift ) + ( ( ix == 3 ) << 24 );
+    unsigned int manthi = ( ( ( in & 0x007fffff ) << shift ) >> 3 );
+    manthi              = ( manthi + iexp ) | ( in & 0x80000000 );
+    in                  = ( in & 0x7fffffff ) ? manthi : 0;
+
+    b[4*i]     = static_cast<unsigned char>(in >> 24);
+    b[4*i + 1] = static_cast<unsigned char>(in >> 16);
+    b[4*i + 2] = static_cast<unsigned char>(in >>  8);
+    b[4*i + 3] = static_cast<unsigned char>(in);
+  }
+}
+
+
 // Big endian number representation.
 void NRLib::NRLibPrivate::WriteIBMFloatBE(char* buffer, float f)
 {
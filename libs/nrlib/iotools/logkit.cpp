@@ -122,24 +122,35 @@ LogKit::SetScreenLog(const std::vector<int> & levels, bool ignore_general) {
 }
 
 
+// Messages may come from several threads at once, e.g. when grids are written in parallel.
 void
 LogKit::LogMessage(int level, const std::string & message) {
-  unsigned int i;
-  n_messages_[level]++;
-  std::string new_message = prefix_[level] + message;
-  for (i=0;i<logstreams_.size();i++)
-    logstreams_[i]->LogMessage(level, new_message);
-  SendToBuffer(level,-1,new_message);
+#ifdef PARALLEL
+#pragma omp critical(logkit)
+#endif
+  {
+    unsigned int i;
+    n_messages_[level]++;
+    std::string new_message = prefix_[level] + message;
+    for (i=0;i<logstreams_.size();i++)
+      logstreams_[i]->LogMessage(level, new_message);
+    SendToBuffer(level,-1,new_message);
+  }
 }
 
 void
 LogKit::LogMessage(int level, int phase, const std::string & message) {
-  unsigned int i;
-  n_messages_[level]++;
-  std::string new_message = prefix_[level] + message;
-  for (i=0;i<logstreams_.size();i++)
-    logstreams_[i]->LogMessage(level, phase, new_message);
-  SendToBuffer(level,phase,new_message);
+#ifdef PARALLEL
+#pragma omp critical(logkit)
+#endif
+  {
+    unsigned int i;
+    n_messages_[level]++;
+    std::string new_message = prefix_[level] + message;
+    for (i=0;i<logstreams_.size();i++)
+      logstreams_[i]->LogMessage(level, phase, new_message);
+    SendToBuffer(level,phase,new_message);
+  }
 }
 
 void
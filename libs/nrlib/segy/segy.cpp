@@ -44,11 +44,19 @@
 #include "../surface/surface.hpp"
 #include "../iotools/stringtools.hpp"
 
+#ifdef PARALLEL
+#include <omp.h>
+#endif
 
-const float segyRMISSING = -99999.000;
+const float  segyRMISSING  = -99999.000;
+const size_t segyChunkSize = 64*1024*1024; // Bytes read at a time in ReadAllTraces
+const std::string segyIndexTag = "NRLib SEG-Y trace index 1";
 
 using namespace NRLib;
 
+bool        SegY::use_index_files_ = false;
+std::string SegY::index_directory_ = "";
+
 
 SegY::SegY(const std::string       & fileName,
            float                     z0,
@@ -601,7 +609,8 @@ void
 SegY::ReadAllTraces(const Volume * volume,
                     double         zPad,
                     bool           onlyVolume,
-                    bool           relative_padding)
+                    bool           relative_padding,
+                    int            n_threads)
 {
   single_trace_ = false;
   traces_.resize(n_traces_);
@@ -636,15 +645,156 @@ SegY::ReadAllTraces(const Volume * volume,
   size_t traceSize = datasize_ * nz_ + 240;
   size_t fSize = 3600 + n_traces_ * traceSize;
   long long bytesRead = 3600+traceSize;
-  for (unsigned int i=1 ; i < static_cast<unsigned int>(n_traces_) ; i++)
+
+  // The remaining traces are read from file in large chunks. Headers are parsed and samples
+  // converted by all threads, while the first thread reads the next chunk. A trace that is not
+  // complete in the chunk, or that is preceded by a new EBCDIC header, is read with ReadTrace.
+  size_t            chunkTraces = std::max(static_cast<size_t>(1), segyChunkSize/traceSize);
+  std::vector<char> buffer[2];
+  int               current     = 0;
+  size_t            i           = 1;
+  std::streampos    chunkPos    = file_.tellg();
+  size_t            nBytes      = ReadChunk(buffer[current], std::min(chunkTraces, n_traces_ - i)*traceSize);
+
+  while (i < n_traces_)
   {
-    double percentDone = bytesRead/static_cast<double>(fSize);
-    if (percentDone > nextWrite)
+    size_t nWanted = std::min(chunkTraces, n_traces_ - i);
+    size_t nClean  = 0;
+    if (dz_ != 0) { // Otherwise dz_ is set by the next trace in ReadTrace
+      while (nClean < nWanted && (nClean + 1)*traceSize <= nBytes
+             && !TraceHeader::IsEbcdicHeader(&buffer[current][nClean*traceSize]))
+        nClean++;
+    }
+    size_t         nNext     = (nClean == nWanted ? std::min(chunkTraces, n_traces_ - i - nClean) : 0);
+    size_t         nextBytes = 0;
+    std::streampos nextPos   = chunkPos;
+
+    std::vector<double>      limits(6*nClean);
+    std::vector<char>        outside(nClean, 0);
+    std::vector<std::string> errors(nClean);
+    std::vector<size_t>      jStart(nClean);
+    std::vector<size_t>      jEnd(nClean);
+    size_t                   next = 0;
+
+#ifdef PARALLEL
+#pragma omp parallel num_threads(std::max(n_threads, 1))
+#endif
     {
-      LogKit::LogMessage(LogKit::Low,"^");
-      nextWrite+=writeInterval;
+      bool reader = true;
+#ifdef PARALLEL
+      reader = (omp_get_thread_num() == 0);
+#endif
+      if (reader && nNext > 0) {
+        nextPos   = file_.tellg();
+        nextBytes = ReadChunk(buffer[1 - current], nNext*traceSize);
+      }
+      for (;;) {
+        size_t first;
+#ifdef PARALLEL
+#pragma omp critical(segy_next_traces)
+#endif
+        {
+          first = next;
+          next += 64;
+        }
+        if (first >= nClean)
+          break;
+        size_t last = std::min(first + 64, nClean);
+        for (size_t t = first ; t < last ; t++) {
+          bool outsideTrace = false;
+          try {
+            traces_[i + t] = ParseTrace(&buffer[current][t*traceSize],
+                                        volume,
+                                        zPad,
+                                        onlyVolume,
+                                        outsideTrace,
+                                        &limits[6*t],
+                                        relative_padding,
+                                        jStart[t],
+                                        jEnd[t]);
+          }
+          catch (std::exception & e) {
+            errors[t] = e.what();
+          }
+          outside[t] = outsideTrace;
+        }
+      }
     }
 
+    // The samples of the chunk are converted into one block, in trace order.
+    std::vector<size_t> offset(nClean + 1, 0);
+    for (size_t t = 0 ; t < nClean ; t++) {
+      offset[t + 1] = offset[t];
+      if (traces_[i + t] != NULL)
+        offset[t + 1] += jEnd[t] - jStart[t] + 1;
+    }
+    if (offset[nClean] > 0) {
+      float * block      = AddSampleBlock(offset[nClean]);
+      int     format     = binary_header_->GetFormat();
+      size_t  sampleSize = static_cast<size_t>(datasize_);
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 64) num_threads(std::max(n_threads, 1))
+#endif
+      for (int t = 0 ; t < static_cast<int>(nClean) ; t++) {
+        if (traces_[i + t] == NULL)
+          continue;
+        try {
+          traces_[i + t]->SetData(&buffer[current][t*traceSize + 240 + jStart[t]*sampleSize],
+                                  jStart[t], jEnd[t], format, block + offset[t]);
+        }
+        catch (std::exception & e) {
+          errors[t] = e.what();
+        }
+      }
+    }
+
+    // Errors and lack of data are handled in trace order, as when reading trace by trace.
+    for (size_t t = 0 ; t < nClean ; t++) {
+      if (errors[t] != "")
+        throw Exception(errors[t]);
+      outsideSurface = outsideSurface || (outside[t] != 0);
+
+      const double * traceLimits = &limits[6*t];
+      outsideTopBot[0] = traceLimits[0];
+      outsideTopBot[1] = traceLimits[1];
+      if (traceLimits[0] > 0.0) {
+        outsideTopBot[2] = traceLimits[2];
+        outsideTopBot[3] = traceLimits[3];
+        outsideTopBot[4] = traceLimits[4];
+      }
+      if (traceLimits[1] > 0.0) {
+        outsideTopBot[2] = traceLimits[2];
+        outsideTopBot[3] = traceLimits[3];
+        outsideTopBot[5] = traceLimits[5];
+      }
+      if (outsideTopBot[0] > outsideTopMax[0])
+        for (k=0;k<6;k++)
+          outsideTopMax[k] = outsideTopBot[k];
+      if (outsideTopBot[1] > outsideBotMax[1])
+        for (k=0;k<6;k++)
+          outsideBotMax[k] = outsideTopBot[k];
+
+      bytesRead += traceSize;
+      double percentDone = bytesRead/static_cast<double>(fSize);
+      if (percentDone > nextWrite)
+      {
+        LogKit::LogMessage(LogKit::Low,"^");
+        nextWrite+=writeInterval;
+      }
+    }
+    i += nClean;
+
+    if (nNext > 0) {
+      current  = 1 - current;
+      chunkPos = nextPos;
+      nBytes   = nextBytes;
+      continue;
+    }
+    if (i >= n_traces_)
+      break;
+
+    file_.clear();
+    file_.seekg(chunkPos + static_cast<std::streamoff>(nClean*traceSize));
     try {
       traces_[i] = ReadTrace(volume,
                              zPad,
@@ -669,6 +819,10 @@ SegY::ReadAllTraces(const Volume * volume,
     bytesRead += traceSize;
     if (duplicateHeader)
       bytesRead += 3600;
+    i++;
+
+    chunkPos = file_.tellg();
+    nBytes   = ReadChunk(buffer[current], std::min(chunkTraces, n_traces_ - i)*traceSize);
   }
   LogKit::LogMessage(LogKit::Low,"^\n");
   n_traces_ = traces_.size();
@@ -687,8 +841,151 @@ SegY::ReadAllTraces(const Volume * volume,
     throw Exception(e.what());
   }
 
+  CheckTracesFound();
+}
+
+void
+SegY::ReadTracesInVolume(const Volume * volume,
+                         double         zPad,
+                         bool           relative_padding,
+                         int            n_threads)
+{
+  single_trace_ = false;
+
+  if(file_.tellg() != static_cast<std::streampos>(3600))
+    throw(Exception("Can not read SegY traces in volume for a file where traces have already been read.\n"));
+
+  LogKit::LogMessage(LogKit::Low,"\nReading SEGY file " );
+  LogKit::LogMessage(LogKit::Low, file_name_);
+
+  TraceHeader firstHeader(trace_header_format_);
+  firstHeader.Read(file_, binary_header_->GetLino());
+  firstHeader.WriteValues();
+  file_.clear();
+  file_.seekg(3600);
+
+  ReadTraceHeaders(false);
+
+  //
+  // Find the traces inside the volume, and the samples needed from each of them.
+  //
+  bool   outsideSurface = false;
+  double outsideTopBot[6];
+  double outsideTopMax[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  double outsideBotMax[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  int    k;
+
+  std::vector<size_t> used;
+  std::vector<size_t> jStart;
+  std::vector<size_t> jEnd;
+  for (size_t i = 0 ; i < traces_.size() ; i++) {
+    if (traces_[i] == NULL)
+      continue;
+    size_t j0, j1;
+    bool   keep = FindTraceLimits(traces_[i]->GetCoord1(), traces_[i]->GetCoord2(), volume, zPad, true,
+                                  outsideSurface, outsideTopBot, relative_padding, j0, j1);
+    if (outsideTopBot[0] > outsideTopMax[0])
+      for (k=0;k<6;k++)
+        outsideTopMax[k] = outsideTopBot[k];
+    if (outsideTopBot[1] > outsideBotMax[1])
+      for (k=0;k<6;k++)
+        outsideBotMax[k] = outsideTopBot[k];
+
+    if (keep) {
+      used.push_back(i);
+      jStart.push_back(j0);
+      jEnd.push_back(j1);
+    }
+    else {
+      delete traces_[i];
+      traces_[i] = NULL;
+    }
+  }
+
+  CheckTopBotError(outsideTopMax, outsideBotMax); //Throws exception if > 0.
+
+  //
+  // Read the samples. Traces close to each other in the file are read together, as
+  // skipping a little data is cheaper than a seek. Samples are converted in parallel,
+  // into one block holding all traces.
+  //
+  int                 format     = binary_header_->GetFormat();
+  size_t              sampleSize = static_cast<size_t>(datasize_);
+  const std::streamoff maxSkip   = 1024*1024;
+
+  std::vector<std::streamoff> first(used.size());
+  std::vector<std::streamoff> last(used.size());
+  std::vector<size_t>         offset(used.size() + 1, 0);
+  std::streamoff              total = 0;
+  for (size_t t = 0 ; t < used.size() ; t++) {
+    std::streamoff start = static_cast<std::streamoff>(traces_[used[t]]->GetFilePos()); // Start of samples
+    first[t]      = start + static_cast<std::streamoff>(jStart[t]*sampleSize);
+    last[t]       = start + static_cast<std::streamoff>((jEnd[t] + 1)*sampleSize);
+    offset[t + 1] = offset[t] + jEnd[t] - jStart[t] + 1;
+    total        += last[t] - first[t];
+  }
+  float * block = AddSampleBlock(offset[used.size()]);
+
+  double writeInterval = 0.02;
+  double nextWrite = writeInterval;
+  LogKit::LogMessage(LogKit::Low,"\n  0%        20%      40%       60%       80%       100%");
+  LogKit::LogMessage(LogKit::Low,"\n  |    |    |    |    |    |    |    |    |    |    |  ");
+  LogKit::LogMessage(LogKit::Low,"\n  ^");
+
+  std::vector<char> buffer;
+  std::streamoff    bytesUsed = 0;
+  size_t            t0        = 0;
+  while (t0 < used.size()) {
+    size_t t1 = t0 + 1;
+    while (t1 < used.size() && first[t1] - last[t1 - 1] <= maxSkip
+           && static_cast<size_t>(last[t1] - first[t0]) <= segyChunkSize)
+      t1++;
+
+    file_.clear();
+    file_.seekg(first[t0]);
+    std::streamoff nBytes = static_cast<std::streamoff>(ReadChunk(buffer, static_cast<size_t>(last[t1 - 1] - first[t0])));
+
+    std::vector<std::string> errors(t1 - t0);
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 64) num_threads(std::max(n_threads, 1))
+#endif
+    for (int t = static_cast<int>(t0) ; t < static_cast<int>(t1) ; t++) {
+      SegYTrace * trace = traces_[used[t]];
+      if (last[t] - first[t0] > nBytes) {
+        errors[t - t0] = "Unexpected end of file in trace with IL=" + ToString(trace->GetInline())
+                         + " XL=" + ToString(trace->GetCrossline()) + ".";
+        continue;
+      }
+      try {
+        trace->SetData(&buffer[first[t] - first[t0]], jStart[t], jEnd[t], format, block + offset[t]);
+      }
+      catch (std::exception & e) {
+        errors[t - t0] = e.what();
+      }
+    }
+    for (size_t t = 0 ; t < errors.size() ; t++) {
+      if (errors[t] != "")
+        throw Exception(errors[t]);
+    }
+
+    bytesUsed += last[t1 - 1] - first[t0];
+    while (bytesUsed/static_cast<double>(total) > nextWrite) {
+      LogKit::LogMessage(LogKit::Low,"^");
+      nextWrite+=writeInterval;
+    }
+    t0 = t1;
+  }
+  LogKit::LogMessage(LogKit::Low,"^\n");
+  n_traces_ = traces_.size();
+
+  CheckTracesFound();
+}
+
+void
+SegY::CheckTracesFound(void) const
+{
   int count = 0;
-  for (unsigned int i=1 ; i<traces_.size() ; i++)
+  for (unsigned int i=0 ; i<traces_.size() ; i++)
     if (traces_[i] != NULL)
       count++;
   if (count == 0)
@@ -739,33 +1036,94 @@ SegY::ReadTrace(const Volume * volume,
   if (writevalues == 1)
     traceHeader.WriteValues();
 
+  size_t j0, j1;
+  if (!FindTraceLimits(traceHeader.GetCoord1(), traceHeader.GetCoord2(), volume, zPad, onlyVolume,
+                       outsideSurface, outsideTopBot, relative_padding, j0, j1)) {
+    ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
+    return(NULL);
+  }
+
+  SegYTrace * trace = NULL;
+  if (file_.eof() == false)
+  {
+    // Copy elements from j0 til j1.
+    trace = new SegYTrace(file_, j0, j1,
+                          binary_header_->GetFormat(), nz_,
+                          &traceHeader);
+  }
+  return trace;
+}
+
+SegYTrace *
+SegY::ParseTrace(const char   * buffer,
+                 const Volume * volume,
+                 double         zPad,
+                 bool           onlyVolume,
+                 bool         & outsideSurface,
+                 double       * outsideTopBot,
+                 bool           relative_padding,
+                 size_t       & j0,
+                 size_t       & j1)
+{
+  TraceHeader traceHeader(trace_header_format_);
+  traceHeader.Parse(buffer, binary_header_->GetLino());
+  CheckSampling(traceHeader);
+
+  if (!FindTraceLimits(traceHeader.GetCoord1(), traceHeader.GetCoord2(), volume, zPad, onlyVolume,
+                       outsideSurface, outsideTopBot, relative_padding, j0, j1))
+    return(NULL);
+
+  return new SegYTrace(traceHeader);
+}
+
+float *
+SegY::AddSampleBlock(size_t nSamples)
+{
+  sample_blocks_.push_back(std::vector<float>());
+  sample_blocks_.back().resize(std::max(nSamples, static_cast<size_t>(1)));
+  return(&sample_blocks_.back()[0]);
+}
+
+size_t
+SegY::ReadChunk(std::vector<char> & buffer, size_t nBytes)
+{
+  buffer.resize(nBytes);
+  if (nBytes == 0)
+    return(0);
+  file_.read(&buffer[0], static_cast<std::streamsize>(nBytes));
+  return(static_cast<size_t>(file_.gcount()));
+}
+
+bool
+SegY::FindTraceLimits(double              x,
+                      double              y,
+                      const Volume      * volume,
+                      double              zPad,
+                      bool                onlyVolume,
+                      bool              & outsideSurface,
+                      double            * outsideTopBot,
+                      bool                relative_padding,
+                      size_t            & j0,
+                      size_t            & j1) const
+{
   if (outsideTopBot != NULL) {
     outsideTopBot[0] = 0; // > 0 indicates top error
     outsideTopBot[1] = 0; // > 0 indicates bot error
   }
-  double x, y;
-  if (trace_header_format_.GetCoordSys() == TraceHeaderFormat::UTM) {
-    x = traceHeader.GetUtmx();
-    y = traceHeader.GetUtmy();
-  }
-  else if (trace_header_format_.GetCoordSys() == TraceHeaderFormat::ILXL) {
-    x = static_cast<double>(traceHeader.GetInline());
-    y = static_cast<double>(traceHeader.GetCrossline());
-  }
-  else {
+  if (trace_header_format_.GetCoordSys() != TraceHeaderFormat::UTM &&
+      trace_header_format_.GetCoordSys() != TraceHeaderFormat::ILXL) {
    throw Exception("Invalid coordinate system number ("
                    +ToString(trace_header_format_.GetCoordSys())+")");
   }
 
-  size_t j0 = 0;
-  size_t j1 = nz_-1;
+  j0 = 0;
+  j1 = nz_-1;
   float zTop, zBot;
   if (volume != NULL)
   {
     if (onlyVolume && !volume->IsInside(x,y))
     {
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
 
     try {
@@ -773,8 +1131,7 @@ SegY::ReadTrace(const Volume * volume,
     }
     catch (NRLib::Exception & ) {
       outsideSurface = true;
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
 
     try {
@@ -782,14 +1139,12 @@ SegY::ReadTrace(const Volume * volume,
     }
     catch (NRLib::Exception & ) {
       outsideSurface = true;
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
 
     if (volume->GetTopSurface().IsMissing(zTop) || volume->GetBotSurface().IsMissing(zBot))
     {
-      ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-      return(NULL);
+      return(false);
     }
   }
   else {
@@ -831,8 +1186,7 @@ SegY::ReadTrace(const Volume * volume,
     }
   }
   if (outsideTopBot != NULL && (outsideTopBot[0] > 0.0 || outsideTopBot[1] > 0.0)) {
-    ReadDummyTrace(file_,binary_header_->GetFormat(),nz_);
-    return(NULL);
+    return(false);
   }
 
   float pad;
@@ -854,15 +1208,8 @@ SegY::ReadTrace(const Volume * volume,
   if (j0 > j1)
     throw Exception(" Lower horizon above SegY region or upper horizon below SegY region");
 
-  SegYTrace * trace = NULL;
-  if (file_.eof() == false)
-  {
-    // Copy elements from j0 til j1.
-    trace = new SegYTrace(file_, j0, j1,
-                          binary_header_->GetFormat(), nz_,
-                          &traceHeader);
-  }
-  return trace;
+
+  return(true);
 }
 
 bool
@@ -880,6 +1227,13 @@ SegY::ReadHeader(TraceHeader & header)
     duplicateHeader = false;
     break;
   }
+  CheckSampling(header);
+  return duplicateHeader;
+}
+
+void
+SegY::CheckSampling(TraceHeader & header)
+{
   if (header.GetDt()/1000 != dz_) {
     if(dz_ == 0)
       dz_ = static_cast<float>(header.GetDt()/1000.0);
@@ -892,7 +1246,6 @@ SegY::ReadHeader(TraceHeader & header)
       throw(Exception(error));
     }
   }
-  return duplicateHeader;
 }
 
 void
@@ -963,7 +1316,7 @@ SegY::GetNearestTrace(std::vector<float> & trace_data,
   size_t i = geometry_->FindIndex(x, y);
 
   if (traces_[i] != NULL) {
-    trace_data = traces_[i]->GetTrace();
+    traces_[i]->GetTrace(trace_data);
     // NBNB: The 0.5f below is a shift we have introduced when reading
     // in seismic data to get data values in centre of grid cells rather
     // than on their borders. This choice and its implications need to
@@ -1321,36 +1674,72 @@ bool SortIndex(const SegYTrace * t1, const SegYTrace * t2)
 }
 
 void
-SegY::WriteAllTracesToFile(short scalcoinitial)
+SegY::WriteAllTracesToFile(short scalcoinitial, int n_threads)
 {
-  size_t i, k;
-  std::vector<float>  trace(nz_);
-  double x,y;
+  size_t i;
 
   std::sort(traces_.begin(), traces_.end(), SortILXL);
 
-  for (i = 0; i < traces_.size(); i++)
+  size_t nTraces = 0; // NULL traces are sorted last
+  while (nTraces < traces_.size() && traces_[nTraces] != NULL)
+    nTraces++;
+
+  // Traces are converted to file format in large blocks by all threads, while
+  // the first thread writes the previous block to file.
+  size_t            traceSize   = 240 + 4*nz_;
+  size_t            blockTraces = std::max(static_cast<size_t>(1), segyChunkSize/traceSize);
+  std::vector<char> buffer[2];
+  int               current     = 0;
+  size_t            nWaiting    = 0;
+  bool              writeOk     = true;
+
+  for (size_t first = 0; first < nTraces; first += blockTraces)
   {
-    if (traces_[i] != NULL)
+    int nBlock = static_cast<int>(std::min(blockTraces, nTraces - first));
+    buffer[current].resize(nBlock*traceSize);
+
+#ifdef PARALLEL
+#pragma omp parallel num_threads(std::max(n_threads, 1))
+#endif
     {
-      for (k = 0; k < nz_; k++)
-        trace[k] = traces_[i]->GetValue(k);
-
-      // write traceheader
-      x = traces_[i]->GetX();
-      y = traces_[i]->GetY();
-      TraceHeader header(trace_header_format_);
-      header.SetNSamples(nz_);
-      header.SetDt(static_cast<unsigned short>(dz_*1000));
-      header.SetScalCo(scalcoinitial);
-      header.SetUtmx(static_cast<double>(x));
-      header.SetUtmy(static_cast<double>(y));
-      header.SetInline(traces_[i]->GetInline());
-      header.SetCrossline(traces_[i]->GetCrossline());
-      header.Write(file_);
-      WriteBinaryIbmFloatArray(file_,trace.begin(),trace.end());
+      bool writer = true;
+#ifdef PARALLEL
+      writer = (omp_get_thread_num() == 0);
+#endif
+      if (writer && nWaiting > 0)
+        writeOk = writeOk && file_.write(&buffer[1 - current][0], static_cast<std::streamsize>(nWaiting*traceSize));
+
+      std::vector<float> trace(nz_);
+#ifdef PARALLEL
+#pragma omp for schedule(dynamic, 64)
+#endif
+      for (int t = 0; t < nBlock; t++)
+      {
+        const SegYTrace * segyTrace = traces_[first + t];
+        char            * out       = &buffer[current][t*traceSize];
+        for (size_t k = 0; k < nz_; k++)
+          trace[k] = segyTrace->GetValue(k);
+
+        TraceHeader header(trace_header_format_);
+        header.SetNSamples(nz_);
+        header.SetDt(static_cast<unsigned short>(dz_*1000));
+        header.SetScalCo(scalcoinitial);
+        header.SetUtmx(segyTrace->GetX());
+        header.SetUtmy(segyTrace->GetY());
+        header.SetInline(segyTrace->GetInline());
+        header.SetCrossline(segyTrace->GetCrossline());
+        header.Write(out);
+        WriteIBMFloatArrayBE(out + 240, &trace[0], nz_);
+      }
     }
+    nWaiting = nBlock;
+    current  = 1 - current;
   }
+  if (nWaiting > 0)
+    writeOk = writeOk && file_.write(&buffer[1 - current][0], static_cast<std::streamsize>(nWaiting*traceSize));
+  if (!writeOk)
+    throw Exception("Error writing to SEGY-file " + file_name_ + ".");
+
   sort(traces_.begin(), traces_.end(), SortIndex);
   //Traces are sorted, but NULL traces are all at beginning, instead of at correct location.
   for (i = 0; i < traces_.size(); i++) {
@@ -1455,36 +1844,14 @@ SegY::FindGridGeometry(bool only_ilxl, bool keep_header)
   if(file_.tellg() != static_cast<std::streampos>(3600))
     throw(Exception("Can not find SegY geometry for a file where traces have already been read.\n"));
 
-  TraceHeader traceHeader(trace_header_format_);
-
-  std::streampos pos  = 3840;
-  std::streampos step = static_cast<std::streampos>(nz_*datasize_+240);
+  ReadTraceHeaders(keep_header);
 
-  size_t i;
-  traces_.resize(n_traces_);
-  char * buffer = new char[nz_*datasize_];
-  for (i = 0; i < n_traces_; i++)
-  {
-    try {
-      if (file_.eof()==false)
-      {
-        bool extra_header = ReadHeader(traceHeader);
-        traces_[i] = new SegYTrace(traceHeader,keep_header);
-        file_.read(buffer, static_cast<std::streamsize>(nz_*datasize_));
-        if(only_ilxl == true)
-          traces_[i]->RemoveXY();
-        traces_[i]->SetFilePos(pos);
-        pos += step;
-        if(extra_header == true)
-          pos += 3600;
-      }
-    }
-    catch(Exception & e) {
-      throw(Exception("In trace number " + ToString(i) + ":\n" + e.what()));
+  if(only_ilxl == true) {
+    for (size_t i = 0; i < traces_.size(); i++) {
+      if (traces_[i] != NULL)
+        traces_[i]->RemoveXY();
     }
   }
-  delete [] buffer;
-
 
   SetBogusILXLUndefined(traces_);
 
@@ -1493,6 +1860,191 @@ SegY::FindGridGeometry(bool only_ilxl, bool keep_header)
   return(geometry);
 }
 
+void
+SegY::ReadTraceHeaders(bool keep_header)
+{
+  bool indexed = false;
+  if (use_index_files_ == true && keep_header == false)
+    indexed = ReadIndex();
+
+  if (indexed == false) {
+    TraceHeader traceHeader(trace_header_format_);
+
+    std::streampos pos  = 3840;
+    std::streampos step = static_cast<std::streampos>(nz_*datasize_+240);
+
+    size_t i;
+    traces_.resize(n_traces_);
+    char * buffer = new char[nz_*datasize_];
+    for (i = 0; i < n_traces_; i++)
+    {
+      try {
+        if (file_.eof()==false)
+        {
+          bool extra_header = ReadHeader(traceHeader);
+          traces_[i] = new SegYTrace(traceHeader,keep_header);
+          file_.read(buffer, static_cast<std::streamsize>(nz_*datasize_));
+          traces_[i]->SetFilePos(pos);
+          pos += step;
+          if(extra_header == true)
+            pos += 3600;
+        }
+      }
+      catch(Exception & e) {
+        throw(Exception("In trace number " + ToString(i) + ":\n" + e.what()));
+      }
+    }
+    delete [] buffer;
+
+    if (use_index_files_ == true)
+      WriteIndex();
+  }
+}
+
+void
+SegY::SetIndexFiles(bool use, const std::string & directory)
+{
+  use_index_files_ = use;
+  index_directory_ = directory;
+}
+
+std::string
+SegY::GetIndexFileName(void) const
+{
+  if (index_directory_ == "")
+    return(file_name_ + ".index");
+  else
+    return(PrependDir(index_directory_, RemovePath(file_name_) + ".index"));
+}
+
+bool
+SegY::ReadIndex(void)
+{
+  //
+  // The index holds the headers of all traces in the SEG-Y file, and is only valid
+  // as long as the file has the size and modification time stored in the index, and
+  // is read with the same trace header format.
+  //
+  std::string indexName = GetIndexFileName();
+  if (FileExists(indexName) == false)
+    return(false);
+
+  std::vector<SegYTrace *> traces;
+  try {
+    std::ifstream index;
+    OpenRead(index, indexName, std::ios::in | std::ios::binary);
+
+    std::string tag;
+    std::getline(index, tag);
+    if (tag != segyIndexTag)
+      return(false);
+
+    double size = ReadBinaryDouble(index);
+    double time = ReadBinaryDouble(index);
+    if (size != static_cast<double>(FindFileSize(file_name_)) ||
+        time != static_cast<double>(FindFileTime(file_name_)))
+      return(false);
+
+    std::vector<int> format(9);
+    ReadBinaryIntArray(index, format.begin(), format.size());
+    if (format[0] != trace_header_format_.GetUtmxLoc()      ||
+        format[1] != trace_header_format_.GetUtmyLoc()      ||
+        format[2] != trace_header_format_.GetInlineLoc()    ||
+        format[3] != trace_header_format_.GetCrosslineLoc() ||
+        format[4] != trace_header_format_.GetScalCoLoc()    ||
+        format[5] != static_cast<int>(trace_header_format_.GetCoordSys()) ||
+        format[6] != static_cast<int>(trace_header_format_.GetStandardType()) ||
+        format[7] != static_cast<int>(nz_) ||
+        format[8] != datasize_)
+      return(false);
+
+    float  dz      = static_cast<float>(ReadBinaryDouble(index));
+    size_t nTraces = static_cast<size_t>(ReadBinaryInt(index));
+
+    std::vector<double> values(7*nTraces);
+    if (nTraces > 0)
+      ReadBinaryDoubleArray(index, values.begin(), values.size());
+
+    traces.resize(nTraces, NULL);
+    for (size_t i = 0; i < nTraces; i++) {
+      const double * v = &values[7*i];
+      traces[i] = new SegYTrace(v[0], v[1],
+                                static_cast<int>(v[2]), static_cast<int>(v[3]),
+                                v[4], v[5],
+                                static_cast<std::streampos>(static_cast<std::streamoff>(v[6])));
+    }
+
+    dz_       = dz;
+    n_traces_ = nTraces;
+    traces_.swap(traces);
+    return(true);
+  }
+  catch (std::exception &) {
+    for (size_t i = 0; i < traces.size(); i++)
+      delete traces[i];
+    return(false);
+  }
+}
+
+void
+SegY::WriteIndex(void) const
+{
+  for (size_t i = 0; i < traces_.size(); i++) {
+    if (traces_[i] == NULL) // Incomplete file. Do not index.
+      return;
+  }
+
+  //
+  // Failing to write the index is not an error. The file will just be scanned again next time.
+  //
+  std::string indexName = GetIndexFileName();
+  try {
+    std::ofstream index;
+    OpenWrite(index, indexName, std::ios::out | std::ios::binary);
+
+    index << segyIndexTag << "\n";
+    WriteBinaryDouble(index, static_cast<double>(FindFileSize(file_name_)));
+    WriteBinaryDouble(index, static_cast<double>(FindFileTime(file_name_)));
+
+    std::vector<int> format(9);
+    format[0] = trace_header_format_.GetUtmxLoc();
+    format[1] = trace_header_format_.GetUtmyLoc();
+    format[2] = trace_header_format_.GetInlineLoc();
+    format[3] = trace_header_format_.GetCrosslineLoc();
+    format[4] = trace_header_format_.GetScalCoLoc();
+    format[5] = static_cast<int>(trace_header_format_.GetCoordSys());
+    format[6] = static_cast<int>(trace_header_format_.GetStandardType());
+    format[7] = static_cast<int>(nz_);
+    format[8] = datasize_;
+    WriteBinaryIntArray(index, format.begin(), format.end());
+
+    WriteBinaryDouble(index, static_cast<double>(dz_));
+    WriteBinaryInt(index, static_cast<int>(traces_.size()));
+
+    std::vector<double> values(7*traces_.size());
+    for (size_t i = 0; i < traces_.size(); i++) {
+      double * v = &values[7*i];
+      v[0] = traces_[i]->GetX();
+      v[1] = traces_[i]->GetY();
+      v[2] = traces_[i]->GetInline();
+      v[3] = traces_[i]->GetCrossline();
+      v[4] = traces_[i]->GetCoord1();
+      v[5] = traces_[i]->GetCoord2();
+      v[6] = static_cast<double>(static_cast<std::streamoff>(traces_[i]->GetFilePos()));
+    }
+    if (values.size() > 0)
+      WriteBinaryDoubleArray(index, values.begin(), values.end());
+    index.close();
+  }
+  catch (std::exception &) {
+    try {
+      RemoveFile(indexName);
+    }
+    catch (std::exception &) {
+    }
+  }
+}
+
 void
 SegY::SetBogusILXLUndefined(std::vector<NRLib::SegYTrace*> & traces)
 {
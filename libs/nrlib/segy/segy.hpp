@@ -23,6 +23,7 @@
 #define SEGY_HPP
 
 #include <fstream>
+#include <list>
 #include <string>
 #include <vector>
 
@@ -93,7 +94,15 @@ public:
   void                      ReadAllTraces(const NRLib::Volume * volume,
                                           double                zPad,
                                           bool                  onlyVolume       = false,
-                                          bool                  relative_padding = true); ///< Read all traces with header
+                                          bool                  relative_padding = true,
+                                          int                   n_threads        = 1); ///< Read all traces with header
+  /// As ReadAllTraces with onlyVolume, but only the traces inside the volume, and only the part of
+  /// them needed, are read from file. The trace positions are found from the trace headers first,
+  /// so this pays off when an index file is used (see SetIndexFiles), or the volume is a small part of the data.
+  void                      ReadTracesInVolume(const NRLib::Volume * volume,
+                                               double                zPad,
+                                               bool                  relative_padding = true,
+                                               int                   n_threads        = 1);
   float                     GetValue(double x,
                                      double y,
                                      double z,
@@ -165,7 +174,8 @@ public:
                                        float                    topVal  = 0.0f,
                                        float                    baseVal = 0.0f,
                                        short                    scalcoinitial = 1);
-  void                      WriteAllTracesToFile(short scalcoinitial = 1); ///< Use only after writeTrace with x and y as input is used for the whole cube
+  void                      WriteAllTracesToFile(short scalcoinitial = 1,
+                                                 int   n_threads     = 1); ///< Use only after writeTrace with x and y as input is used for the whole cube
   //<<<End write mode
 
 
@@ -190,11 +200,18 @@ public:
   TraceHeaderFormat         GetTraceHeaderFormat(){return trace_header_format_;};
   static TraceHeaderFormat  FindTraceHeaderFormat(const std::string & fileName);
 
+  /// Lets FindGridGeometry store the trace headers it scans in an index file, and use
+  /// the index instead of scanning the file as long as the SEG-Y file is unchanged.
+  /// \param[in] use        Turn index files on or off.
+  /// \param[in] directory  Directory for index files. If empty, they are put next to the SEG-Y files.
+  static void               SetIndexFiles(bool use, const std::string & directory = "");
+
   SegYTrace *              getTrace(int i) {return traces_[i];};
 
 private:
   //void                      ebcdicHeader(std::string& outstring);               ///<
   bool                      ReadHeader(TraceHeader & header);                   ///< Trace header
+  void                      CheckSampling(TraceHeader & header);                ///< Sets dz_ if not set, or checks that header has the same.
   SegYTrace               * ReadTrace(const NRLib::Volume * volume,
                                       double                zPad,
                                       bool                & duplicateHeader,
@@ -207,6 +224,38 @@ private:
   //      Otherwise, outsideTopBot[0] will be top lack, [1] for bottom,
   //      [2] is x-coord, [3] is y-coord. Allocate outside.
 
+  bool                      FindTraceLimits(double                x,
+                                            double                y,
+                                            const NRLib::Volume * volume,
+                                            double                zPad,
+                                            bool                  onlyVolume,
+                                            bool                & outsideSurface,
+                                            double              * outsideTopBot,
+                                            bool                  relative_padding,
+                                            size_t              & j0,
+                                            size_t              & j1) const;      ///< Finds samples to keep. False if the trace is not used.
+
+  SegYTrace               * ParseTrace(const char          * buffer,
+                                       const NRLib::Volume * volume,
+                                       double                zPad,
+                                       bool                  onlyVolume,
+                                       bool                & outsideSurface,
+                                       double              * outsideTopBot,
+                                       bool                  relative_padding,
+                                       size_t              & j0,
+                                       size_t              & j1); ///< As ReadTrace, for a trace already read from file. Samples j0 to j1 are not set.
+
+  float                   * AddSampleBlock(size_t nSamples);                    ///< Storage for samples of many traces.
+
+  size_t                    ReadChunk(std::vector<char> & buffer, size_t nBytes); ///< Reads up to nBytes. Returns the number read.
+
+  void                      ReadTraceHeaders(bool keep_header);                 ///< Sets traces_ without data, from index file or by scanning the file.
+  void                      CheckTracesFound(void) const;                       ///< Throws if no trace has been read.
+
+  std::string               GetIndexFileName(void) const;
+  bool                      ReadIndex(void);                                    ///< Sets traces_ from index file. False if no valid index.
+  void                      WriteIndex(void) const;                             ///< Writes traces_ to index file, if possible.
+
   void                      WriteMainHeader(const TextualHeader& ebcdicHeader); ///< Quasi-dummy at the moment.
   void                      ReadDummyTrace(std::fstream & file, int format, size_t nz);
   /// Used to find correct trace header format.
@@ -228,6 +277,7 @@ private:
   bool                      check_simbox_;          ///<
 
   std::vector<SegYTrace*>   traces_;               ///< All traces
+  std::list<std::vector<float> > sample_blocks_;   ///< Samples of traces read in bulk. Each block holds many traces, one after another.
   size_t                    n_traces_;              ///< Holds the number of traces. May be an estimate if not all read.
 
   int                       datasize_;             ///< Bytes per datapoint in file.
@@ -242,6 +292,8 @@ private:
 
   float                     rmissing_;
 
+  static bool               use_index_files_;      ///< Use index files in FindGridGeometry
+  static std::string        index_directory_;      ///< Directory for index files. Empty means next to the SEG-Y file.
 };
 
 
@@ -56,6 +56,7 @@ SegYTrace::SegYTrace(std::fstream & file, size_t jStart, size_t jEnd, int format
   coord2_        = trace_header->GetCoord2();
   trace_header_  = new TraceHeader(*trace_header);
   table_index_   = 0;
+  shared_data_   = NULL;
   file_position_ = 0;
 
   size_t nData = jEnd - jStart + 1;
@@ -124,6 +125,63 @@ SegYTrace::SegYTrace(std::fstream & file, size_t jStart, size_t jEnd, int format
   }
 }
 
+void SegYTrace::SetData(const char * buffer, size_t jStart, size_t jEnd, int format, float * storage)
+{
+  j_start_ = jStart;
+  j_end_   = jEnd;
+
+  size_t nData = jEnd - jStart + 1;
+  size_t i;
+  float * data;
+  if (storage != NULL) {
+    std::vector<float>().swap(data_);
+    data = storage;
+  }
+  else {
+    data_.resize(nData);
+    data = &data_[0];
+  }
+  shared_data_ = storage;
+
+  if (format == 1)
+  {
+    //IBM
+    ParseIBMFloatArrayBE(buffer, data, nData);
+  }
+  else if (format == 2)
+  {
+    int tmp;
+    for (i = 0; i < nData; i++) {
+      ParseInt32BE(&buffer[4*i], tmp);
+      data[i] = static_cast<float>(tmp);
+    }
+  }
+  else if (format == 3)
+  {
+    short tmp;
+    for (i = 0; i < nData; i++) {
+      ParseInt16BE(&buffer[2*i], tmp);
+      data[i] = static_cast<float>(tmp);
+    }
+  }
+  else if (format == 5)
+  {
+    for (i = 0; i < nData; i++)
+      ParseIEEEFloatBE(&buffer[4*i], data[i]);
+  }
+  else
+    throw FileFormatError("Bad format");
+}
+
+void
+SegYTrace::GetTrace(std::vector<float> & data) const
+{
+  if (j_end_ < j_start_)
+    data.clear();
+  else
+    data.assign(GetData(), GetData() + (j_end_ - j_start_ + 1));
+}
+
 SegYTrace::SegYTrace(std::vector<float> indata, size_t jStart, size_t jEnd, double x, double y, int inLine, int crossLine)
 {
   rmissing_   = segyRMISSING;
@@ -143,6 +201,7 @@ SegYTrace::SegYTrace(std::vector<float> indata, size_t jStart, size_t jEnd, doub
     data_[i] = indata[jStart + i];
 
   table_index_   = 0;
+  shared_data_   = NULL;
   file_position_ = 0;
   trace_header_  = NULL;
 }
@@ -160,6 +219,7 @@ SegYTrace::SegYTrace(const TraceHeader& trace_header, bool keep_header)
   coord1_        = trace_header.GetCoord1();
   coord2_        = trace_header.GetCoord2();
   table_index_   = 0;
+  shared_data_   = NULL;
   file_position_ = 0;
 
   if(keep_header == true)
@@ -169,6 +229,25 @@ SegYTrace::SegYTrace(const TraceHeader& trace_header, bool keep_header)
 
 }
 
+SegYTrace::SegYTrace(double x, double y, int inLine, int crossLine, double coord1, double coord2,
+                     std::streampos file_position)
+{
+  rmissing_      = segyRMISSING;
+  imissing_      = segyIMISSING;
+  j_start_       = 1;
+  j_end_         = 0;
+  x_             = x;
+  y_             = y;
+  in_line_       = inLine;
+  cross_line_    = crossLine;
+  coord1_        = coord1;
+  coord2_        = coord2;
+  table_index_   = 0;
+  shared_data_   = NULL;
+  file_position_ = file_position;
+  trace_header_  = NULL;
+}
+
 SegYTrace::~SegYTrace()
 {
   delete trace_header_;
@@ -181,7 +260,7 @@ SegYTrace::GetValue(size_t j)const
   if (j < j_start_ || j > j_end_)
     value = rmissing_;
   else
-    value = data_[j - j_start_];
+    value = GetData()[j - j_start_];
   return(value);
 }
 
@@ -64,11 +64,27 @@ public:
   SegYTrace(const TraceHeader & trace_header,
             bool                keep_header = true);                                      ///< Constructor for handling only headers.
 
+  SegYTrace(double              x,
+            double              y,
+            int                 inLine,
+            int                 crossLine,
+            double              coord1,
+            double              coord2,
+            std::streampos      file_position);                                           ///< Constructor for handling only headers, from a trace index.
+
   ~SegYTrace();
 
   void SetTableIndex(size_t index) {table_index_ = index;}                                ///< Set table index
 
-  const std::vector<float> & GetTrace(void)              const { return data_       ;}
+  /// Set samples jStart to jEnd from buffer holding only these samples. If storage is given,
+  /// the samples are kept there instead of in the trace, and storage must outlive the trace.
+  void SetData(const char * buffer,
+               size_t       jStart,
+               size_t       jEnd,
+               int          format,
+               float      * storage = NULL);
+
+  void                       GetTrace(std::vector<float> & data) const;                   ///< Get copy of data in trace
   float                      GetValue(size_t j)          const;                           ///< get trace value at index j
   size_t                     GetLegalIndex(size_t index) const;
   size_t                     GetStart()                  const { return j_start_    ;}    ///< Get start index
@@ -101,7 +117,10 @@ private:
   ///(note that this class can live without trace_header, hence duplicates of information
   ///that may also be stored there.)
 
-  std::vector<float> data_;         ///< Data in trace
+  const float      * GetData()                 const { return(shared_data_ != NULL ? shared_data_ : &data_[0]);}
+
+  std::vector<float> data_;         ///< Data in trace, unless stored elsewhere
+  const float      * shared_data_;  ///< Data in trace when stored by SegY, otherwise NULL.
   size_t             j_start_;      ///< Start index
   size_t             j_end_;        ///< End index
   double             x_;            ///< UTM x coord
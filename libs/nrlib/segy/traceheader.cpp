@@ -389,8 +389,7 @@ void TraceHeader::Read(std::istream& inFile, int lineNo)
     throw EndOfFile();
   }
 
-  if (buffer_[0] == '' && buffer_[1] == '@' && buffer_[2] == ''
-      && buffer_[80] == '' && buffer_[160] == '')
+  if (IsEbcdicHeader(buffer_))
   {
     // This is not a trace header, but the start of an EDBDIC-header.
     // Set file pointer at end of EDBDIC header.
@@ -400,6 +399,26 @@ void TraceHeader::Read(std::istream& inFile, int lineNo)
     return;
   }
 
+  ParseBuffer(lineNo);
+}
+
+
+void TraceHeader::Parse(const char* buffer, int lineNo)
+{
+  memcpy(buffer_, buffer, 240);
+  ParseBuffer(lineNo);
+}
+
+
+bool TraceHeader::IsEbcdicHeader(const char* buffer)
+{
+  return(buffer[0] == '' && buffer[1] == '@' && buffer[2] == ''
+         && buffer[80] == '' && buffer[160] == '');
+}
+
+
+void TraceHeader::ParseBuffer(int lineNo)
+{
   std::string buf_string(buffer_,240);
   std::istringstream header(buf_string, std::ios::in | std::ios::binary);
 
@@ -483,6 +502,20 @@ int TraceHeader::Write(std::ostream& outFile)
 {
   int errCode = 0;
 
+  char buffer[240];
+  Write(buffer);
+  if (!outFile.write(buffer, 240))
+    throw Exception("Error writing to stream.");
+
+  return errCode;
+}
+
+
+void TraceHeader::Write(char* buffer) const
+{
+  using NRLib::NRLibPrivate::WriteUInt16BE;
+  using NRLib::NRLibPrivate::WriteUInt32BE;
+
  // write on correct locations. What to write between?
   int i = 0;
 
@@ -490,47 +523,46 @@ int TraceHeader::Write(std::ostream& outFile)
   {
     if (i==(format_.GetScalCoLoc()-1))
     {
-      WriteBinaryShort(outFile, scalcoinitial_);
+      WriteUInt16BE(&buffer[i], static_cast<unsigned short>(scalcoinitial_));
       i = i+2;
     }
     else if (i==(format_.GetUtmxLoc()-1))
     {
-      WriteBinaryInt(outFile, static_cast<int>(utmx_));
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(static_cast<int>(utmx_)));
       i=i+4;
     }
     else if (i==(format_.GetUtmyLoc()-1))
     {
-      WriteBinaryInt(outFile, static_cast<int>(utmy_));
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(static_cast<int>(utmy_)));
       i=i+4;
     }
     else if (i==(NS_LOC-1))
     {
-      WriteBinaryShort(outFile, ns_);
+      WriteUInt16BE(&buffer[i], static_cast<unsigned short>(ns_));
       i=i+2;
     }
     else if (i==(DT_LOC-1))
     {
-      WriteBinaryShort(outFile, dt_);
+      WriteUInt16BE(&buffer[i], static_cast<unsigned short>(dt_));
       i=i+2;
     }
     else if (i==(format_.GetInlineLoc()-1))
     {
-      WriteBinaryInt(outFile, inline_);
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(inline_));
       i=i+4;
     }
     else if (i==(format_.GetCrosslineLoc()-1))
     {
-      WriteBinaryInt(outFile, crossline_);
+      WriteUInt32BE(&buffer[i], static_cast<unsigned int>(crossline_));
       i=i+4;
     }
     else
     {
-      outFile.write(&(buffer_[i]), 2);
+      buffer[i]   = buffer_[i];
+      buffer[i+1] = buffer_[i+1];
       i=i+2;
     }
   }
-
-  return errCode;
 }
 
 
@@ -168,10 +168,24 @@ public:
   void Read(std::istream& inFile,
             int lineNo = -1);
 
+  /// Set header from a buffer of 240 bytes already read from file.
+  /// The buffer must not be the start of an EBCDIC header, see IsEbcdicHeader.
+  /// \param[in] buffer  header bytes, as in file.
+  /// \param[in] lineNo  line number. (from binary header.) -1 if not used.
+  void Parse(const char* buffer,
+             int lineNo = -1);
+
+  /// True if the 240 bytes in buffer are the start of an EBCDIC header, and not a trace header.
+  static bool IsEbcdicHeader(const char* buffer);
+
   /// Write header to file.
   /// \param[in]  outFile output file.
   int Write(std::ostream& outFile);
 
+  /// Write header to a buffer of 240 bytes, as it is written to file.
+  /// \param[out] buffer  header bytes.
+  void Write(char* buffer) const;
+
   /// Dump what is stored in header buffer to file.
   /// May override the number of data. Intended for use when we copy headers
   /// from input to output.
@@ -265,6 +279,9 @@ private:
   /// Get scaling coefficient for SX and SY from buffer.
   short GetScalCo() const;
 
+  /// Set header values from buffer_.
+  void ParseBuffer(int lineNo);
+
 };
 
 } // namespace NRLib
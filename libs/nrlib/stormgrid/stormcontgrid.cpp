@@ -79,7 +79,7 @@ StormContGrid::StormContGrid(const std::string& filename, Endianess file_format)
 }
 
 
-void StormContGrid::ReadFromFile(const std::string& filename, bool commonPath, Endianess number_representation)
+void StormContGrid::ReadFromFile(const std::string& filename, bool commonPath, Endianess number_representation, int n_threads)
 {
   std::ifstream file;
   OpenRead(file, filename, std::ios::in | std::ios::binary);
@@ -145,10 +145,12 @@ void StormContGrid::ReadFromFile(const std::string& filename, bool commonPath, E
     switch (file_format_) {
     case STORM_BINARY:
       DiscardRestOfLine(file, line, true);
-      ReadBinaryFloatArray(file, begin(), GetN(), number_representation);
+      if (GetN() > 0)
+        ReadBinaryFloatArray(file, &(*this)(0), GetN(), number_representation);
       break;
     case STORM_ASCII:
-      ReadAsciiArrayFast(file, begin(), GetN());
+      if (GetN() > 0)
+        ReadAsciiFloatArrayParallel(file, &(*this)(0), GetN(), n_threads);
       break;
     default:
       throw Exception("Bug in STORM grid parser: unknown fileformat");
@@ -176,7 +178,7 @@ void StormContGrid::ReadFromFile(const std::string& filename, bool commonPath, E
 }
 
 
-void StormContGrid::WriteToFile(const std::string& filename, const std::string& predefinedHeader, bool plainAscii, Endianess file_format, bool remove_path) const
+void StormContGrid::WriteToFile(const std::string& filename, const std::string& predefinedHeader, bool plainAscii, Endianess file_format, bool remove_path, int n_threads) const
 {
   std::ofstream file;
   OpenWrite(file, filename, std::ios::out | std::ios::binary);
@@ -197,19 +199,15 @@ void StormContGrid::WriteToFile(const std::string& filename, const std::string&
   else
     file << predefinedHeader;
   // Data
-  int n_data = 0;
   switch (file_format_) {
   case STORM_BINARY:
-    WriteBinaryFloatArray(file, begin(), end(), file_format);
+    if (GetN() > 0)
+      WriteBinaryFloatArray(file, &(*this)(0), GetN(), file_format);
     break;
   case STORM_ASCII:
-    for (const_iterator it = begin(); it != end(); ++it) {
-      file << *it << " ";
-      ++n_data;
-      if (n_data % 10 == 0) {
-        file << "\n";
-      }
-    }
+    // Same text as writing with precision 4, ten values per line.
+    if (GetN() > 0)
+      WriteAsciiFloatArrayParallel(file, &(*this)(0), GetN(), "%.4g", 10, true, n_threads);
     break;
   default:
     throw Exception("Unknown fileformat");
@@ -273,7 +271,8 @@ void StormContGrid::WriteToSgriFile(const std::string & file_name,
   file.precision(14);
 
   // Data
-  WriteBinaryFloatArray(file, begin(), end(), file_format);
+  if (GetN() > 0)
+    WriteBinaryFloatArray(file, &(*this)(0), GetN(), file_format);
 
   // Final 0 (Number of barriers)
   file << 0;
@@ -689,7 +688,8 @@ void StormContGrid::ReadSgriBinaryFile(const std::string& filename)
 {
   std::ifstream binFile(filename.c_str(),std::ios::in | std::ios::binary); //Check opening of file before calling this function
   try {
-    ReadBinaryFloatArray(binFile, begin(), GetN());
+    if (GetN() > 0)
+      ReadBinaryFloatArray(binFile, &(*this)(0), GetN());
   }
   catch (Exception& e) {
     throw Exception("Error: Reading from binary sgri file " +filename + "." + e.what() +"\n");
@@ -786,3 +786,156 @@ double StormContGrid::GetRelThick(double x, double y) const
     relThick = (zBot-zTop)/GetLZ();
   return(relThick);
 }
+
+
+StormContGridLayerReader::StormContGridLayerReader(const std::string& filename,
+                                                   bool commonPath,
+                                                   Endianess number_representation)
+  : filename_(filename),
+    number_representation_(number_representation),
+    next_layer_(0)
+{
+  OpenRead(file_, filename, std::ios::in | std::ios::binary);
+
+  std::string path = "";
+  if (commonPath == true)
+    path = GetPath(filename);
+
+  int line = 0;
+
+  try {
+    std::string token = ReadNext<std::string>(file_, line);
+    if (token == format_desc[StormContGrid::STORM_BINARY]) {
+      file_format_ = StormContGrid::STORM_BINARY;
+    }
+    else if (token == format_desc[StormContGrid::STORM_ASCII]) {
+      file_format_ = StormContGrid::STORM_ASCII;
+    }
+    else {
+      throw FileFormatError("Unknown format: " + token);
+    }
+
+    ReadNext<int>(file_, line);          // Zone number
+    ReadNext<std::string>(file_, line);  // Model file name
+    missing_code_ = ReadNext<float>(file_, line);
+    ReadNext<std::string>(file_, line);  // Variable name
+
+    ReadVolumeFromFile(file_, line, path);
+
+    ni_ = static_cast<size_t>(ReadNext<int>(file_, line));
+    nj_ = static_cast<size_t>(ReadNext<int>(file_, line));
+    nk_ = static_cast<size_t>(ReadNext<int>(file_, line));
+
+    if (file_format_ == StormContGrid::STORM_BINARY)
+      DiscardRestOfLine(file_, line, true);
+    data_start_ = file_.tellg();
+  }
+  catch (EndOfFile& ) {
+    throw FileFormatError("Unexcpected end of file found while parsing "
+      " \"" + filename + "\"");
+  }
+  catch (Exception& e) {
+    throw FileFormatError("Error parsing \"" + filename + "\" as a "
+      "STORM file : " + e.what()+"\n");
+  }
+}
+
+
+void StormContGridLayerReader::ReadLayer(float* layer, int n_threads)
+{
+  if (next_layer_ >= nk_)
+    throw FileFormatError("All layers of \"" + filename_ + "\" have been read.");
+
+  try {
+    if (file_format_ == StormContGrid::STORM_BINARY)
+      ReadBinaryFloatArray(file_, layer, ni_*nj_, number_representation_);
+    else
+      ReadAsciiFloatArrayParallel(file_, layer, ni_*nj_, n_threads);
+  }
+  catch (EndOfFile& ) {
+    throw FileFormatError("Unexcpected end of file found while reading layer "
+      + ToString(next_layer_) + " of \"" + filename_ + "\"");
+  }
+  catch (Exception& e) {
+    throw FileFormatError("Error reading layer " + ToString(next_layer_) + " of \""
+      + filename_ + "\" : " + e.what() + "\n");
+  }
+  next_layer_++;
+}
+
+
+void StormContGridLayerReader::SeekLayer(size_t k)
+{
+  if (k > nk_)
+    throw Exception("Layer " + ToString(k) + " is outside the grid.");
+
+  if (file_format_ == StormContGrid::STORM_BINARY) {
+    file_.clear();
+    file_.seekg(data_start_ + static_cast<std::streamoff>(4*k*ni_*nj_));
+    next_layer_ = k;
+  }
+  else {
+    if (k < next_layer_)
+      throw Exception("Can not go back to an earlier layer in ascii file \"" + filename_ + "\".");
+    std::vector<float> layer(ni_*nj_);
+    while (next_layer_ < k)
+      ReadLayer(layer.empty() ? NULL : &layer[0]);
+  }
+}
+
+
+StormContGridLayerWriter::StormContGridLayerWriter(const std::string& filename,
+                                                   const Volume& volume,
+                                                   size_t ni,
+                                                   size_t nj,
+                                                   size_t nk,
+                                                   StormContGrid::FileFormat format,
+                                                   float missing_code,
+                                                   Endianess number_representation,
+                                                   bool remove_path)
+  : Volume(volume),
+    number_representation_(number_representation),
+    file_format_(format),
+    ni_(ni),
+    nj_(nj),
+    nk_(nk),
+    next_layer_(0)
+{
+  OpenWrite(file_, filename, std::ios::out | std::ios::binary);
+
+  // Same header as StormContGrid::WriteToFile with default settings.
+  file_.precision(4);
+  file_ << format_desc[file_format_] << "\n\n"
+        << 0 << " " << "ModelFile" << " "
+        << missing_code << "\n\n" << "UNKNOWN" << "\n\n" ;
+
+  WriteVolumeToFile(file_, filename, remove_path);
+  file_ << "\n";
+  file_ << ni_ << " " << nj_ << " " << nk_ << "\n";
+}
+
+
+void StormContGridLayerWriter::WriteLayer(const float* layer, int n_threads)
+{
+  if (next_layer_ >= nk_)
+    throw Exception("All layers of the STORM grid have been written.");
+
+  size_t n = ni_*nj_;
+  if (file_format_ == StormContGrid::STORM_BINARY)
+    WriteBinaryFloatArray(file_, layer, n, number_representation_);
+  else
+    WriteAsciiFloatArrayParallel(file_, layer, n, "%.4g", 10, true, n_threads, next_layer_*n);
+  next_layer_++;
+}
+
+
+void StormContGridLayerWriter::Close()
+{
+  if (next_layer_ != nk_)
+    throw Exception("Only " + ToString(next_layer_) + " of " + ToString(nk_)
+      + " layers of the STORM grid were written.");
+
+  // Final 0 (Number of barriers)
+  file_ << 0;
+  file_.close();
+}
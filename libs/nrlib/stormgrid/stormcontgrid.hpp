@@ -22,6 +22,7 @@
 #ifndef NRLIB_STORMCONTGRID_HPP
 #define NRLIB_STORMCONTGRID_HPP
 
+#include <fstream>
 #include <string>
 
 #include "../volume/volume.hpp"
@@ -73,11 +74,13 @@ namespace NRLib {
 
     /// Write to file. If predefinedHeader is not empty, this header is written instead
     ///                of standard, and surfaces are not written.
+    ///                The text of an ascii file is formatted by n_threads threads.
     void WriteToFile(const std::string& filename,
                      const std::string& predefinedHeader = "",
                      bool plainAscii=false,
                      Endianess file_format = END_BIG_ENDIAN,
-                     bool remove_path = true) const;
+                     bool remove_path = true,
+                     int n_threads = 1) const;
 
     void WriteToSgriFile(const std::string & file_name,
                          const std::string & file_name_header,
@@ -87,7 +90,8 @@ namespace NRLib {
 
     /// \throw IOError if the file can not be opened.
     /// \throw FileFormatError if file format is not either storm_binary or storm_ascii, or if grid contains barriers.
-    void ReadFromFile(const std::string& filename, bool commonPath = true, Endianess file_format = END_BIG_ENDIAN);
+    ///        The text of an ascii file is parsed by n_threads threads.
+    void ReadFromFile(const std::string& filename, bool commonPath = true, Endianess file_format = END_BIG_ENDIAN, int n_threads = 1);
 
     double GetDX() const       { return GetLX() / GetNI(); }
     double GetDY() const       { return GetLY() / GetNJ(); }
@@ -147,6 +151,87 @@ namespace NRLib {
     std::string variable_name_;
 };
 
+  /// Reads a storm_petro_binary or storm_petro_ascii file one k-layer at a time,
+  /// so that the whole grid is never in memory. The header is read by the constructor,
+  /// which makes this a cheap way to get the geometry of a grid on file.
+  class StormContGridLayerReader : public Volume {
+  public:
+    /// \throw IOError if the file can not be opened.
+    /// \throw FileFormatError if file format is not either storm_binary or storm_ascii.
+    explicit StormContGridLayerReader(const std::string& filename,
+                                      bool commonPath = true,
+                                      Endianess file_format = END_BIG_ENDIAN);
+
+    size_t GetNI() const { return ni_; }
+    size_t GetNJ() const { return nj_; }
+    size_t GetNK() const { return nk_; }
+
+    float GetMissingCode() const
+    { return missing_code_; }
+
+    StormContGrid::FileFormat GetFormat() const
+    { return file_format_; }
+
+    /// Layer to be read by next call to ReadLayer.
+    size_t GetNextLayer() const
+    { return next_layer_; }
+
+    /// Read next layer into layer, which must hold GetNI()*GetNJ() values, with i running fastest.
+    /// \throw FileFormatError if all layers have been read, or the file ends too early.
+    void ReadLayer(float* layer, int n_threads = 1);
+
+    /// Make layer k the next to be read. Only binary files can go backwards.
+    void SeekLayer(size_t k);
+
+  private:
+    std::ifstream             file_;
+    std::string               filename_;
+    Endianess                 number_representation_;
+    StormContGrid::FileFormat file_format_;
+    float                     missing_code_;
+    size_t                    ni_;
+    size_t                    nj_;
+    size_t                    nk_;
+    size_t                    next_layer_;
+    std::streampos            data_start_;
+  };
+
+  /// Writes a storm_petro_binary or storm_petro_ascii file one k-layer at a time.
+  /// The file is the same as written by StormContGrid::WriteToFile for a grid with
+  /// the same volume and values.
+  class StormContGridLayerWriter : public Volume {
+  public:
+    /// Opens the file and writes the header.
+    StormContGridLayerWriter(const std::string& filename,
+                             const Volume& volume,
+                             size_t ni,
+                             size_t nj,
+                             size_t nk,
+                             StormContGrid::FileFormat format = StormContGrid::STORM_BINARY,
+                             float missing_code = -999.0F,
+                             Endianess file_format = END_BIG_ENDIAN,
+                             bool remove_path = true);
+
+    /// Write next layer, holding GetNI()*GetNJ() values with i running fastest.
+    void WriteLayer(const float* layer, int n_threads = 1);
+
+    /// Finish the file.
+    /// \throw Exception if not all layers have been written.
+    void Close();
+
+    size_t GetNI() const { return ni_; }
+    size_t GetNJ() const { return nj_; }
+    size_t GetNK() const { return nk_; }
+
+  private:
+    std::ofstream             file_;
+    Endianess                 number_representation_;
+    StormContGrid::FileFormat file_format_;
+    size_t                    ni_;
+    size_t                    nj_;
+    size_t                    nk_;
+    size_t                    next_layer_;
+  };
 }
 
 #endif // NRLIB_STORMCONTGRID_HPP
@@ -35,6 +35,7 @@
 #include "src/wavelet.h"
 #include "src/avoinversion.h"
 #include "src/fftgrid.h"
+#include "src/fftplancache.h"
 #include "src/gridmapping.h"
 #include "src/simbox.h"
 #include "src/timings.h"
@@ -216,6 +217,11 @@ int main(int argc, char** argv)
     std::vector<SeismicParametersHolder> seismicParametersIntervals(common_data->GetMultipleIntervalGrid()->GetNIntervals());
 
     if(modelSettings->getEstimationMode() == false) {
+      //Write realisations as they are simulated, if they need not be combined in CombineResults
+      CravaResult * simulation_output = NULL;
+      if (modelSettings->getNumberOfSimulations() > 0 && crava_result->SetupSimulationOutput(modelSettings, common_data))
+        simulation_output = crava_result;
+
       //Loop over intervals
       for (int i_interval = 0; i_interval < n_intervals; i_interval++) {
 
@@ -319,7 +325,8 @@ int main(int argc, char** argv)
                                                 common_data,
                                                 seismicParametersIntervals[i_interval],
                                                 eventIndex,
-                                                i_interval);
+                                                i_interval,
+                                                simulation_output);
               break;
             }
             case TimeLine::TRAVEL_TIME : {
@@ -408,6 +415,10 @@ int main(int argc, char** argv)
       //TaskList::addTask("The memory usage estimate failed. Please send your XML-model file and the logFile.txt\n    to the CRAVA developers.");
     }
 
+    if (modelSettings->getUseFFTWisdom())
+      FFTPlanCache::writeWisdom(IO::makeFullFileName("", IO::FileFFTWisdom()+IO::SuffixTextFiles()));
+    FFTPlanCache::releasePlans();
+
     Timings::setTimeTotal(wall,cpu);
     Timings::reportAll(LogKit::Medium);
 
@@ -18,6 +18,7 @@
 #include "src/modelavodynamic.h"
 #include "src/fftgrid.h"
 #include "src/fftfilegrid.h"
+#include "src/fftplancache.h"
 #include "src/vario.h"
 #include "src/krigingdata3d.h"
 #include "src/covgridseparated.h"
@@ -31,6 +32,9 @@
 #include "src/qualitygrid.h"
 #include "src/io.h"
 #include "src/tasklist.h"
+#include "src/smallcomplexmatrix.h"
+#include "src/batchcomplexmatrix.h"
+#include "src/cravaresult.h"
 
 #include "lib/timekit.hpp"
 #include "lib/random.h"
@@ -54,7 +58,8 @@ AVOInversion::AVOInversion(ModelSettings           * modelSettings,
                            ModelGeneral            * modelGeneral,
                            ModelAVOStatic          * modelAVOstatic,
                            ModelAVODynamic         * modelAVOdynamic,
-                           SeismicParametersHolder & seismicParameters)
+                           SeismicParametersHolder & seismicParameters,
+                           CravaResult             * simulationOutput)
 {
 
   if(modelAVOstatic->GetForwardModeling())
@@ -280,7 +285,7 @@ AVOInversion::AVOInversion(ModelSettings           * modelSettings,
     LogKit::LogFormatted(LogKit::DebugLow,"\nTime elapsed :  %d\n",timeend-timestart);
 
     if(modelSettings->getNumberOfSimulations() > 0)
-      simulate(seismicParameters, modelGeneral->GetRandomGen());
+      simulate(seismicParameters, modelGeneral->GetRandomGen(), simulationOutput);
 
     seismicParameters.invFFTCovGrids();
     seismicParameters.updatePriorVar();
@@ -495,7 +500,7 @@ AVOInversion::checkScale(void)
 void
 AVOInversion::divideDataByScaleWavelet(const SeismicParametersHolder & seismicParameters)
 {
-  int i,j,k,l,flag;
+  int i,j,k,l;
 
   fftw_real*    rData;
   fftw_real     tmp;
@@ -511,9 +516,8 @@ AVOInversion::divideDataByScaleWavelet(const SeismicParametersHolder & seismicPa
 
   Wavelet1D* localWavelet ;
 
-  flag   = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan1  = rfftwnd_create_plan(1,&nzp_,FFTW_REAL_TO_COMPLEX,flag);
-  plan2  = rfftwnd_create_plan(1,&nzp_,FFTW_COMPLEX_TO_REAL,flag);
+  plan1  = FFTPlanCache::getPlan1D(nzp_,FFTW_REAL_TO_COMPLEX);
+  plan2  = FFTPlanCache::getPlan1D(nzp_,FFTW_COMPLEX_TO_REAL);
 
   for (l=0 ; l< ntheta_ ; l++ )
   {
@@ -630,8 +634,6 @@ AVOInversion::divideDataByScaleWavelet(const SeismicParametersHolder & seismicPa
 
   fftw_free(rData);
   fftw_free(adjustmentFactor);
-  fftwnd_destroy_plan(plan1);
-  fftwnd_destroy_plan(plan2);
 }
 
 
@@ -651,8 +653,7 @@ AVOInversion::computeAdjustmentFactor(fftw_complex                  * adjustment
 
     // computes the time covariance for reflection coefficients rcCovT can be globaly stored
   fftw_real* rcCovT;
-  int flag   = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  rfftwnd_plan plan1  = rfftwnd_create_plan(1, &nzp_ ,FFTW_REAL_TO_COMPLEX,flag);
+  rfftwnd_plan plan1  = FFTPlanCache::getPlan1D(nzp_ ,FFTW_REAL_TO_COMPLEX);
   rcCovT = static_cast<fftw_real*>(fftw_malloc(2*(nzp_/2+1)*sizeof(fftw_real)));
   fftw_complex * rcSpecIntens = reinterpret_cast<fftw_complex*>(rcCovT);
 
@@ -725,14 +726,13 @@ AVOInversion::computeAdjustmentFactor(fftw_complex                  * adjustment
   delete errorSmooth;
   delete errorSmooth2;
   delete errorSmooth3;
-  fftwnd_destroy_plan(plan1);
   fftw_free(rcCovT);
 }
 
 void
 AVOInversion::multiplyDataByScaleWaveletAndWriteToFile(const std::string & typeName)
 {
-  int i,j,k,l,flag;
+  int i,j,k,l;
 
   fftw_real*    rData;
   fftw_real     tmp;
@@ -743,9 +743,8 @@ AVOInversion::multiplyDataByScaleWaveletAndWriteToFile(const std::string & typeN
   rData  = static_cast<fftw_real*>(fftw_malloc(2*(nzp_/2+1)*sizeof(fftw_real)));
   cData  = reinterpret_cast<fftw_complex*>(rData);
 
-  flag   = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan1  = rfftwnd_create_plan(1, &nzp_ ,FFTW_REAL_TO_COMPLEX,flag);
-  plan2  = rfftwnd_create_plan(1,&nzp_,FFTW_COMPLEX_TO_REAL,flag);
+  plan1  = FFTPlanCache::getPlan1D(nzp_ ,FFTW_REAL_TO_COMPLEX);
+  plan2  = FFTPlanCache::getPlan1D(nzp_,FFTW_COMPLEX_TO_REAL);
 
   Wavelet1D* localWavelet;
 
@@ -793,8 +792,6 @@ AVOInversion::multiplyDataByScaleWaveletAndWriteToFile(const std::string & typeN
   }
 
   fftw_free(rData);
-  fftwnd_destroy_plan(plan1);
-  fftwnd_destroy_plan(plan2);
 }
 
 
@@ -807,48 +804,7 @@ AVOInversion::computePostMeanResidAndFFTCov(ModelGeneral            * modelGener
 
   double wall=0.0, cpu=0.0;
   TimeKit::getTime(wall,cpu);
-  int i,j,k,l;
-
-  fftw_complex * kW          = new fftw_complex[ntheta_];
-
-  fftw_complex * errMult1    = new fftw_complex[ntheta_];
-  fftw_complex * errMult2    = new fftw_complex[ntheta_];
-  fftw_complex * errMult3    = new fftw_complex[ntheta_];
-
-  fftw_complex * ijkData     = new fftw_complex[ntheta_];
-  fftw_complex * ijkDataMean = new fftw_complex[ntheta_];
-  fftw_complex * ijkRes      = new fftw_complex[ntheta_];
-  fftw_complex * ijkMean     = new fftw_complex[3];
-  fftw_complex * ijkAns      = new fftw_complex[3];
-  fftw_complex   kD,kD3;
-
-  fftw_complex**  K  = new fftw_complex*[ntheta_];
-  for (i = 0; i < ntheta_; i++)
-    K[i] = new fftw_complex[3];
-
-  fftw_complex**  KS  = new fftw_complex*[ntheta_];
-  for (i = 0; i < ntheta_; i++)
-    KS[i] = new fftw_complex[3];
-
-  fftw_complex**  KScc  = new fftw_complex*[3]; // cc - complex conjugate (and transposed)
-  for (i = 0; i < 3; i++)
-    KScc[i] = new fftw_complex[ntheta_];
-
-  fftw_complex**  parVar = new fftw_complex*[3];
-  for (i = 0; i < 3; i++)
-    parVar[i] = new fftw_complex[3];
-
-  fftw_complex**  margVar = new fftw_complex*[ntheta_];
-  for (i = 0; i < ntheta_; i++)
-    margVar[i] = new fftw_complex[ntheta_];
-
-  fftw_complex**  errVar = new fftw_complex*[ntheta_];
-  for (i = 0; i < ntheta_; i++)
-    errVar[i] = new fftw_complex[ntheta_];
-
-  fftw_complex** reduceVar = new fftw_complex*[3];
-  for (i = 0; i < 3; i++)
-    reduceVar[i]= new fftw_complex[3];
+  int i,l;
 
   Wavelet1D * diff1Operator = new Wavelet1D(Wavelet::FIRSTORDERFORWARDDIFF,nz_,nzp_);
   Wavelet1D * diff2Operator = new Wavelet1D(diff1Operator,Wavelet::FIRSTORDERBACKWARDDIFF);
@@ -927,10 +883,6 @@ AVOInversion::computePostMeanResidAndFFTCov(ModelGeneral            * modelGener
 
   // Computes the posterior mean first below the covariance is computed
   // To avoid to many grids in memory at the same time
-  double priorVarVp,justfactor;
-  int cholFlag;
-  float realFrequency;
-
   Wavelet1D** seisWaveletForNorm = new Wavelet1D*[ntheta_];
   for (l = 0; l < ntheta_; l++)
   {
@@ -949,156 +901,250 @@ AVOInversion::computePostMeanResidAndFFTCov(ModelGeneral            * modelGener
     << "\n  |    |    |    |    |    |    |    |    |    |    |  "
     << "\n  ^";
 
-  for (k = 0; k < nzp_; k++)
+  // Copy matrix A to float**
+  float ** A = new float * [ntheta_];
+  for (i = 0; i < ntheta_; i++) {
+    A[i] = new float[3];
+    for (int j = 0; j < 3; j++)
+      A[i][j] = static_cast<float>(A_(i,j));
+  }
+
+  // Each frequency slab k is independent of the others. When all grids are held in
+  // memory the slabs are distributed over threads, and cells are accessed by index.
+  // Grids stored on file must be streamed through the getNext/setNext cursors, and
+  // are therefore visited in storage order by a single thread.
+  bool streamAccess = fileGrid_;
+  for (l = 0; l < ntheta_; l++)
+    streamAccess = streamAccess || seisData_[l]->isFile();
+
+  int nThreads  = 1;
+#ifdef PARALLEL
+  if (streamAccess == false)
+    nThreads = std::max(1, modelSettings->getNumberOfThreads());
+#endif
+  if (nThreads > 1)
+    LogKit::LogFormatted(LogKit::Low,"\nUsing %d threads.\n", nThreads);
+
+  // The cells along x are updated in batches. For the usual numbers of angles
+  // each batch is solved together with matrices of fixed size. Otherwise the
+  // general lib_matr functions are used, one cell at a time.
+  PosteriorCellUpdate cellUpdate = getPosteriorCellUpdate(ntheta_);
+  const int           batchSize  = BatchComplexMatrix::WIDTH;
+
+  int nSlabsDone = 0;
+
+#ifdef PARALLEL
+#pragma omp parallel num_threads(nThreads)
+#endif
   {
-    realFrequency = static_cast<float>((nz_*1000.0f)/(simbox_->getlz()*nzp_)*std::min(k,nzp_-k)); // the physical frequency
-    kD = diff1Operator->getCAmp(k);                      // defines content of kD
-    if(simbox_->getIsConstantThick())
-    {
-      // defines content of K=WDA
-      fillkW(k, kW, seisWavelet_);
-
-      lib_matrProdScalVecCpx(kD, kW, ntheta_);
-
-      // Copy matrix A to float**
-      float ** A = new float * [3];
-      for (int i = 0; i < ntheta_; i++)
-        A[i] = new float[3]; //H
-      for (int i = 0; i < ntheta_; i++){
-        for (int j = 0; j < 3; j++){
-          A[i][j] = static_cast<float>(A_(i,j));
-        }
-      }
+    // Scratch matrices are private to each thread
+    fftw_complex * kW          = new fftw_complex[ntheta_];
 
-      lib_matrProdDiagCpxR(kW, A, ntheta_, 3, K); // defines content of (WDA) K
+    fftw_complex * errMult1    = new fftw_complex[ntheta_];
+    fftw_complex * errMult2    = new fftw_complex[ntheta_];
+    fftw_complex * errMult3    = new fftw_complex[ntheta_];
+    fftw_complex   kD,kD3;
 
-      for (int i = 0; i < ntheta_; i++)
-        delete [] A[i];
-      delete [] A;
+    fftw_complex**  K  = new fftw_complex*[ntheta_];
+    for (int m = 0; m < ntheta_; m++)
+      K[m] = new fftw_complex[3];
 
-      // defines error-term multipliers
-      fillkWNorm(k,errMult1,seisWaveletForNorm);         // defines input of  (kWNorm) errMult1
-      fillkWNorm(k,errMult2,errorSmooth3);               // defines input of  (kWD3Norm) errMult2
-      lib_matrFillOnesVecCpx(errMult3,ntheta_);          // defines content of errMult3
-    }
-    else
-    {
-      kD3 = diff3Operator->getCAmp(k);                   // defines  kD3
-
-      // Copy matrix A to float **
-      float ** A = new float * [ntheta_];
-      for (int i = 0; i < ntheta_; i++)
-        A[i] = new float[3];
-      for (int i = 0; i < ntheta_; i++){
-        for (int j = 0; j < 3; j++){
-          A[i][j] = static_cast<float>(A_(i,j));
-        }
-      }
+    fftw_complex**  parVar = new fftw_complex*[3];
+    for (int m = 0; m < 3; m++)
+      parVar[m] = new fftw_complex[3];
 
-      // defines content of K = DA
-      lib_matrFillValueVecCpx(kD, errMult1, ntheta_);    // errMult1 used as dummy
-      lib_matrProdDiagCpxR(errMult1, A, ntheta_, 3, K); // defines content of ( K = DA )
+    fftw_complex**  errVar = new fftw_complex*[ntheta_];
+    for (int m = 0; m < ntheta_; m++)
+      errVar[m] = new fftw_complex[ntheta_];
 
-      for (int i = 0; i < ntheta_; i++)
-        delete [] A[i];
-      delete [] A;
+    // The cells of a batch, stored one after another as described in updatePosteriorCells()
+    fftw_complex * batchParVar = new fftw_complex[batchSize*9];
+    fftw_complex * batchErrVar = new fftw_complex[batchSize*ntheta_*ntheta_];
+    fftw_complex * batchMean   = new fftw_complex[batchSize*3];
+    fftw_complex * batchData   = new fftw_complex[batchSize*ntheta_];
+    fftw_complex * batchRes    = new fftw_complex[batchSize*ntheta_];
 
-      // defines error-term multipliers
-      lib_matrFillOnesVecCpx(errMult1,ntheta_);          // defines content of errMult1
-      for (l=0; l < ntheta_; l++)
-      {
-        errMult1[l].re /= seisWavelet_[l]->getNorm();    // defines content of errMult1
-      }
+    float realFrequency;
 
-      lib_matrFillValueVecCpx(kD3,errMult2,ntheta_);     // defines content of errMult2
-      for (l=0; l < ntheta_; l++)
+#ifdef PARALLEL
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for (int k = 0; k < nzp_; k++)
+    {
+      realFrequency = static_cast<float>((nz_*1000.0f)/(simbox_->getlz()*nzp_)*std::min(k,nzp_-k)); // the physical frequency
+      kD = diff1Operator->getCAmp(k);                      // defines content of kD
+      if(simbox_->getIsConstantThick())
       {
-        //float errorSmoothMult =  1.0f/errorSmooth3[l]->findNormWithinFrequencyBand(lowCut_,highCut_); // defines scaleFactor;
-        float errorSmoothMult =  1.0f/errorSmooth3[l]->getNorm(); // defines scaleFactor;
-        errMult2[l].re  *= errorSmoothMult; // defines content of errMult2
-        errMult2[l].im  *= errorSmoothMult; // defines content of errMult2
+        // defines content of K=WDA
+        fillkW(k, kW, seisWavelet_);
+
+        lib_matrProdScalVecCpx(kD, kW, ntheta_);
+
+        lib_matrProdDiagCpxR(kW, A, ntheta_, 3, K); // defines content of (WDA) K
+
+        // defines error-term multipliers
+        fillkWNorm(k,errMult1,seisWaveletForNorm);         // defines input of  (kWNorm) errMult1
+        fillkWNorm(k,errMult2,errorSmooth3);               // defines input of  (kWD3Norm) errMult2
+        lib_matrFillOnesVecCpx(errMult3,ntheta_);          // defines content of errMult3
       }
-      fillInverseAbskWRobust(k,errMult3,seisWaveletForNorm);// defines content of errMult3
-    }
+      else
+      {
+        kD3 = diff3Operator->getCAmp(k);                   // defines  kD3
 
-    for ( j = 0; j < nyp_; j++) {
-      for ( i = 0; i < cnxp; i++) {
-        ijkMean[0] = meanVp_ ->getNextComplex();
-        ijkMean[1] = meanVs_ ->getNextComplex();
-        ijkMean[2] = meanRho_->getNextComplex();
+        // defines content of K = DA
+        lib_matrFillValueVecCpx(kD, errMult1, ntheta_);    // errMult1 used as dummy
+        lib_matrProdDiagCpxR(errMult1, A, ntheta_, 3, K); // defines content of ( K = DA )
+
+        // defines error-term multipliers
+        lib_matrFillOnesVecCpx(errMult1,ntheta_);          // defines content of errMult1
+        for (int m = 0; m < ntheta_; m++)
+        {
+          errMult1[m].re /= seisWavelet_[m]->getNorm();    // defines content of errMult1
+        }
 
-        for (l = 0; l < ntheta_; l++ )
+        lib_matrFillValueVecCpx(kD3,errMult2,ntheta_);     // defines content of errMult2
+        for (int m = 0; m < ntheta_; m++)
         {
-          ijkData[l] = seisData_[l]->getNextComplex();
-          ijkRes[l]  = ijkData[l];
+          //float errorSmoothMult =  1.0f/errorSmooth3[m]->findNormWithinFrequencyBand(lowCut_,highCut_); // defines scaleFactor;
+          float errorSmoothMult =  1.0f/errorSmooth3[m]->getNorm(); // defines scaleFactor;
+          errMult2[m].re  *= errorSmoothMult; // defines content of errMult2
+          errMult2[m].im  *= errorSmoothMult; // defines content of errMult2
         }
+        fillInverseAbskWRobust(k,errMult3,seisWaveletForNorm);// defines content of errMult3
+      }
 
-        seismicParameters.getNextParameterCovariance(parVar);
-        bool invert_frequency = realFrequency > lowCut_*simbox_->getMinRelThick() &&  realFrequency < highCut_;
+      bool invert_frequency = realFrequency > lowCut_*simbox_->getMinRelThick() &&  realFrequency < highCut_;
 
-        priorVarVp = parVar[0][0].re;
+      for (int j = 0; j < nyp_; j++) {
+        for (int i0 = 0; i0 < cnxp; i0 += batchSize) {
+          int nCells = std::min(batchSize, cnxp - i0);
 
-        getNextErrorVariance(errVar, errMult1, errMult2, errMult3, ntheta_, wnc_, errThetaCov_, invert_frequency);
+          for (int c = 0; c < nCells; c++) {
+            int            i       = i0 + c;
+            fftw_complex * ijkMean = batchMean + 3*c;
+            fftw_complex * ijkData = batchData + ntheta_*c;
+            fftw_complex * ijkRes  = batchRes  + ntheta_*c;
+            fftw_complex   ijkErrCorr;
+            if (streamAccess) {
+              ijkMean[0] = meanVp_ ->getNextComplex();
+              ijkMean[1] = meanVs_ ->getNextComplex();
+              ijkMean[2] = meanRho_->getNextComplex();
 
-        if(invert_frequency){
-          lib_matrProdCpx(K, parVar , ntheta_, 3 ,3, KS);              //  KS is defined here
-          lib_matrProdAdjointCpx(KS, K, ntheta_, 3 ,ntheta_, margVar); // margVar = (K)S(K)' is defined here
-          lib_matrAddMatCpx(errVar, ntheta_,ntheta_, margVar);         // errVar  is added to margVar = (WDA)S(WDA)'  + errVar
+              for (int m = 0; m < ntheta_; m++ )
+                ijkData[m] = seisData_[m]->getNextComplex();
 
-          cholFlag=lib_matrCholCpx(ntheta_,margVar);                   // Choleskey factor of margVar is Defined
+              seismicParameters.getNextParameterCovariance(parVar);
+              ijkErrCorr = errCorr_->getNextComplex();
+            }
+            else {
+              ijkMean[0] = meanVp_ ->getComplexValue(i, j, k, true);
+              ijkMean[1] = meanVs_ ->getComplexValue(i, j, k, true);
+              ijkMean[2] = meanRho_->getComplexValue(i, j, k, true);
 
-          if(cholFlag==0)
-          { // then it is ok else posterior is identical to prior
+              for (int m = 0; m < ntheta_; m++ )
+                ijkData[m] = seisData_[m]->getComplexValue(i, j, k, true);
 
-            lib_matrAdjoint(KS,ntheta_,3,KScc);                        //  WDAScc is adjoint of WDAS
-            lib_matrAXeqBMatCpx(ntheta_, margVar, KS, 3);              // redefines WDAS
-            lib_matrProdCpx(KScc,KS,3,ntheta_,3,reduceVar);            // defines reduceVar
-            //double hj=1000000.0;
-            //if(reduceVar[0][0].im!=0)
-            // hj = MAXIM(reduceVar[0][0].re/reduceVar[0][0].im,-reduceVar[0][0].re/reduceVar[0][0].im); //NBNB DEBUG
-            lib_matrSubtMatCpx(reduceVar,3,3,parVar);                  // redefines parVar as the posterior solution
+              seismicParameters.getParameterCovariance(parVar, i, j, k);
+              ijkErrCorr = errCorr_->getComplexValue(i, j, k, true);
+            }
 
-            lib_matrProdMatVecCpx(K,ijkMean, ntheta_, 3, ijkDataMean); //  defines content of ijkDataMean
-            lib_matrSubtVecCpx(ijkDataMean, ntheta_, ijkData);         //  redefines content of ijkData
+            for (int m = 0; m < ntheta_; m++ )
+              ijkRes[m] = ijkData[m];
 
-            lib_matrProdAdjointMatVecCpx(KS,ijkData,3,ntheta_,ijkAns); // defines ijkAns
+            for (int m = 0; m < 3; m++)
+              for (int n = 0; n < 3; n++)
+                batchParVar[9*c + 3*m + n] = parVar[m][n];
 
-            lib_matrAddVecCpx(ijkAns, 3,ijkMean);                      // redefines ijkMean
-            lib_matrProdMatVecCpx(K,ijkMean, ntheta_, 3, ijkData);     // redefines ijkData
-            lib_matrSubtVecCpx(ijkData, ntheta_,ijkRes);               // redefines ijkRes
+            if (invert_frequency) {
+              getErrorVariance(errVar, ijkErrCorr, errMult1, errMult2, errMult3, ntheta_, wnc_, errThetaCov_, invert_frequency);
+              for (int m = 0; m < ntheta_; m++)
+                for (int n = 0; n < ntheta_; n++)
+                  batchErrVar[ntheta_*ntheta_*c + ntheta_*m + n] = errVar[m][n];
+            }
           }
 
-          // quality control DEBUG
-          if(priorVarVp*4 < ijkAns[0].re*ijkAns[0].re + ijkAns[0].re*ijkAns[0].re)
-          {
-            justfactor = sqrt(ijkAns[0].re*ijkAns[0].re + ijkAns[0].re*ijkAns[0].re)/sqrt(priorVarVp);
+          if (invert_frequency)
+            cellUpdate(nCells, ntheta_, K, batchParVar, batchErrVar, batchMean, batchData, batchRes);
+
+          for (int c = 0; c < nCells; c++) {
+            int                  i       = i0 + c;
+            const fftw_complex * ijkMean = batchMean   + 3*c;
+            const fftw_complex * ijkRes  = batchRes    + ntheta_*c;
+            const fftw_complex * pVar    = batchParVar + 9*c;
+            if (streamAccess) {
+              postVp_ ->setNextComplex(ijkMean[0]);
+              postVs_ ->setNextComplex(ijkMean[1]);
+              postRho_->setNextComplex(ijkMean[2]);
+              postCovVp ->setNextComplex(pVar[0]);
+              postCovVs ->setNextComplex(pVar[4]);
+              postCovRho->setNextComplex(pVar[8]);
+              postCrCovVpVs ->setNextComplex(pVar[1]);
+              postCrCovVpRho->setNextComplex(pVar[2]);
+              postCrCovVsRho->setNextComplex(pVar[5]);
+
+              for (int m = 0; m < ntheta_; m++)
+                seisData_[m]->setNextComplex(ijkRes[m]);
+            }
+            else {
+              postVp_ ->setComplexValue(i, j, k, ijkMean[0], true);
+              postVs_ ->setComplexValue(i, j, k, ijkMean[1], true);
+              postRho_->setComplexValue(i, j, k, ijkMean[2], true);
+              postCovVp ->setComplexValue(i, j, k, pVar[0], true);
+              postCovVs ->setComplexValue(i, j, k, pVar[4], true);
+              postCovRho->setComplexValue(i, j, k, pVar[8], true);
+              postCrCovVpVs ->setComplexValue(i, j, k, pVar[1], true);
+              postCrCovVpRho->setComplexValue(i, j, k, pVar[2], true);
+              postCrCovVsRho->setComplexValue(i, j, k, pVar[5], true);
+
+              for (int m = 0; m < ntheta_; m++)
+                seisData_[m]->setComplexValue(i, j, k, ijkRes[m], true);
+            }
           }
         }
-
-        postVp_ ->setNextComplex(ijkMean[0]);
-        postVs_ ->setNextComplex(ijkMean[1]);
-        postRho_->setNextComplex(ijkMean[2]);
-        postCovVp ->setNextComplex(parVar[0][0]);
-        postCovVs ->setNextComplex(parVar[1][1]);
-        postCovRho->setNextComplex(parVar[2][2]);
-        postCrCovVpVs ->setNextComplex(parVar[0][1]);
-        postCrCovVpRho->setNextComplex(parVar[0][2]);
-        postCrCovVsRho->setNextComplex(parVar[1][2]);
-
-        for (l=0;l<ntheta_;l++)
-          seisData_[l]->setNextComplex(ijkRes[l]);
+      }
+      // Log progress
+#ifdef PARALLEL
+#pragma omp critical(postMeanMonitor)
+#endif
+      {
+        nSlabsDone++;
+        if (nSlabsDone >= static_cast<int>(nextMonitor))
+        {
+          nextMonitor += monitorSize;
+          std::cout << "^";
+          fflush(stdout);
+        }
       }
     }
-    // Log progress
-    if (k+1 >= static_cast<int>(nextMonitor))
+
+    delete [] kW;
+    delete [] errMult1;
+    delete [] errMult2;
+    delete [] errMult3;
+    delete [] batchParVar;
+    delete [] batchErrVar;
+    delete [] batchMean;
+    delete [] batchData;
+    delete [] batchRes;
+
+    for (int m = 0; m < ntheta_; m++)
     {
-      nextMonitor += monitorSize;
-      std::cout << "^";
-      fflush(stdout);
+      delete[] K[m];
+      delete[] errVar[m];
     }
+    delete[] K;
+    delete[] errVar;
+
+    for (int m = 0; m < 3; m++)
+      delete[] parVar[m];
+    delete[] parVar;
   }
   std::cout << "\n";
 
+  for (i = 0; i < ntheta_; i++)
+    delete [] A[i];
+  delete [] A;
+
   //  time(&timeend);
   // LogKit::LogFormatted(LogKit::Low,"\n Core inversion finished after %ld seconds ***\n",timeend-timestart);
   meanVp_  = NULL; // the content is taken care of by  postVp_
@@ -1116,6 +1162,7 @@ AVOInversion::computePostMeanResidAndFFTCov(ModelGeneral            * modelGener
   postCrCovVpRho->endAccess();
   postCrCovVsRho->endAccess();
   errCorr_      ->endAccess();
+  errCorr_      ->compress();   // Not used again by this inversion
 
   postVp_ ->invFFTInPlace();
   postVs_ ->invFFTInPlace();
@@ -1189,47 +1236,19 @@ AVOInversion::computePostMeanResidAndFFTCov(ModelGeneral            * modelGener
     writeBWPredicted();
   }
   //delete [] seisData_;
-  delete [] kW;
-  delete [] errMult1;
-  delete [] errMult2;
-  delete [] errMult3;
-  delete [] ijkData;
-  delete [] ijkDataMean;
-  delete [] ijkRes;
-  delete [] ijkMean ;
-  delete [] ijkAns;
   delete    diff1Operator;
   delete    diff3Operator;
 
   for (i = 0; i < ntheta_; i++)
   {
-    delete[]  K[i];
-    delete[]  KS[i];
-    delete[]  margVar[i] ;
-    delete[] errVar[i] ;
     delete errorSmooth3[i];
     delete errorSmooth[i];
     delete seisWaveletForNorm[i];
   }
 
-  delete[] K;
-  delete[] KS;
-  delete[] margVar;
-  delete[] errVar  ;
   delete[] errorSmooth3;
   delete[] errorSmooth;
   delete[] seisWaveletForNorm;
-
-  for (i = 0; i < 3; i++)
-  {
-    delete[] KScc[i];
-    delete[] parVar[i] ;
-    delete[] reduceVar[i];
-  }
-  delete[] KScc;
-  delete[] parVar;
-  delete[] reduceVar;
-
   Timings::setTimeInversion(wall,cpu);
   return(0);
 }
@@ -1237,21 +1256,19 @@ AVOInversion::computePostMeanResidAndFFTCov(ModelGeneral            * modelGener
 
 //--------------------------------------------------------------------
 void
-AVOInversion::getNextErrorVariance(fftw_complex **& errVar,
-                                   fftw_complex   * errMult1,
-                                   fftw_complex   * errMult2,
-                                   fftw_complex   * errMult3,
-                                   int              ntheta,
-                                   float            wnc,
-                                   double        ** errThetaCov,
-                                   bool             invert_frequency) const
+AVOInversion::getErrorVariance(fftw_complex **& errVar,
+                               fftw_complex     ijkErrCorr,
+                               fftw_complex   * errMult1,
+                               fftw_complex   * errMult2,
+                               fftw_complex   * errMult3,
+                               int              ntheta,
+                               float            wnc,
+                               double        ** errThetaCov,
+                               bool             invert_frequency) const
 {
   fftw_complex ijkErrLam;
-  fftw_complex ijkTmp;
-
-  ijkTmp = errCorr_->getNextComplex();
 
-  ijkErrLam.re        = float( sqrt(ijkTmp.re * ijkTmp.re));
+  ijkErrLam.re        = float( sqrt(ijkErrCorr.re * ijkErrCorr.re));
   ijkErrLam.im        = 0.0;
 
 
@@ -1275,6 +1292,201 @@ AVOInversion::getNextErrorVariance(fftw_complex **& errVar,
   }
 }
 
+//--------------------------------------------------------------------
+// Posterior update of up to BatchComplexMatrix::WIDTH cells of the same
+// frequency slab, with the number of angles known at compile time. The cells
+// are factorized and solved together, one cell in each slot of the batch. The
+// result for each cell is the same as from the lib_matr sequence in
+// updatePosteriorCellsGeneric().
+//
+// Cell c has parVar at parVar + 9*c, errVar at errVar + NT*NT*c, mean at
+// mean + 3*c, and data and res at data + NT*c and res + NT*c. The matrices are
+// stored row by row. On return, parVar, mean and res are updated for all cells
+// with a positive definite marginal covariance. Other cells are left unchanged.
+// The data vectors are destroyed.
+template <int NT>
+void
+AVOInversion::updatePosteriorCells(int             nCells,
+                                   int             /*ntheta*/,
+                                   fftw_complex ** K,
+                                   fftw_complex  * parVar,
+                                   fftw_complex  * errVar,
+                                   fftw_complex  * mean,
+                                   fftw_complex  * data,
+                                   fftw_complex  * res)
+{
+  const int W = BatchComplexMatrix::WIDTH;
+
+  ComplexMatrixBatch<NT,3>  k;
+  ComplexMatrixBatch<NT,3>  KS;
+  ComplexMatrixBatch<3,NT>  KScc;
+  ComplexMatrixBatch<3,3>   s;
+  ComplexMatrixBatch<3,3>   reduceVar;
+  ComplexMatrixBatch<NT,NT> e;
+  ComplexMatrixBatch<NT,NT> margVar;
+  ComplexMatrixBatch<3,1>   m;
+  ComplexMatrixBatch<3,1>   ans;
+  ComplexMatrixBatch<NT,1>  d;
+  ComplexMatrixBatch<NT,1>  dataMean;
+  ComplexMatrixBatch<NT,1>  r;
+  int                       flag[W];
+
+  // K is common to all cells. Unused slots repeat the last cell.
+  for (int w = 0; w < W; w++) {
+    int c = std::min(w, nCells - 1);
+    for (int n = 0; n < NT; n++) {
+      for (int l = 0; l < 3; l++) {
+        k.re[n][l][w] = K[n][l].re;
+        k.im[n][l][w] = K[n][l].im;
+      }
+    }
+    s.setMatrix(w, parVar + 9*c);
+    e.setMatrix(w, errVar + NT*NT*c);
+    m.setMatrix(w, mean   + 3*c);
+    d.setMatrix(w, data   + NT*c);
+    r.setMatrix(w, res    + NT*c);
+  }
+
+  BatchComplexMatrix::prod(k, s, KS);                // KS = K*S
+  BatchComplexMatrix::prodAdjoint(KS, k, margVar);   // margVar = K*S*K'
+  BatchComplexMatrix::add(e, margVar);               // margVar = K*S*K' + errVar
+  BatchComplexMatrix::cholesky(margVar, flag);
+
+  BatchComplexMatrix::adjoint(KS, KScc);
+  BatchComplexMatrix::solveCholesky(margVar, KS);
+  BatchComplexMatrix::prod(KScc, KS, reduceVar);
+  BatchComplexMatrix::subtract(reduceVar, s);        // posterior covariance
+
+  BatchComplexMatrix::prod(k, m, dataMean);
+  BatchComplexMatrix::subtract(dataMean, d);
+  BatchComplexMatrix::adjointProd(KS, d, ans);
+  BatchComplexMatrix::add(ans, m);                   // posterior mean
+  BatchComplexMatrix::prod(k, m, d);
+  BatchComplexMatrix::subtract(d, r);                // residual
+
+  for (int c = 0; c < nCells; c++) {
+    if (flag[c] == 0) { // else posterior is identical to prior
+      s.getMatrix(c, parVar + 9*c);
+      m.getMatrix(c, mean   + 3*c);
+      r.getMatrix(c, res    + NT*c);
+    }
+  }
+}
+
+//--------------------------------------------------------------------
+// As updatePosteriorCells(), for any number of angles. Used when there is no
+// fixed-size instantiation for ntheta.
+void
+AVOInversion::updatePosteriorCellsGeneric(int             nCells,
+                                          int             ntheta,
+                                          fftw_complex ** K,
+                                          fftw_complex  * parVar,
+                                          fftw_complex  * errVar,
+                                          fftw_complex  * mean,
+                                          fftw_complex  * data,
+                                          fftw_complex  * res)
+{
+  fftw_complex * ijkDataMean = new fftw_complex[ntheta];
+  fftw_complex * ijkAns      = new fftw_complex[3];
+
+  fftw_complex ** KS      = new fftw_complex*[ntheta];
+  fftw_complex ** margVar = new fftw_complex*[ntheta];
+  fftw_complex ** eVar    = new fftw_complex*[ntheta];
+  for (int m = 0; m < ntheta; m++) {
+    KS[m]      = new fftw_complex[3];
+    margVar[m] = new fftw_complex[ntheta];
+    eVar[m]    = new fftw_complex[ntheta];
+  }
+  fftw_complex ** KScc      = new fftw_complex*[3]; // cc - complex conjugate (and transposed)
+  fftw_complex ** pVar      = new fftw_complex*[3];
+  fftw_complex ** reduceVar = new fftw_complex*[3];
+  for (int m = 0; m < 3; m++) {
+    KScc[m]      = new fftw_complex[ntheta];
+    pVar[m]      = new fftw_complex[3];
+    reduceVar[m] = new fftw_complex[3];
+  }
+
+  for (int c = 0; c < nCells; c++) {
+    fftw_complex * ijkMean = mean + 3*c;
+    fftw_complex * ijkData = data + ntheta*c;
+    fftw_complex * ijkRes  = res  + ntheta*c;
+
+    for (int m = 0; m < 3; m++)
+      for (int n = 0; n < 3; n++)
+        pVar[m][n] = parVar[9*c + 3*m + n];
+    for (int m = 0; m < ntheta; m++)
+      for (int n = 0; n < ntheta; n++)
+        eVar[m][n] = errVar[ntheta*ntheta*c + ntheta*m + n];
+
+    lib_matrProdCpx(K, pVar , ntheta, 3 ,3, KS);                 //  KS is defined here
+    lib_matrProdAdjointCpx(KS, K, ntheta, 3 ,ntheta, margVar);   // margVar = (K)S(K)' is defined here
+    lib_matrAddMatCpx(eVar, ntheta,ntheta, margVar);             // errVar  is added to margVar = (WDA)S(WDA)'  + errVar
+
+    int cholFlag=lib_matrCholCpx(ntheta,margVar);                // Choleskey factor of margVar is Defined
+
+    if(cholFlag==0)
+    { // then it is ok else posterior is identical to prior
+      lib_matrAdjoint(KS,ntheta,3,KScc);                         //  WDAScc is adjoint of WDAS
+      lib_matrAXeqBMatCpx(ntheta, margVar, KS, 3);               // redefines WDAS
+      lib_matrProdCpx(KScc,KS,3,ntheta,3,reduceVar);             // defines reduceVar
+      lib_matrSubtMatCpx(reduceVar,3,3,pVar);                    // redefines parVar as the posterior solution
+
+      lib_matrProdMatVecCpx(K,ijkMean, ntheta, 3, ijkDataMean);  //  defines content of ijkDataMean
+      lib_matrSubtVecCpx(ijkDataMean, ntheta, ijkData);          //  redefines content of ijkData
+
+      lib_matrProdAdjointMatVecCpx(KS,ijkData,3,ntheta,ijkAns);  // defines ijkAns
+
+      lib_matrAddVecCpx(ijkAns, 3,ijkMean);                      // redefines ijkMean
+      lib_matrProdMatVecCpx(K,ijkMean, ntheta, 3, ijkData);      // redefines ijkData
+      lib_matrSubtVecCpx(ijkData, ntheta,ijkRes);                // redefines ijkRes
+
+      for (int m = 0; m < 3; m++)
+        for (int n = 0; n < 3; n++)
+          parVar[9*c + 3*m + n] = pVar[m][n];
+    }
+  }
+
+  for (int m = 0; m < ntheta; m++) {
+    delete [] KS[m];
+    delete [] margVar[m];
+    delete [] eVar[m];
+  }
+  for (int m = 0; m < 3; m++) {
+    delete [] KScc[m];
+    delete [] pVar[m];
+    delete [] reduceVar[m];
+  }
+  delete [] KS;
+  delete [] margVar;
+  delete [] eVar;
+  delete [] KScc;
+  delete [] pVar;
+  delete [] reduceVar;
+  delete [] ijkDataMean;
+  delete [] ijkAns;
+}
+
+//--------------------------------------------------------------------
+AVOInversion::PosteriorCellUpdate
+AVOInversion::getPosteriorCellUpdate(int ntheta)
+{
+  switch (ntheta) {
+  case  1: return &updatePosteriorCells<1>;
+  case  2: return &updatePosteriorCells<2>;
+  case  3: return &updatePosteriorCells<3>;
+  case  4: return &updatePosteriorCells<4>;
+  case  5: return &updatePosteriorCells<5>;
+  case  6: return &updatePosteriorCells<6>;
+  case  7: return &updatePosteriorCells<7>;
+  case  8: return &updatePosteriorCells<8>;
+  case  9: return &updatePosteriorCells<9>;
+  case 10: return &updatePosteriorCells<10>;
+  case 11: return &updatePosteriorCells<11>;
+  case 12: return &updatePosteriorCells<12>;
+  default: return &updatePosteriorCellsGeneric;
+  }
+}
+
 void
 AVOInversion::fillkW(int k, fftw_complex* kW, std::vector<Wavelet *> seisWavelet) //Wavelet**
 {
@@ -1356,7 +1568,7 @@ AVOInversion::doPredictionKriging(SeismicParametersHolder & seismicParameters)
 }
 
 int
-AVOInversion::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomGen)
+AVOInversion::simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomGen, CravaResult * simulationOutput)
 {
   LogKit::WriteHeader("Simulating from posterior model");
 
@@ -1381,94 +1593,119 @@ AVOInversion::simulate(SeismicParametersHolder & seismicParameters, RandomGen *
     assert( postCrCovVsRho->getIsTransformed() );
 
     int             simNr,i,j,k,l;
-    fftw_complex ** ijkPostCov;
-    fftw_complex *  ijkSeed;
     FFTGrid *       seed0;
     FFTGrid *       seed1;
     FFTGrid *       seed2;
 
-    ijkPostCov = new fftw_complex*[3];
-    for (l=0;l<3;l++)
-      ijkPostCov[l]=new fftw_complex[3];
+    std::vector<FFTGrid *> postCov(6);
+    postCov[0] = postCovVp;
+    postCov[1] = postCovVs;
+    postCov[2] = postCovRho;
+    postCov[3] = postCrCovVpVs;
+    postCov[4] = postCrCovVpRho;
+    postCov[5] = postCrCovVsRho;
+
+    // With several realisations, the posterior covariance is factorized once.
+    std::vector<FFTGrid *> factors;
+    if (nSim_ > 1 && modelSettings_->getPrecomputeCholesky())
+      factors = computeCholeskyFactorGrids(postCov);
+
+    // The covariance grids are only used in the noise multiplication (when not
+    // factorized) and in the kriging, and are kept compressed in between.
+    for (l = 0; l < static_cast<int>(postCov.size()); l++)
+      postCov[l]->compress();
+
+    std::vector<FFTGrid *> & source = (factors.empty() ? postCov : factors);
 
-    ijkSeed = new fftw_complex[3];
+    // Seed grids are created with createFFTGrid(), and are on file only if fileGrid_ is set.
+    bool streamAccess = useStreamAccess(source);
+#ifdef PARALLEL
+    int  nThreads     = (streamAccess ? 1 : std::max(1, modelSettings_->getNumberOfThreads()));
+#endif
 
-    seed0 =  createFFTGrid();
-    seed1 =  createFFTGrid();
-    seed2 =  createFFTGrid();
-    seed0->createComplexGrid();
-    seed1->createComplexGrid();
-    seed2->createComplexGrid();
+    // Each realisation draws its noise from its own random streams, derived from
+    // the run seed and the realisation number. A realisation is therefore the same
+    // regardless of the number of threads and of the other realisations.
+    unsigned int simSeed = randomGen->drawSeed();
 
     // long int timestart, timeend;
 
+    seed0 = NULL;
+    seed1 = NULL;
+    seed2 = NULL;
+    std::vector<FFTGrid *> seeds(3);
+
     for (simNr = 0; simNr < nSim_;  simNr++)
     {
       // time(&timestart);
 
-      seed0->fillInComplexNoise(randomGen);
-      seed1->fillInComplexNoise(randomGen);
-      seed2->fillInComplexNoise(randomGen);
+      if (seed0 == NULL) {
+        seed0 = createFFTGrid();
+        seed1 = createFFTGrid();
+        seed2 = createFFTGrid();
+        seed0->createComplexGrid();
+        seed1->createComplexGrid();
+        seed2->createComplexGrid();
+        seeds[0] = seed0;
+        seeds[1] = seed1;
+        seeds[2] = seed2;
+      }
+
+      seed0->fillInComplexNoise(simSeed, simNr, 0);
+      seed1->fillInComplexNoise(simSeed, simNr, 1);
+      seed2->fillInComplexNoise(simSeed, simNr, 2);
 
-      postCovVp     ->setAccessMode(FFTGrid::READ);
-      postCovVs     ->setAccessMode(FFTGrid::READ);
-      postCovRho    ->setAccessMode(FFTGrid::READ);
-      postCrCovVpVs ->setAccessMode(FFTGrid::READ);
-      postCrCovVpRho->setAccessMode(FFTGrid::READ);
-      postCrCovVsRho->setAccessMode(FFTGrid::READ);
+      for (l = 0; l < static_cast<int>(source.size()); l++)
+        source[l]->setAccessMode(FFTGrid::READ);
       seed0 ->setAccessMode(FFTGrid::READANDWRITE);
       seed1 ->setAccessMode(FFTGrid::READANDWRITE);
       seed2 ->setAccessMode(FFTGrid::READANDWRITE);
 
       int cnxp=nxp_/2+1;
-      int cholFlag;
-      for (k = 0; k < nzp_; k++)
-        for (j = 0; j < nyp_; j++)
-          for (i = 0; i < cnxp; i++)
+#ifdef PARALLEL
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+      for (int kk = 0; kk < nzp_; kk++) {
+        fftw_complex values[6];
+        fftw_complex ijkPostCov[3][3];
+        fftw_complex ijkSeed[3];
+        for (int jj = 0; jj < nyp_; jj++) {
+          for (int ii = 0; ii < cnxp; ii++)
           {
-            ijkPostCov[0][0] = postCovVp     ->getNextComplex();
-            ijkPostCov[1][1] = postCovVs     ->getNextComplex();
-            ijkPostCov[2][2] = postCovRho    ->getNextComplex();
-            ijkPostCov[0][1] = postCrCovVpVs ->getNextComplex();
-            ijkPostCov[0][2] = postCrCovVpRho->getNextComplex();
-            ijkPostCov[1][2] = postCrCovVsRho->getNextComplex();
-
-            ijkPostCov[1][0].re =  ijkPostCov[0][1].re;
-            ijkPostCov[1][0].im = -ijkPostCov[0][1].im;
-            ijkPostCov[2][0].re =  ijkPostCov[0][2].re;
-            ijkPostCov[2][0].im = -ijkPostCov[0][2].im;
-            ijkPostCov[2][1].re =  ijkPostCov[1][2].re;
-            ijkPostCov[2][1].im = -ijkPostCov[1][2].im;
-
-            ijkSeed[0]=seed0->getNextComplex();
-            ijkSeed[1]=seed1->getNextComplex();
-            ijkSeed[2]=seed2->getNextComplex();
-
-            cholFlag = lib_matrCholCpx(3,ijkPostCov);  // Choleskey factor of posterior covariance write over ijkPostCov
+            int cholFlag;
+            getCellValues(source, streamAccess, ii, jj, kk, values);
+            if (factors.empty()) {
+              cholFlag = factorPosteriorCovariance(values, ijkPostCov);  // Choleskey factor of posterior covariance
+            }
+            else {
+              getCholeskyFactor(values, ijkPostCov);
+              cholFlag = 0;  // A failed factorization is stored as zero, and gives a zero seed.
+            }
+
+            getCellValues(seeds, streamAccess, ii, jj, kk, ijkSeed);
+
             if(cholFlag == 0)
             {
-              lib_matrProdCholVec(3,ijkPostCov,ijkSeed); // write over ijkSeed
+              SmallComplexMatrix::prodCholVec(ijkPostCov,ijkSeed); // write over ijkSeed
             }
             else
             {
-              for (l=0; l< 3;l++)
+              for (int m=0; m< 3;m++)
               {
-                ijkSeed[l].re =0.0;
-                ijkSeed[l].im = 0.0;
+                ijkSeed[m].re =0.0;
+                ijkSeed[m].im = 0.0;
               }
 
             }
-            seed0->setNextComplex(ijkSeed[0]);
-            seed1->setNextComplex(ijkSeed[1]);
-            seed2->setNextComplex(ijkSeed[2]);
+            setCellValues(seeds, streamAccess, ii, jj, kk, ijkSeed);
           }
+        }
+      }
 
-          postCovVp->endAccess();  //
-          postCovVs->endAccess();   //
-          postCovRho->endAccess();
-          postCrCovVpVs->endAccess();
-          postCrCovVpRho->endAccess();
-          postCrCovVsRho->endAccess();
+          for (l = 0; l < static_cast<int>(source.size()); l++)
+            source[l]->endAccess();
+          for (l = 0; l < static_cast<int>(postCov.size()); l++)
+            postCov[l]->compress();
           seed0->endAccess();
           seed1->endAccess();
           seed2->endAccess();
@@ -1519,11 +1756,22 @@ AVOInversion::simulate(SeismicParametersHolder & seismicParameters, RandomGen *
             TimeKit::getTime(wall2,cpu2);
             doPostKriging(seismicParameters, *seed0, *seed1, *seed2);
             Timings::addToTimeKrigingSim(wall2,cpu2);
+            for (l = 0; l < static_cast<int>(postCov.size()); l++) // Decompressed by the kriging
+              postCov[l]->compress();
           }
 
-          seismicParameters.AddSimulationSeed0(seed0);
-          seismicParameters.AddSimulationSeed1(seed1);
-          seismicParameters.AddSimulationSeed2(seed2);
+          if (simulationOutput != NULL) {
+            // The realisation is written and deleted now, so that memory use does not grow with nSim_.
+            simulationOutput->WriteSimulation(seed0, seed1, seed2, simNr);
+            seed0 = NULL;
+            seed1 = NULL;
+            seed2 = NULL;
+          }
+          else {
+            seismicParameters.AddSimulationSeed0(seed0);
+            seismicParameters.AddSimulationSeed1(seed1);
+            seismicParameters.AddSimulationSeed2(seed2);
+          }
 
           // time(&timeend);
           // printf("Back transform and write of simulation in %ld seconds \n",timeend-timestart);
@@ -1533,16 +1781,161 @@ AVOInversion::simulate(SeismicParametersHolder & seismicParameters, RandomGen *
     delete seed1;
     delete seed2;
 
-    for (l=0;l<3;l++)
-      delete  [] ijkPostCov[l];
-    delete [] ijkPostCov;
-    delete [] ijkSeed;
-
+    for (l = 0; l < static_cast<int>(factors.size()); l++)
+      delete factors[l];
   }
   Timings::setTimeSimulation(wall,cpu);
   return(0);
 }
 
+//--------------------------------------------------------------------
+// Reads cell (i,j,k) of each grid. With streamAccess the next cell is read, and
+// the grids must be in READ or READANDWRITE mode.
+void
+AVOInversion::getCellValues(const std::vector<FFTGrid *> & grids,
+                            bool                           streamAccess,
+                            int                            i,
+                            int                            j,
+                            int                            k,
+                            fftw_complex                 * values)
+{
+  for (size_t l = 0; l < grids.size(); l++)
+    values[l] = (streamAccess ? grids[l]->getNextComplex() : grids[l]->getComplexValue(i, j, k, true));
+}
+
+//--------------------------------------------------------------------
+void
+AVOInversion::setCellValues(const std::vector<FFTGrid *> & grids,
+                            bool                           streamAccess,
+                            int                            i,
+                            int                            j,
+                            int                            k,
+                            const fftw_complex           * values)
+{
+  for (size_t l = 0; l < grids.size(); l++) {
+    if (streamAccess)
+      grids[l]->setNextComplex(values[l]);
+    else
+      grids[l]->setComplexValue(i, j, k, values[l], true);
+  }
+}
+
+//--------------------------------------------------------------------
+// Computes the Cholesky factor of the posterior covariance in a cell, given as
+// (Vp, Vs, Rho, VpVs, VpRho, VsRho). Returns the flag from SmallComplexMatrix::cholesky().
+int
+AVOInversion::factorPosteriorCovariance(const fftw_complex * cov,
+                                        fftw_complex      (&L)[3][3])
+{
+  L[0][0] = cov[0];
+  L[1][1] = cov[1];
+  L[2][2] = cov[2];
+  L[0][1] = cov[3];
+  L[0][2] = cov[4];
+  L[1][2] = cov[5];
+
+  L[1][0].re =  L[0][1].re;
+  L[1][0].im = -L[0][1].im;
+  L[2][0].re =  L[0][2].re;
+  L[2][0].im = -L[0][2].im;
+  L[2][1].re =  L[1][2].re;
+  L[2][1].im = -L[1][2].im;
+
+  return SmallComplexMatrix::cholesky(L);
+}
+
+//--------------------------------------------------------------------
+// Cells are visited by index and by several threads when all grids are held
+// in memory. Grids on file must be streamed in storage order.
+bool
+AVOInversion::useStreamAccess(const std::vector<FFTGrid *> & grids) const
+{
+  bool streamAccess = fileGrid_;
+  for (size_t l = 0; l < grids.size(); l++)
+    streamAccess = streamAccess || grids[l]->isFile();
+  return streamAccess;
+}
+
+//--------------------------------------------------------------------
+// Computes the Cholesky factor of the posterior covariance in all cells,
+// for reuse in every realisation. The lower triangle is stored in five
+// complex grids: (L00,L11), (L22,0), L10, L20 and L21. The diagonal is
+// real and is therefore packed two by two. Cells where the factorization
+// fails are stored as zero.
+std::vector<FFTGrid *>
+AVOInversion::computeCholeskyFactorGrids(const std::vector<FFTGrid *> & postCov)
+{
+  std::vector<FFTGrid *> factors(5);
+  for (int l = 0; l < 5; l++) {
+    factors[l] = createFFTGrid();
+    factors[l]->createComplexGrid();
+    factors[l]->setAccessMode(FFTGrid::WRITE);
+  }
+  for (int l = 0; l < 6; l++)
+    postCov[l]->setAccessMode(FFTGrid::READ);
+
+  bool streamAccess = useStreamAccess(postCov) || useStreamAccess(factors);
+#ifdef PARALLEL
+  int  nThreads     = (streamAccess ? 1 : std::max(1, modelSettings_->getNumberOfThreads()));
+#endif
+
+  int cnxp = nxp_/2+1;
+#ifdef PARALLEL
+#pragma omp parallel for schedule(static) num_threads(nThreads)
+#endif
+  for (int k = 0; k < nzp_; k++) {
+    fftw_complex cov[6];
+    fftw_complex factor[5];
+    fftw_complex L[3][3];
+    for (int j = 0; j < nyp_; j++) {
+      for (int i = 0; i < cnxp; i++) {
+        getCellValues(postCov, streamAccess, i, j, k, cov);
+        if (factorPosteriorCovariance(cov, L) != 0) {
+          for (int m = 0; m < 3; m++) {
+            for (int n = 0; n < 3; n++) {
+              L[m][n].re = 0.0;
+              L[m][n].im = 0.0;
+            }
+          }
+        }
+        factor[0].re = L[0][0].re;
+        factor[0].im = L[1][1].re;
+        factor[1].re = L[2][2].re;
+        factor[1].im = 0.0;
+        factor[2]    = L[1][0];
+        factor[3]    = L[2][0];
+        factor[4]    = L[2][1];
+        setCellValues(factors, streamAccess, i, j, k, factor);
+      }
+    }
+  }
+
+  for (int l = 0; l < 6; l++)
+    postCov[l]->endAccess();
+  for (int l = 0; l < 5; l++)
+    factors[l]->endAccess();
+
+  return factors;
+}
+
+//--------------------------------------------------------------------
+// Unpacks a Cholesky factor stored by computeCholeskyFactorGrids(). Only
+// the lower triangle of L is set.
+void
+AVOInversion::getCholeskyFactor(const fftw_complex * factor,
+                                fftw_complex      (&L)[3][3])
+{
+  L[0][0].re = factor[0].re;
+  L[0][0].im = 0.0;
+  L[1][1].re = factor[0].im;
+  L[1][1].im = 0.0;
+  L[2][2].re = factor[1].re;
+  L[2][2].im = 0.0;
+  L[1][0]    = factor[2];
+  L[2][0]    = factor[3];
+  L[2][1]    = factor[4];
+}
+
 void
 AVOInversion::doPostKriging(SeismicParametersHolder & seismicParameters,
                             FFTGrid                 & postVp,
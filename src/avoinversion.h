@@ -26,6 +26,7 @@ class GridMapping;
 class ModelSettings;
 class SpatialWellFilter;
 class SeismicParametersHolder;
+class CravaResult;
 class SpatialSyntWellFilter;
 class SpatialRealWellFilter;
 
@@ -39,7 +40,8 @@ public:
                ModelGeneral            * modelGeneral,
                ModelAVOStatic          * modelAVOstatic,
                ModelAVODynamic         * modelAVOdynamic,
-               SeismicParametersHolder & seismicParameters);
+               SeismicParametersHolder & seismicParameters,
+               CravaResult             * simulationOutput = NULL);
 
   ~AVOInversion();
 
@@ -75,7 +77,7 @@ private:
   float                  getErrorVariance(int l)  const { return errorVariance_[l]  ;}
   float                  getDataVariance(int l)   const { return dataVariance_[l]   ;}
 
-  int                simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomGen );
+  int                simulate(SeismicParametersHolder & seismicParameters, RandomGen * randomGen, CravaResult * simulationOutput);
   int                computePostMeanResidAndFFTCov(ModelGeneral * modelGeneral);
   void               printEnergyToScreen();
   void               computeFaciesProb(SpatialRealWellFilter             * filteredRealLogs,
@@ -130,14 +132,69 @@ private:
   void                   SetComplexVector(NRLib::ComplexVector & V,
                                           fftw_complex         * v);
 
-  void                   getNextErrorVariance(fftw_complex **& errVar,
-                                              fftw_complex   * errMult1,
-                                              fftw_complex   * errMult2,
-                                              fftw_complex   * errMult3,
-                                              int              ntheta,
-                                              float            wnc,
-                                              double        ** errThetaCov,
-                                              bool             invert_frequency) const;
+  void                   getErrorVariance(fftw_complex **& errVar,
+                                          fftw_complex     ijkErrCorr,
+                                          fftw_complex   * errMult1,
+                                          fftw_complex   * errMult2,
+                                          fftw_complex   * errMult3,
+                                          int              ntheta,
+                                          float            wnc,
+                                          double        ** errThetaCov,
+                                          bool             invert_frequency) const;
+
+  typedef void           (*PosteriorCellUpdate)(int             nCells,
+                                                int             ntheta,
+                                                fftw_complex ** K,
+                                                fftw_complex  * parVar,
+                                                fftw_complex  * errVar,
+                                                fftw_complex  * mean,
+                                                fftw_complex  * data,
+                                                fftw_complex  * res);
+
+  static PosteriorCellUpdate getPosteriorCellUpdate(int ntheta);
+
+  static void            getCellValues(const std::vector<FFTGrid *> & grids,
+                                       bool                           streamAccess,
+                                       int                            i,
+                                       int                            j,
+                                       int                            k,
+                                       fftw_complex                 * values);
+
+  static void            setCellValues(const std::vector<FFTGrid *> & grids,
+                                       bool                           streamAccess,
+                                       int                            i,
+                                       int                            j,
+                                       int                            k,
+                                       const fftw_complex           * values);
+
+  static int             factorPosteriorCovariance(const fftw_complex * cov,
+                                                   fftw_complex      (&L)[3][3]);
+
+  static void            getCholeskyFactor(const fftw_complex * factor,
+                                           fftw_complex      (&L)[3][3]);
+
+  bool                   useStreamAccess(const std::vector<FFTGrid *> & grids) const;
+
+  std::vector<FFTGrid *> computeCholeskyFactorGrids(const std::vector<FFTGrid *> & postCov);
+
+  template <int NT>
+  static void            updatePosteriorCells(int             nCells,
+                                              int             ntheta,
+                                              fftw_complex ** K,
+                                              fftw_complex  * parVar,
+                                              fftw_complex  * errVar,
+                                              fftw_complex  * mean,
+                                              fftw_complex  * data,
+                                              fftw_complex  * res);
+
+  static void            updatePosteriorCellsGeneric(int             nCells,
+                                                     int             ntheta,
+                                                     fftw_complex ** K,
+                                                     fftw_complex  * parVar,
+                                                     fftw_complex  * errVar,
+                                                     fftw_complex  * mean,
+                                                     fftw_complex  * data,
+                                                     fftw_complex  * res);
 
 
   bool               fileGrid_;         // is true if is storage is on file
@@ -0,0 +1,329 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef BATCHCOMPLEXMATRIX_H
+#define BATCHCOMPLEXMATRIX_H
+
+#include <math.h>
+
+#include "fftw.h"
+
+// Complex matrix kernels applied to a batch of independent matrices of the same
+// fixed size, such as the covariance matrices of neighbouring frequency cells.
+//
+// The batch is stored as a structure of arrays: element (i,j) of all matrices is
+// held in WIDTH consecutive floats, and every kernel is written as an innermost
+// loop over the matrices of the batch. These loops have no dependencies between
+// matrices and are vectorized by the compiler (see simd= in Makeheader). Without
+// vector instructions the same loops run as plain scalar code.
+//
+// For each matrix in the batch the floating point operations are the same as in
+// the lib_matr function it replaces (lib_matrCholCpx, lib_matrAXeqBMatCpx and
+// lib_matrProdAdjointMatVecCpx in AVOInversion::updatePosteriorCellsGeneric).
+
+template <int N, int M> class ComplexMatrixBatch;
+
+class BatchComplexMatrix
+{
+public:
+  enum { WIDTH = 8 };  // Number of matrices in a batch
+
+  /// Cholesky factorization of each matrix, as SmallComplexMatrix::cholesky. flag[w] is
+  /// set to 1 if matrix w is not valid. The content of an invalid matrix is undefined
+  /// on return, but does not affect the other matrices of the batch.
+  template <int N>
+  static void cholesky(ComplexMatrixBatch<N,N> & x, int (&flag)[WIDTH]);
+
+  /// Solves A*X = B with A given by its Cholesky factor L, as lib_matrAXeqBMatCpx.
+  template <int N, int M>
+  static void solveCholesky(const ComplexMatrixBatch<N,N> & L, ComplexMatrixBatch<N,M> & x);
+
+  /// out = a*b
+  template <int N1, int N2, int N3>
+  static void prod(const ComplexMatrixBatch<N1,N2> & a, const ComplexMatrixBatch<N2,N3> & b, ComplexMatrixBatch<N1,N3> & out);
+
+  /// out = a*b'
+  template <int N1, int N2, int N3>
+  static void prodAdjoint(const ComplexMatrixBatch<N1,N2> & a, const ComplexMatrixBatch<N3,N2> & b, ComplexMatrixBatch<N1,N3> & out);
+
+  /// out = a'*b. With b a column vector this is lib_matrProdAdjointMatVecCpx.
+  template <int N1, int N2, int N3>
+  static void adjointProd(const ComplexMatrixBatch<N2,N1> & a, const ComplexMatrixBatch<N2,N3> & b, ComplexMatrixBatch<N1,N3> & out);
+
+  /// out = a'
+  template <int N1, int N2>
+  static void adjoint(const ComplexMatrixBatch<N1,N2> & a, ComplexMatrixBatch<N2,N1> & out);
+
+  /// y += x
+  template <int N, int M>
+  static void add(const ComplexMatrixBatch<N,M> & x, ComplexMatrixBatch<N,M> & y);
+
+  /// y -= x
+  template <int N, int M>
+  static void subtract(const ComplexMatrixBatch<N,M> & x, ComplexMatrixBatch<N,M> & y);
+
+private:
+  BatchComplexMatrix();
+};
+
+template <int N, int M>
+class ComplexMatrixBatch
+{
+public:
+  float re[N][M][BatchComplexMatrix::WIDTH];
+  float im[N][M][BatchComplexMatrix::WIDTH];
+
+  /// Copy an N x M row-major matrix into slot w of the batch
+  void setMatrix(int w, const fftw_complex * a) {
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < M; j++) {
+        re[i][j][w] = a[i*M + j].re;
+        im[i][j][w] = a[i*M + j].im;
+      }
+    }
+  }
+
+  /// Copy slot w of the batch to an N x M row-major matrix
+  void getMatrix(int w, fftw_complex * a) const {
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < M; j++) {
+        a[i*M + j].re = re[i][j][w];
+        a[i*M + j].im = im[i][j][w];
+      }
+    }
+  }
+};
+
+template <int N>
+void
+BatchComplexMatrix::cholesky(ComplexMatrixBatch<N,N> & x, int (&flag)[WIDTH])
+{
+  const double tol = 1e-20;
+  float factor[WIDTH];
+  for (int w = 0; w < WIDTH; w++) {
+    factor[w] = x.re[0][0][w];
+    flag[w]   = (factor[w] <= 0 ? 1 : 0);
+  }
+
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      for (int w = 0; w < WIDTH; w++) {
+        x.re[i][j][w] = x.re[i][j][w]/factor[w];
+        x.im[i][j][w] = x.im[i][j][w]/factor[w];
+      }
+    }
+  }
+
+  for (int i = 0; i < N; i++) {
+    for (int w = 0; w < WIDTH; w++)
+      flag[w] |= (x.re[i][i][w] <= tol ? 1 : 0);
+
+    float rre[WIDTH];
+    float rim[WIDTH];
+    for (int j = 0; j < i; j++) {
+      for (int w = 0; w < WIDTH; w++) {
+        rre[w] = 0.0;
+        rim[w] = 0.0;
+      }
+      for (int k = 0; k < j; k++) {
+        for (int w = 0; w < WIDTH; w++) {
+          rre[w] +=  (x.re[i][k][w] * x.re[j][k][w]) + (x.im[i][k][w] * x.im[j][k][w]);
+          rim[w] += -(x.re[i][k][w] * x.im[j][k][w]) + (x.im[i][k][w] * x.re[j][k][w]);
+        }
+      }
+      for (int w = 0; w < WIDTH; w++) {
+        float help    = x.re[j][j][w]*x.re[j][j][w] + x.im[j][j][w]*x.im[j][j][w];
+        x.re[i][j][w] = ((x.re[i][j][w] - rre[w])*x.re[j][j][w] + (x.im[i][j][w] - rim[w])*x.im[j][j][w])/help;
+        x.im[i][j][w] = ((x.im[i][j][w] - rim[w])*x.re[j][j][w] - (x.re[i][j][w] - rre[w])*x.im[j][j][w])/help;
+      }
+    }
+    for (int w = 0; w < WIDTH; w++)
+      rre[w] = 0.0;
+    for (int k = 0; k < i; k++) {
+      for (int w = 0; w < WIDTH; w++)
+        rre[w] += (x.re[i][k][w] * x.re[i][k][w]) + (x.im[i][k][w] * x.im[i][k][w]);
+    }
+    for (int w = 0; w < WIDTH; w++) {
+      rre[w]         = x.re[i][i][w] - rre[w];
+      flag[w]       |= (rre[w] <= tol ? 1 : 0);
+      x.re[i][i][w]  = static_cast<float>(sqrt(rre[w] > 0.0f ? rre[w] : 0.0f));
+      x.im[i][i][w]  = 0.0;
+    }
+  }
+
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j <= i; j++) {
+      for (int w = 0; w < WIDTH; w++) {
+        x.re[i][j][w] *= static_cast<float>(sqrt(factor[w] > 0.0f ? factor[w] : 0.0f));
+        x.im[i][j][w] *= static_cast<float>(sqrt(factor[w] > 0.0f ? factor[w] : 0.0f));
+      }
+    }
+  }
+}
+
+template <int N, int M>
+void
+BatchComplexMatrix::solveCholesky(const ComplexMatrixBatch<N,N> & L, ComplexMatrixBatch<N,M> & x)
+{
+  float sre[WIDTH];
+  float sim[WIDTH];
+  for (int c = 0; c < M; c++) {
+    for (int i = 0; i < N; i++) {
+      for (int w = 0; w < WIDTH; w++) {
+        sre[w] = x.re[i][c][w];
+        sim[w] = x.im[i][c][w];
+      }
+      for (int j = 0; j < i; j++) {
+        for (int w = 0; w < WIDTH; w++) {
+          sre[w] -= (x.re[j][c][w] * L.re[i][j][w] - x.im[j][c][w] * L.im[i][j][w]);
+          sim[w] -= (x.im[j][c][w] * L.re[i][j][w] + x.re[j][c][w] * L.im[i][j][w]);
+        }
+      }
+      for (int w = 0; w < WIDTH; w++) {
+        float help    = L.re[i][i][w]*L.re[i][i][w] + L.im[i][i][w]*L.im[i][i][w];
+        x.re[i][c][w] = (sre[w]*L.re[i][i][w] + sim[w]*L.im[i][i][w])/help;
+        x.im[i][c][w] = (sim[w]*L.re[i][i][w] - sre[w]*L.im[i][i][w])/help;
+      }
+    }
+    for (int i = N - 1; i >= 0; i--) {
+      for (int w = 0; w < WIDTH; w++) {
+        sre[w] = x.re[i][c][w];
+        sim[w] = x.im[i][c][w];
+      }
+      for (int j = N - 1; j > i; j--) {
+        for (int w = 0; w < WIDTH; w++) {
+          sre[w] = sre[w] - ( x.re[j][c][w] * L.re[j][i][w] + x.im[j][c][w] * L.im[j][i][w]);
+          sim[w] = sim[w] - (-x.re[j][c][w] * L.im[j][i][w] + x.im[j][c][w] * L.re[j][i][w]);
+        }
+      }
+      for (int w = 0; w < WIDTH; w++) {
+        float help    = L.re[i][i][w]*L.re[i][i][w] + L.im[i][i][w]*L.im[i][i][w];
+        x.re[i][c][w] = (sre[w]*L.re[i][i][w] - sim[w]*L.im[i][i][w])/help;
+        x.im[i][c][w] = (sim[w]*L.re[i][i][w] + sre[w]*L.im[i][i][w])/help;
+      }
+    }
+  }
+}
+
+template <int N1, int N2, int N3>
+void
+BatchComplexMatrix::prod(const ComplexMatrixBatch<N1,N2> & a, const ComplexMatrixBatch<N2,N3> & b, ComplexMatrixBatch<N1,N3> & out)
+{
+  for (int i = 0; i < N1; i++) {
+    for (int j = 0; j < N3; j++) {
+      float sre[WIDTH];
+      float sim[WIDTH];
+      for (int w = 0; w < WIDTH; w++) {
+        sre[w] = 0.0;
+        sim[w] = 0.0;
+      }
+      for (int k = 0; k < N2; k++) {
+        for (int w = 0; w < WIDTH; w++) {
+          sre[w] += a.re[i][k][w]*b.re[k][j][w] - a.im[i][k][w]*b.im[k][j][w];
+          sim[w] += a.im[i][k][w]*b.re[k][j][w] + a.re[i][k][w]*b.im[k][j][w];
+        }
+      }
+      for (int w = 0; w < WIDTH; w++) {
+        out.re[i][j][w] = sre[w];
+        out.im[i][j][w] = sim[w];
+      }
+    }
+  }
+}
+
+template <int N1, int N2, int N3>
+void
+BatchComplexMatrix::prodAdjoint(const ComplexMatrixBatch<N1,N2> & a, const ComplexMatrixBatch<N3,N2> & b, ComplexMatrixBatch<N1,N3> & out)
+{
+  for (int i = 0; i < N1; i++) {
+    for (int j = 0; j < N3; j++) {
+      float sre[WIDTH];
+      float sim[WIDTH];
+      for (int w = 0; w < WIDTH; w++) {
+        sre[w] = 0.0;
+        sim[w] = 0.0;
+      }
+      for (int k = 0; k < N2; k++) {
+        for (int w = 0; w < WIDTH; w++) {
+          sre[w] += a.re[i][k][w]*b.re[j][k][w] + a.im[i][k][w]*b.im[j][k][w];
+          sim[w] += a.im[i][k][w]*b.re[j][k][w] - a.re[i][k][w]*b.im[j][k][w];
+        }
+      }
+      for (int w = 0; w < WIDTH; w++) {
+        out.re[i][j][w] = sre[w];
+        out.im[i][j][w] = sim[w];
+      }
+    }
+  }
+}
+
+template <int N1, int N2, int N3>
+void
+BatchComplexMatrix::adjointProd(const ComplexMatrixBatch<N2,N1> & a, const ComplexMatrixBatch<N2,N3> & b, ComplexMatrixBatch<N1,N3> & out)
+{
+  for (int i = 0; i < N1; i++) {
+    for (int j = 0; j < N3; j++) {
+      float sre[WIDTH];
+      float sim[WIDTH];
+      for (int w = 0; w < WIDTH; w++) {
+        sre[w] = 0.0;
+        sim[w] = 0.0;
+      }
+      for (int k = 0; k < N2; k++) {
+        for (int w = 0; w < WIDTH; w++) {
+          sre[w] +=  a.re[k][i][w]*b.re[k][j][w] + a.im[k][i][w]*b.im[k][j][w];
+          sim[w] += -a.im[k][i][w]*b.re[k][j][w] + a.re[k][i][w]*b.im[k][j][w];
+        }
+      }
+      for (int w = 0; w < WIDTH; w++) {
+        out.re[i][j][w] = sre[w];
+        out.im[i][j][w] = sim[w];
+      }
+    }
+  }
+}
+
+template <int N1, int N2>
+void
+BatchComplexMatrix::adjoint(const ComplexMatrixBatch<N1,N2> & a, ComplexMatrixBatch<N2,N1> & out)
+{
+  for (int i = 0; i < N1; i++) {
+    for (int j = 0; j < N2; j++) {
+      for (int w = 0; w < WIDTH; w++) {
+        out.re[j][i][w] =  a.re[i][j][w];
+        out.im[j][i][w] = -a.im[i][j][w];
+      }
+    }
+  }
+}
+
+template <int N, int M>
+void
+BatchComplexMatrix::add(const ComplexMatrixBatch<N,M> & x, ComplexMatrixBatch<N,M> & y)
+{
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < M; j++) {
+      for (int w = 0; w < WIDTH; w++) {
+        y.re[i][j][w] += x.re[i][j][w];
+        y.im[i][j][w] += x.im[i][j][w];
+      }
+    }
+  }
+}
+
+template <int N, int M>
+void
+BatchComplexMatrix::subtract(const ComplexMatrixBatch<N,M> & x, ComplexMatrixBatch<N,M> & y)
+{
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < M; j++) {
+      for (int w = 0; w < WIDTH; w++) {
+        y.re[i][j][w] -= x.re[i][j][w];
+        y.im[i][j][w] -= x.im[i][j][w];
+      }
+    }
+  }
+}
+
+#endif
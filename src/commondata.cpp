@@ -8,6 +8,7 @@
 #include "src/commondata.h"
 #include "src/fftgrid.h"
 #include "src/fftfilegrid.h"
+#include "src/cravagridfile.h"
 #include "src/wavelet.h"
 #include "src/wavelet1D.h"
 #include "src/wavelet3D.h"
@@ -19,6 +20,8 @@
 
 #include "lib/timekit.hpp"
 #include "src/timings.h"
+#include "src/fftplancache.h"
+#include "src/sincinterpolator.h"
 
 CommonData::CommonData(ModelSettings * model_settings,
                        InputFiles    * input_files):
@@ -794,10 +797,17 @@ bool CommonData::ReadSeismicData(ModelSettings                               * m
           bool only_volume      = true;
 
           try {
-            segy->ReadAllTraces(&full_inversion_simbox,
-                                padding,
-                                only_volume,
-                                relative_padding);
+            if (model_settings->getUseSegyIndex()) // Trace positions are known, so read only the traces needed
+              segy->ReadTracesInVolume(&full_inversion_simbox,
+                                       padding,
+                                       relative_padding,
+                                       model_settings->getNumberOfThreads());
+            else
+              segy->ReadAllTraces(&full_inversion_simbox,
+                                  padding,
+                                  only_volume,
+                                  relative_padding,
+                                  model_settings->getNumberOfThreads());
           }
           catch (NRLib::Exception & e) {
             err_text += NRLib::ToString(e.what());
@@ -814,7 +824,7 @@ bool CommonData::ReadSeismicData(ModelSettings                               * m
 
           try {
             stormgrid = new StormContGrid(0,0,0);
-            stormgrid->ReadFromFile(file_name);
+            stormgrid->ReadFromFile(file_name, true, NRLib::END_BIG_ENDIAN, model_settings->getNumberOfThreads());
           }
           catch (NRLib::Exception & e) {
             err_text += "Error when reading storm-file " + file_name +": " + NRLib::ToString(e.what()) + "\n";
@@ -4227,31 +4237,12 @@ CommonData::GetGeometryFromGridOnFile(const std::string           grid_file,
 
 SegyGeometry * CommonData::GetGeometryFromCravaFile(const std::string & file_name) const
 {
-  std::ifstream bin_file;
-  NRLib::OpenRead(bin_file, file_name, std::ios::in | std::ios::binary);
-
-  std::string file_type;
-  getline(bin_file,file_type);
-
-  double x0        = NRLib::ReadBinaryDouble(bin_file);
-  double y0        = NRLib::ReadBinaryDouble(bin_file);
-  double dx        = NRLib::ReadBinaryDouble(bin_file);
-  double dy        = NRLib::ReadBinaryDouble(bin_file);
-  int    nx        = NRLib::ReadBinaryInt(bin_file);
-  int    ny        = NRLib::ReadBinaryInt(bin_file);
-  double IL0       = NRLib::ReadBinaryDouble(bin_file);
-  double XL0       = NRLib::ReadBinaryDouble(bin_file);
-  double il_step_X = NRLib::ReadBinaryDouble(bin_file);
-  double il_step_Y = NRLib::ReadBinaryDouble(bin_file);
-  double xl_step_X = NRLib::ReadBinaryDouble(bin_file);
-  double xl_step_Y = NRLib::ReadBinaryDouble(bin_file);
-  double rot       = NRLib::ReadBinaryDouble(bin_file);
-
-  bin_file.close();
-
-  SegyGeometry * geometry = new SegyGeometry(x0, y0, dx, dy, nx, ny, ///< When XL, IL is available.
-                                             IL0, XL0, il_step_X, il_step_Y,
-                                             xl_step_X, xl_step_Y, rot);
+  CravaGridFile file(file_name);
+
+  SegyGeometry * geometry = new SegyGeometry(file.getx0(), file.gety0(), file.getdx(), file.getdy(),
+                                             file.getnx(), file.getny(), ///< When XL, IL is available.
+                                             file.getIL0(), file.getXL0(), file.getILStepX(), file.getILStepY(),
+                                             file.getXLStepX(), file.getXLStepY(), file.getAngle());
   return(geometry);
 }
 
@@ -4260,8 +4251,9 @@ SegyGeometry * CommonData::GetGeometryFromStormFile(const std::string & file_nam
                                                     bool                scale) const
 {
   SegyGeometry  * geometry  = NULL;
-  StormContGrid * storm_grid = NULL;
   std::string     tmp_err_text;
+  double x0, y0, dx, dy, rot;
+  int    nx, ny;
   float scale_hor;
   if (scale==false)
   {
@@ -4274,9 +4266,27 @@ SegyGeometry * CommonData::GetGeometryFromStormFile(const std::string & file_nam
   }
   try
   {
-    storm_grid = new StormContGrid(0,0,0);
-    storm_grid->ReadFromFile(file_name);
-    storm_grid->SetMissingCode(RMISSING);
+    if (scale == false) { // Only the header of a STORM file is read
+      NRLib::StormContGridLayerReader storm_header(file_name);
+      x0  = storm_header.GetXMin()*scale_hor;
+      y0  = storm_header.GetYMin()*scale_hor;
+      dx  = storm_header.GetLX()/storm_header.GetNI()*scale_hor;
+      dy  = storm_header.GetLY()/storm_header.GetNJ()*scale_hor;
+      nx  = static_cast<int>(storm_header.GetNI());
+      ny  = static_cast<int>(storm_header.GetNJ());
+      rot = storm_header.GetAngle();
+    }
+    else {
+      StormContGrid storm_grid(0,0,0);
+      storm_grid.ReadFromFile(file_name);
+      x0  = storm_grid.GetXMin()*scale_hor;
+      y0  = storm_grid.GetYMin()*scale_hor;
+      dx  = storm_grid.GetDX()*scale_hor;
+      dy  = storm_grid.GetDY()*scale_hor;
+      nx  = static_cast<int>(storm_grid.GetNI());
+      ny  = static_cast<int>(storm_grid.GetNJ());
+      rot = storm_grid.GetAngle();
+    }
   }
   catch (NRLib::Exception & e)
   {
@@ -4284,13 +4294,6 @@ SegyGeometry * CommonData::GetGeometryFromStormFile(const std::string & file_nam
   }
 
   if (tmp_err_text == "") {
-    double x0        = storm_grid->GetXMin()*scale_hor;
-    double y0        = storm_grid->GetYMin()*scale_hor;
-    double dx        = storm_grid->GetDX()*scale_hor;
-    double dy        = storm_grid->GetDY()*scale_hor;
-    int    nx        = static_cast<int>(storm_grid->GetNI());
-    int    ny        = static_cast<int>(storm_grid->GetNJ());
-    double rot       = storm_grid->GetAngle();
     double IL0       = 0.0;  ///< Dummy value since information is not contained in format
     double XL0       = 0.0;  ///< Dummy value since information is not contained in format
     double IL_step_X =   1;  ///< Dummy value since information is not contained in format
@@ -4305,9 +4308,6 @@ SegyGeometry * CommonData::GetGeometryFromStormFile(const std::string & file_nam
     err_text += tmp_err_text;
   }
 
-  if (storm_grid != NULL)
-    delete storm_grid;
-
   return(geometry);
 }
 
@@ -4414,7 +4414,12 @@ int CommonData::GetNzFromGridOnFile(ModelSettings     * model_settings,
         delete segy;
     }
 
-    else if (file_type == IO::STORM || file_type == IO::SGRI) {
+    else if (file_type == IO::STORM) {
+      NRLib::StormContGridLayerReader storm_header(grid_file); // Header only
+      nz = static_cast<int>(storm_header.GetNK());
+    }
+
+    else if (file_type == IO::SGRI) {
 
       StormContGrid * stormgrid = NULL;
       stormgrid = new StormContGrid(0,0,0);
@@ -5994,30 +5999,8 @@ void CommonData::GetZPaddingFromCravaFile(const std::string & file_name,
 {
   std::string err_text_tmp;
   try {
-    std::ifstream bin_file;
-    NRLib::OpenRead(bin_file, file_name, std::ios::in | std::ios::binary);
-
-    std::string file_type;
-    getline(bin_file, file_type);
-
-    double dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryInt(bin_file);
-    dummy = NRLib::ReadBinaryInt(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryDouble(bin_file);
-    dummy = NRLib::ReadBinaryInt(bin_file); //rnxp
-    dummy = NRLib::ReadBinaryInt(bin_file);
-    nz_pad = NRLib::ReadBinaryInt(bin_file);
-
-   bin_file.close();
+    CravaGridFile file(file_name);
+    nz_pad = file.getNZP();
   }
   catch (NRLib::Exception & e) {
     err_text_tmp = std::string("Error: ") + e.what() + "\n";
@@ -6075,7 +6058,8 @@ CommonData::ReadSegyFile(const std::string                 & file_name,
       segy->ReadAllTraces(volume,
                           padding,
                           only_volume,
-                          relative_padding);
+                          relative_padding,
+                          model_settings->getNumberOfThreads());
     }
     catch (NRLib::Exception & e) {
       err_text += NRLib::ToString(e.what());
@@ -6130,7 +6114,13 @@ CommonData::ReadSegyFile(const std::string                 & file_name,
                  missing_traces_simbox,
                  missing_traces_padding,
                  dead_traces_simbox,
-                 grid_type);
+                 grid_type,
+                 false,
+                 true,  //is_segy
+                 false, //is_storm
+                 false, //is_seismic
+                 model_settings->getNumberOfThreads(),
+                 model_settings->getUseFFTResampling());
       if (stormgrid_tmp != NULL)
        delete stormgrid_tmp;
       if (fft_grid_tmp != NULL)
@@ -6187,10 +6177,15 @@ void CommonData::FillInData(NRLib::Grid<float>  * grid_new,
                             bool                  scale,
                             bool                  is_segy,
                             bool                  is_storm,
-                            bool                  is_seismic) const
+                            bool                  is_seismic,
+                            int                   n_threads,
+                            bool                  fft_resampling) const
 {
   //Resample to either a NRLib::Grid or a FFTGrid.
   //The one resampled to needs to be defined outside this function, and the other needs to be sent in as an empty grid.
+  //
+  //Each trace is either interpolated directly with a windowed sinc, or refined by FFT and zero padding and then
+  //interpolated linearly (fft_resampling). Traces are resampled in parallel, each thread using its own work arrays.
   float res_fac = 10.0; //Degree of refinement, must be integer.
 
   assert(grid_type != CTMISSING);
@@ -6206,6 +6201,7 @@ void CommonData::FillInData(NRLib::Grid<float>  * grid_new,
     scalevert = 0.001f; //1000.0;
     scalehor  = 0.001f; //1000.0;
   }
+  smooth_length *= scalevert;
 
   int nx, ny, nz, nxp, nyp, nzp, rnxp;
 
@@ -6221,6 +6217,8 @@ void CommonData::FillInData(NRLib::Grid<float>  * grid_new,
     nyp  = fft_grid_new->getNyp();
     nzp  = fft_grid_new->getNzp();
     rnxp = fft_grid_new->getRNxp();
+    if (fft_grid_new->isFile())
+      n_threads = 1; // Values of grids on file must be set in order
   }
   else {
     nx   = grid_new->GetNI();
@@ -6244,245 +6242,280 @@ void CommonData::FillInData(NRLib::Grid<float>  * grid_new,
   // Find proper length of time samples to get N*log(N) performance in FFT.
   //
   size_t n_samples = 0;
-  float  dz_data   = 0.0f;
-  float  dz_min    = 0.0f;
+  float  dz_segy   = 0.0f;
   if (is_segy) {
     n_samples = segy->FindNumberOfSamplesInLongestTrace();
-    dz_data   = segy->GetDz();
-    dz_min    = dz_data/res_fac;
+    dz_segy   = segy->GetDz();
   }
   else if (is_storm) {
     n_samples = storm_grid->GetNK();
   }
 
-  int nt = FindClosestFactorableNumber(static_cast<int>(n_samples));
-  int mt = static_cast<int>(res_fac)*nt;           // Use four times the sampling density for the fine-meshed data
+  int nt_max = FindClosestFactorableNumber(static_cast<int>(n_samples));
+  int mt_max = static_cast<int>(res_fac)*nt_max;
 
-  //
-  // Create FFT plans
-  //
-  //rfftwnd_plan fftplan1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
-  //rfftwnd_plan fftplan2 = rfftwnd_create_plan(1, &mt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
+  SincInterpolator sinc;
 
   //
   // Do resampling
   //
-  missing_traces_simbox  = 0; // Part of simbox is outside seismic data
-  missing_traces_padding = 0; // Part of padding is outside seismic data
-  dead_traces_simbox     = 0; // Simbox is inside seismic data but trace is missing
-
-  for (int j = 0; j < nyp; j++) {
-    for (int i = 0; i < rnxp; i++) {
-
-      rfftwnd_plan fftplan1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
-      rfftwnd_plan fftplan2 = rfftwnd_create_plan(1, &mt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
-
-      int refi = GetFillNumber(i, nx, nxp); // Find index (special treatment for padding)
-      int refj = GetFillNumber(j, ny, nyp); // Find index (special treatment for padding)
-      int refk = 0;
-
-      double x  = 0.0;
-      double y  = 0.0;
-      double z0 = 0.0;
-      simbox->getCoord(refi, refj, refk, x, y, z0);  // Get lateral position and z-start (z0)
-      x  *= scalehor;
-      y  *= scalehor;
-      z0 *= scalevert;
-
-      double dz = simbox->getdz(refi, refj)*scalevert;
-      float  xf = static_cast<float>(x);
-      float  yf = static_cast<float>(y);
-
-      bool is_inside = false;
-      if (is_segy)
-        is_inside = segy->GetGeometry()->IsInside(xf, yf);
-      else if (is_storm) {
-        if (storm_grid->IsInside(xf, yf) == 1)
-          is_inside = true;
-      }
-
-      if (is_inside == true) {
-        bool  missing = true;
-        float z0_data = RMISSING;
-
-        std::vector<float> data_trace;
-
-        //Get data_trace for this i and j.
-        if (is_segy) {
-          segy->GetNearestTrace(data_trace, missing, z0_data, xf, yf);
-          if (is_seismic)
-            z0_data = z0_data-0.5f*segy->GetDz();
-        }
-        else if (is_storm) {
-          size_t i_in, j_in, k_in;
-
-          storm_grid->FindIndex(x, y, z0, i_in, j_in, k_in);
-
-          double grid_x = 0.0;
-          double grid_y = 0.0;
-          double grid_z = 0.0;
-          float  value  = 0.0f;
-          storm_grid->FindCenterOfCell(i_in, j_in, 0, grid_x, grid_y, grid_z);
-          float z_min = static_cast<float>(grid_z);
-          storm_grid->FindCenterOfCell(i_in, j_in, storm_grid->GetNK()-1, grid_x, grid_y, grid_z);
-          float z_max = static_cast<float>(grid_z);
-
-          for (k_in = 0; k_in < storm_grid->GetNK(); k_in++) {
-            value = storm_grid->GetValue(i_in, j_in, k_in);
-            data_trace.push_back(value);
-          }
+  int n_missing_simbox  = 0; // Part of simbox is outside seismic data
+  int n_missing_padding = 0; // Part of padding is outside seismic data
+  int n_dead_simbox     = 0; // Simbox is inside seismic data but trace is missing
+  int n_rows_done       = 0;
 
-          dz_data = (z_max- z_min) / (storm_grid->GetNK()-1);
-          dz_min = dz_data/res_fac;
-          z0_data = z_min;
-        }
-        size_t n_trace = data_trace.size();
-        float trend_first = 0.0f;
-        float trend_last  = 0.0f;
-
-        if (grid_type != DATA) {
-          //Remove zeroes. F.ex. background on segy-format with a non-constant top-surface, the vector is filled with zeroes at the beginning.
-          if (data_trace[0] == 0) {
-            std::vector<float> data_trace_new;
-            for (size_t k_trace = 0; k_trace < n_trace; k_trace++) {
-              if (data_trace[k_trace] != 0)
-                data_trace_new.push_back(data_trace[k_trace]);
-            }
-            data_trace = data_trace_new;
-            n_trace = data_trace.size();
-          }
+  std::string err_text = "";
 
-          n_samples = data_trace.size();
-          nt = FindClosestFactorableNumber(static_cast<int>(n_samples));
-          mt = static_cast<int>(res_fac)*nt;
-          fftwnd_destroy_plan(fftplan1);
-          fftwnd_destroy_plan(fftplan2);
-          fftplan1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
-          fftplan2 = rfftwnd_create_plan(1, &mt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
-
-          //Remove trend from trace
-          trend_first = data_trace[0];
-          trend_last = data_trace[n_trace - 1];
-          float trend_inc = (trend_last - trend_first) / (n_trace - 1);
-          for (size_t k_trace = 0; k_trace < data_trace.size(); k_trace++) {
-            data_trace[k_trace] -= trend_first + k_trace * trend_inc;
+#ifdef PARALLEL
+#pragma omp parallel num_threads(n_threads)
+#endif
+  {
+    //
+    // Work arrays of this thread. The FFT arrays are made for the longest trace, and
+    // FFT plans are taken from the plan cache, which shares them between threads.
+    //
+    fftw_real * rAmpData = NULL;
+    fftw_real * rAmpFine = NULL;
+    if (fft_resampling) {
+      rAmpData = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*2*(nt_max/2 + 1)));
+      rAmpFine = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*2*(mt_max/2 + 1)));
+    }
+
+    std::vector<float> data_trace;
+    std::vector<float> grid_trace(nzp);
+    std::vector<float> trend_interpolated(nzp);
+    std::vector<float> data_trace_trend_long;
+
+#ifdef PARALLEL
+#pragma omp for schedule(dynamic,1) reduction(+:n_missing_simbox, n_missing_padding, n_dead_simbox)
+#endif
+    for (int j = 0; j < nyp; j++) {
+      try {
+        for (int i = 0; i < rnxp; i++) {
+          int refi = GetFillNumber(i, nx, nxp); // Find index (special treatment for padding)
+          int refj = GetFillNumber(j, ny, nyp); // Find index (special treatment for padding)
+          int refk = 0;
+
+          double x  = 0.0;
+          double y  = 0.0;
+          double z0 = 0.0;
+          simbox->getCoord(refi, refj, refk, x, y, z0);  // Get lateral position and z-start (z0)
+          x  *= scalehor;
+          y  *= scalehor;
+          z0 *= scalevert;
+
+          double dz = simbox->getdz(refi, refj)*scalevert;
+          float  xf = static_cast<float>(x);
+          float  yf = static_cast<float>(y);
+
+          bool is_inside = false;
+          if (is_segy)
+            is_inside = segy->GetGeometry()->IsInside(xf, yf);
+          else if (is_storm) {
+            if (storm_grid->IsInside(xf, yf) == 1)
+              is_inside = true;
           }
-        }
 
-        if (is_segy == false || (is_segy == true && !missing)) {
-          int         cnt      = nt/2 + 1;
-          int         rnt      = 2*cnt;
-          int         cmt      = mt/2 + 1;
-          int         rmt      = 2*cmt;
+          if (is_inside == true) {
+            bool  missing = true;
+            float z0_data = RMISSING;
+            float dz_data = dz_segy;
 
-          fftw_real * rAmpData = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rnt));
-          fftw_real * rAmpFine = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rmt));
+            //Get data_trace for this i and j.
+            if (is_segy) {
+              segy->GetNearestTrace(data_trace, missing, z0_data, xf, yf);
+              if (is_seismic)
+                z0_data = z0_data-0.5f*segy->GetDz();
+            }
+            else if (is_storm) {
+              size_t i_in, j_in, k_in;
 
-          float       dz_grid  = static_cast<float>(dz);
-          float       z0_grid  = static_cast<float>(z0);
-          if (is_seismic)
-            z0_grid += 0.5f*static_cast<float>(dz);
+              storm_grid->FindIndex(x, y, z0, i_in, j_in, k_in);
 
-          std::vector<float> grid_trace(nzp);
+              double grid_x = 0.0;
+              double grid_y = 0.0;
+              double grid_z = 0.0;
+              storm_grid->FindCenterOfCell(i_in, j_in, 0, grid_x, grid_y, grid_z);
+              float z_min = static_cast<float>(grid_z);
+              storm_grid->FindCenterOfCell(i_in, j_in, storm_grid->GetNK()-1, grid_x, grid_y, grid_z);
+              float z_max = static_cast<float>(grid_z);
 
-          smooth_length*=scalevert;
-          if (grid_type == DATA) {
-            SmoothTraceInGuardZone(data_trace,
-                                   dz_data,
-                                   smooth_length);
-          }
+              data_trace.resize(storm_grid->GetNK());
+              for (k_in = 0; k_in < storm_grid->GetNK(); k_in++)
+                data_trace[k_in] = storm_grid->GetValue(i_in, j_in, k_in);
 
-          ResampleTrace(data_trace,
-                        fftplan1,
-                        fftplan2,
-                        rAmpData,
-                        rAmpFine,
-                        cnt,
-                        rnt,
-                        cmt,
-                        rmt);
-
-          std::vector<float> data_trace_trend_long;
-          if (grid_type != DATA) {
-            float trend_inc = (trend_last - trend_first) / (res_fac*(n_trace - 1));
-
-            data_trace_trend_long.resize(rmt);
-            for (int k_trace = 0; k_trace < rmt; k_trace++) {
-              data_trace_trend_long[k_trace] = trend_first + k_trace * trend_inc;
+              dz_data = (z_max- z_min) / (storm_grid->GetNK()-1);
+              z0_data = z_min;
             }
-          }
+            size_t n_trace = data_trace.size();
+            int    nt      = nt_max;
+            float trend_first = 0.0f;
+            float trend_last  = 0.0f;
+
+            if (grid_type != DATA) {
+              //Remove zeroes. F.ex. background on segy-format with a non-constant top-surface, the vector is filled with zeroes at the beginning.
+              if (data_trace[0] == 0) {
+                std::vector<float> data_trace_new;
+                for (size_t k_trace = 0; k_trace < n_trace; k_trace++) {
+                  if (data_trace[k_trace] != 0)
+                    data_trace_new.push_back(data_trace[k_trace]);
+                }
+                data_trace.swap(data_trace_new);
+                n_trace = data_trace.size();
+              }
 
-          //Includes a shift
-          InterpolateGridValues(grid_trace,
-                                z0_grid,     // Centre of first cell
-                                dz_grid,
-                                rAmpFine,
-                                z0_data,     // Time of first data sample
-                                dz_min,
-                                rmt,
-                                nz,
-                                nzp);
-
-          //Interpolate and shift trend before adding to grid_trace.
-          //Alternative: add trend before interpolating and change values under l2 < 0 || l1 > n_fine
-          if (grid_type != DATA) {
-            std::vector<float> trend_interpolated(nzp);
-            InterpolateAndShiftTrend(trend_interpolated,
-                                     z0_grid,     // Centre of first cell
-                                     dz_grid,
-                                     data_trace_trend_long,
-                                     z0_data,     // Time of first data sample
-                                     dz_min,
-                                     rmt,
-                                     nz,
-                                     nzp);
-
-            //Add trend
-            for (size_t k_trace = 0; k_trace < grid_trace.size(); k_trace++)
-              grid_trace[k_trace] += trend_interpolated[k_trace];
-          }
+              nt = FindClosestFactorableNumber(static_cast<int>(n_trace));
 
-          fftw_free(rAmpData);
-          fftw_free(rAmpFine);
+              //Remove trend from trace
+              trend_first = data_trace[0];
+              trend_last = data_trace[n_trace - 1];
+              float trend_inc = (trend_last - trend_first) / (n_trace - 1);
+              for (size_t k_trace = 0; k_trace < data_trace.size(); k_trace++) {
+                data_trace[k_trace] -= trend_first + k_trace * trend_inc;
+              }
+            }
 
-          if (is_nrlib_grid)
-            SetTrace(grid_trace, grid_new, i, j);
-          else
-            SetTrace(grid_trace, fft_grid_new, i, j);
-        }
-        else {
-          if (is_nrlib_grid)
-            SetTrace(0.0f, grid_new, i, j); // Dead traces (in case we allow them)
-          else
-            SetTrace(0.0f, fft_grid_new, i, j);
+            if (is_segy == false || (is_segy == true && !missing)) {
+              float       dz_grid  = static_cast<float>(dz);
+              float       z0_grid  = static_cast<float>(z0);
+              if (is_seismic)
+                z0_grid += 0.5f*static_cast<float>(dz);
+
+              if (grid_type == DATA) {
+                SmoothTraceInGuardZone(data_trace,
+                                       dz_data,
+                                       smooth_length);
+              }
+
+              if (fft_resampling) {
+                int   mt     = static_cast<int>(res_fac)*nt;
+                int   cnt    = nt/2 + 1;
+                int   rnt    = 2*cnt;
+                int   cmt    = mt/2 + 1;
+                int   rmt    = 2*cmt;
+                float dz_min = dz_data/res_fac;
+
+                ResampleTrace(data_trace,
+                              FFTPlanCache::getPlan1D(nt, FFTW_REAL_TO_COMPLEX),
+                              FFTPlanCache::getPlan1D(mt, FFTW_COMPLEX_TO_REAL),
+                              rAmpData,
+                              rAmpFine,
+                              cnt,
+                              rnt,
+                              cmt,
+                              rmt);
+
+                //Includes a shift
+                InterpolateGridValues(grid_trace,
+                                      z0_grid,     // Centre of first cell
+                                      dz_grid,
+                                      rAmpFine,
+                                      z0_data,     // Time of first data sample
+                                      dz_min,
+                                      rmt,
+                                      nz,
+                                      nzp);
+
+                //Interpolate and shift trend before adding to grid_trace.
+                //Alternative: add trend before interpolating and change values under l2 < 0 || l1 > n_fine
+                if (grid_type != DATA) {
+                  float trend_inc = (trend_last - trend_first) / (res_fac*(n_trace - 1));
+
+                  data_trace_trend_long.resize(rmt);
+                  for (int k_trace = 0; k_trace < rmt; k_trace++) {
+                    data_trace_trend_long[k_trace] = trend_first + k_trace * trend_inc;
+                  }
+
+                  InterpolateAndShiftTrend(trend_interpolated,
+                                           z0_grid,     // Centre of first cell
+                                           dz_grid,
+                                           data_trace_trend_long,
+                                           z0_data,     // Time of first data sample
+                                           dz_min,
+                                           rmt,
+                                           nz,
+                                           nzp);
+
+                  //Add trend
+                  for (size_t k_trace = 0; k_trace < grid_trace.size(); k_trace++)
+                    grid_trace[k_trace] += trend_interpolated[k_trace];
+                }
+              }
+              else {
+                //Includes a shift, and adds back the trend
+                InterpolateGridValues(grid_trace,
+                                      z0_grid,     // Centre of first cell
+                                      dz_grid,
+                                      data_trace,
+                                      sinc,
+                                      z0_data,     // Time of first data sample
+                                      dz_data,
+                                      trend_first,
+                                      trend_last,
+                                      nz,
+                                      nzp);
+              }
 
-          dead_traces_simbox++;
+              if (is_nrlib_grid)
+                SetTrace(grid_trace, grid_new, i, j);
+              else
+                SetTrace(grid_trace, fft_grid_new, i, j);
+            }
+            else {
+              if (is_nrlib_grid)
+                SetTrace(0.0f, grid_new, i, j); // Dead traces (in case we allow them)
+              else
+                SetTrace(0.0f, fft_grid_new, i, j);
+
+              n_dead_simbox++;
+            }
+          }
+          else {
+            if (is_nrlib_grid)
+              SetTrace(0.0f, grid_new, i, j);   // Outside seismic data grid
+            else
+              SetTrace(0.0f, fft_grid_new, i, j);
+
+            if (i < nx && j < ny)
+              n_missing_simbox++;
+            else
+              n_missing_padding++; //Won't happen with NRLib::Grid
+          }
         }
       }
-      else {
-        if (is_nrlib_grid)
-          SetTrace(0.0f, grid_new, i, j);   // Outside seismic data grid
-        else
-          SetTrace(0.0f, fft_grid_new, i, j);
-
-        if (i < nx && j < ny)
-          missing_traces_simbox++;
-        else
-          missing_traces_padding++; //Won't happen with NRLib::Grid
+      catch (NRLib::Exception & e) {
+#ifdef PARALLEL
+#pragma omp critical(fill_in_data_error)
+#endif
+        err_text = e.what();
       }
 
-      if (rnxp*j + i + 1 >= static_cast<int>(nextMonitor)) {
-        nextMonitor += monitorSize;
-        printf("^");
+#ifdef PARALLEL
+#pragma omp critical(fill_in_data_monitor)
+#endif
+      {
+        n_rows_done++;
+        while (rnxp*n_rows_done >= static_cast<int>(nextMonitor)) {
+          nextMonitor += monitorSize;
+          printf("^");
+        }
         fflush(stdout);
       }
-      fftwnd_destroy_plan(fftplan1);
-      fftwnd_destroy_plan(fftplan2);
+    }
+
+    if (fft_resampling) {
+      fftw_free(rAmpData);
+      fftw_free(rAmpFine);
     }
   }
   LogKit::LogFormatted(LogKit::Low,"\n");
 
+  missing_traces_simbox  = n_missing_simbox;
+  missing_traces_padding = n_missing_padding;
+  dead_traces_simbox     = n_dead_simbox;
 
+  if (err_text != "")
+    throw NRLib::Exception(err_text);
 
   Timings::setTimeResamplingSeismic(wall,cpu);
 }
@@ -6763,6 +6796,41 @@ void CommonData::InterpolateGridValues(std::vector<float> & grid_trace,
   }
 }
 
+void CommonData::InterpolateGridValues(std::vector<float>       & grid_trace,
+                                       float                      z0_grid,
+                                       float                      dz_grid,
+                                       const std::vector<float> & data_trace,
+                                       const SincInterpolator   & sinc,
+                                       float                      z0_data,
+                                       float                      dz_data,
+                                       float                      trend_first,
+                                       float                      trend_last,
+                                       int                        nz,
+                                       int                        nzp) const
+{
+  //
+  // Band-limited interpolation directly from the data samples. The linear trend
+  // removed from the trace is added back, and is kept constant outside the trace.
+  //
+  // refk establishes link between traces order and grid order
+  // In trace:    A A A B B B B B B C C C     (A and C are values in padding)
+  // In grid :    B B B B B B C C C A A A
+
+  double z0_shift    = z0_grid - z0_data;
+  double inv_dz_data = 1.0/dz_data;
+
+  int   n_data    = static_cast<int>(data_trace.size());
+  int   n_grid    = static_cast<int>(grid_trace.size());
+  float trend_inc = (n_data > 1 ? (trend_last - trend_first)/(n_data - 1) : 0.0f);
+
+  for (int k = 0; k < n_grid; k++) {
+    int    refk = GetZSimboxIndex(k, nz, nzp);
+    double t    = (z0_shift + static_cast<double>(refk)*dz_grid)*inv_dz_data;
+    double tc   = std::max(0.0, std::min(t, static_cast<double>(n_data - 1)));
+    grid_trace[k] = sinc.interpolate(&data_trace[0], n_data, t) + trend_first + static_cast<float>(tc)*trend_inc;
+  }
+}
+
 void CommonData::InterpolateAndShiftTrend(std::vector<float>       & interpolated_trend,
                                           float                      z0_grid,
                                           float                      dz_grid,
@@ -6888,7 +6956,7 @@ CommonData::ReadStormFile(const std::string                 & file_name,
 
   try {
     stormgrid = new StormContGrid(0,0,0);
-    stormgrid->ReadFromFile(file_name);
+    stormgrid->ReadFromFile(file_name, true, NRLib::END_BIG_ENDIAN, model_settings->getNumberOfThreads());
     //std::string name = "check_"+NRLib::ReplaceExtension(NRLib::RemovePath(file_name),".storm");
     //stormgrid->WriteToFile(name);
   }
@@ -6939,7 +7007,10 @@ CommonData::ReadStormFile(const std::string                 & file_name,
                    grid_type,
                    scale,
                    false, //is_segy
-                   true); //is_storm
+                   true,  //is_storm
+                   false, //is_seismic
+                   model_settings->getNumberOfThreads(),
+                   model_settings->getUseFFTResampling());
 
         if (segy_tmp != NULL)
          delete segy_tmp;
@@ -9557,12 +9628,23 @@ void CommonData::PrintSettings(const ModelSettings    * model_settings,
       LogKit::LogFormatted(LogKit::Medium,"  Time-to-depth velocity                   :        yes\n");
   }
 
-  if (model_settings->getFileGrid())
+  if (model_settings->getFileGrid() || model_settings->getMemoryMappedGrids())
     LogKit::LogFormatted(LogKit::Medium,"\nAdvanced settings:\n");
   else
     LogKit::LogFormatted(LogKit::High,"\nAdvanced settings:\n");
 
   LogKit::LogFormatted(LogKit::Medium, "  Use intermediate disk storage for grids  : %10s\n", (model_settings->getFileGrid() ? "yes" : "no"));
+  if (model_settings->getFileGrid())
+    LogKit::LogFormatted(LogKit::Medium, "  Memory for FFTs of grids on disk (MB)    : %10d\n", model_settings->getDiskStorageFFTMemory());
+  LogKit::LogFormatted(LogKit::Medium, "  Use memory mapped grids                  : %10s\n", (model_settings->getMemoryMappedGrids() ? "yes" : "no"));
+  LogKit::LogFormatted(LogKit::Medium, "  Compress idle grids                      : %10s\n", (model_settings->getCompressIdleGrids() ? "yes" : "no"));
+  LogKit::LogFormatted(LogKit::Medium, "  Compress grids written on crava format   : %10s\n", (model_settings->getCompressCravaGrids() ? "yes" : "no"));
+  LogKit::LogFormatted(LogKit::Medium, "  Use SEG-Y index files                    : %10s\n", (model_settings->getUseSegyIndex() ? "yes" : "no"));
+  if (model_settings->getUseSegyIndex() && model_settings->getSegyIndexDirectory() != "")
+    LogKit::LogFormatted(LogKit::Medium, "  Directory for SEG-Y index files          : %10s\n", model_settings->getSegyIndexDirectory().c_str());
+  LogKit::LogFormatted(LogKit::Medium, "  Resample seismic traces by FFT           : %10s\n", (model_settings->getUseFFTResampling() ? "yes" : "no"));
+  if (model_settings->getMemoryBudget() > 0)
+    LogKit::LogFormatted(LogKit::Medium, "  Memory budget (MB)                       : %10d\n", model_settings->getMemoryBudget());
 
   if (input_files->getReflMatrFile() != "")
     LogKit::LogFormatted(LogKit::Medium, "  Take reflection matrix from file         : %10s\n", input_files->getReflMatrFile().c_str());
@@ -10389,6 +10471,19 @@ void CommonData::SetDebugLevel(ModelSettings * model_settings) const
   FFTGrid::setOutputFlags(model_settings->getOutputGridFormat(),
                           model_settings->getOutputGridDomain());
 
+  //Set up reuse of FFT plans.
+  FFTPlanCache::setMeasurePlans(model_settings->getMeasureFFTPlans());
+  if (model_settings->getUseFFTWisdom())
+    FFTPlanCache::readWisdom(IO::makeFullFileName("", IO::FileFFTWisdom()+IO::SuffixTextFiles()));
+  if (model_settings->getParallelFFT())
+    FFTGrid::setNumberOfFFTThreads(model_settings->getNumberOfThreads());
+  FFTGrid::setNumberOfThreads(model_settings->getNumberOfThreads());
+  FFTGrid::setMemoryMappedStorage(model_settings->getMemoryMappedGrids());
+  FFTGrid::setCompressIdleGrids(model_settings->getCompressIdleGrids());
+  FFTGrid::setCompressCravaFiles(model_settings->getCompressCravaGrids());
+  SegY::SetIndexFiles(model_settings->getUseSegyIndex(), model_settings->getSegyIndexDirectory());
+  FFTFileGrid::setFFTMemory(static_cast<size_t>(model_settings->getDiskStorageFFTMemory())*1024*1024);
+
 }
 
 //
@@ -23,6 +23,7 @@
 #include "src/multiintervalgrid.h"
 
 class MultiIntervalGrid;
+class SincInterpolator;
 class CravaTrend;
 class BlockedLogsCommon;
 class Wavelet1D;
@@ -183,7 +184,9 @@ public:
                                 bool                  scale    = false,
                                 bool                  is_segy  = true,
                                 bool                  is_storm = false,
-                                bool                  is_seismic = false) const;
+                                bool                  is_seismic = false,
+                                int                   n_threads  = 1,
+                                bool                  fft_resampling = false) const;
 
   void               GetCorrGradIJ(float         & corr_grad_I,
                                    float         & corr_grad_J,
@@ -670,6 +673,18 @@ bool                 BlockLogsForInversion(const ModelSettings
                                            int                  nz,
                                            int                  nzp) const;
 
+  void               InterpolateGridValues(std::vector<float>       & grid_trace,
+                                           float                      z0_grid,
+                                           float                      dz_grid,
+                                           const std::vector<float> & data_trace,
+                                           const SincInterpolator   & sinc,
+                                           float                      z0_data,
+                                           float                      dz_data,
+                                           float                      trend_first,
+                                           float                      trend_last,
+                                           int                        nz,
+                                           int                        nzp) const;
+
   void               InterpolateAndShiftTrend(std::vector<float>       & interpolated_trend,
                                               float                      z0_grid,
                                               float                      dz_grid,
@@ -0,0 +1,430 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+#ifdef PARALLEL
+#include <omp.h>
+#endif
+
+#include "nrlib/exception/exception.hpp"
+#include "nrlib/iotools/fileio.hpp"
+#include "nrlib/iotools/stringtools.hpp"
+
+#include "src/cravagridfile.h"
+#include "src/floatcompressor.h"
+#include "src/mappedmemory.h"
+#include "src/simbox.h"
+
+namespace {
+  const std::string LABEL_V1 = "crava_fftgrid_binary";
+  const std::string LABEL_V2 = "crava_fftgrid_binary_v2";
+}
+
+CravaGridFile::CravaGridFile(const std::string & fileName)
+  : fileName_(fileName),
+    version_(0),
+    layersPerChunk_(0),
+    compression_(NO_COMPRESSION),
+    dataOffset_(0)
+{
+  NRLib::OpenRead(file_, fileName, std::ios::in | std::ios::binary);
+
+  std::string fileType;
+  getline(file_, fileType);
+
+  if (fileType == LABEL_V2)
+    readHeaderV2();
+  else if (fileType.substr(0, LABEL_V1.size()) == LABEL_V1)
+    readHeaderV1();
+  else
+    throw NRLib::Exception("File '" + fileName + "' is not on crava binary format.");
+}
+
+void
+CravaGridFile::readHeaderV1(void)
+{
+  version_ = 1;
+  x0_      = NRLib::ReadBinaryDouble(file_);
+  y0_      = NRLib::ReadBinaryDouble(file_);
+  dx_      = NRLib::ReadBinaryDouble(file_);
+  dy_      = NRLib::ReadBinaryDouble(file_);
+  nx_      = NRLib::ReadBinaryInt(file_);
+  ny_      = NRLib::ReadBinaryInt(file_);
+  IL0_     = NRLib::ReadBinaryDouble(file_);
+  XL0_     = NRLib::ReadBinaryDouble(file_);
+  ILStepX_ = NRLib::ReadBinaryDouble(file_);
+  ILStepY_ = NRLib::ReadBinaryDouble(file_);
+  XLStepX_ = NRLib::ReadBinaryDouble(file_);
+  XLStepY_ = NRLib::ReadBinaryDouble(file_);
+  angle_   = NRLib::ReadBinaryDouble(file_);
+  rnxp_    = NRLib::ReadBinaryInt(file_);
+  nyp_     = NRLib::ReadBinaryInt(file_);
+  nzp_     = NRLib::ReadBinaryInt(file_);
+
+  layersPerChunk_ = std::max(nzp_, 1);
+  dataOffset_     = static_cast<long long>(file_.tellg());
+}
+
+void
+CravaGridFile::readHeaderV2(void)
+{
+  const NRLib::Endianess le = NRLib::END_LITTLE_ENDIAN;
+
+  version_ = NRLib::ReadBinaryInt(file_, le);
+  if (version_ != 2)
+    throw NRLib::Exception("Unknown version " + NRLib::ToString(version_) + " of crava binary file '" + fileName_ + "'.");
+
+  int headerSize  = NRLib::ReadBinaryInt(file_, le);
+  x0_             = NRLib::ReadBinaryDouble(file_, le);
+  y0_             = NRLib::ReadBinaryDouble(file_, le);
+  dx_             = NRLib::ReadBinaryDouble(file_, le);
+  dy_             = NRLib::ReadBinaryDouble(file_, le);
+  nx_             = NRLib::ReadBinaryInt(file_, le);
+  ny_             = NRLib::ReadBinaryInt(file_, le);
+  IL0_            = NRLib::ReadBinaryDouble(file_, le);
+  XL0_            = NRLib::ReadBinaryDouble(file_, le);
+  ILStepX_        = NRLib::ReadBinaryDouble(file_, le);
+  ILStepY_        = NRLib::ReadBinaryDouble(file_, le);
+  XLStepX_        = NRLib::ReadBinaryDouble(file_, le);
+  XLStepY_        = NRLib::ReadBinaryDouble(file_, le);
+  angle_          = NRLib::ReadBinaryDouble(file_, le);
+  rnxp_           = NRLib::ReadBinaryInt(file_, le);
+  nyp_            = NRLib::ReadBinaryInt(file_, le);
+  nzp_            = NRLib::ReadBinaryInt(file_, le);
+  layersPerChunk_ = NRLib::ReadBinaryInt(file_, le);
+  int nChunks     = NRLib::ReadBinaryInt(file_, le);
+  compression_    = NRLib::ReadBinaryInt(file_, le);
+  dataOffset_     = readInt64(file_);
+
+  if (compression_ != NO_COMPRESSION && compression_ != FLOAT_COMPRESSOR)
+    throw NRLib::Exception("Unknown compression in crava binary file '" + fileName_ + "'.");
+  if (layersPerChunk_ < 1 || nChunks != (nzp_ + layersPerChunk_ - 1)/layersPerChunk_)
+    throw NRLib::Exception("Invalid chunk table in crava binary file '" + fileName_ + "'.");
+
+  file_.seekg(headerSize);
+  chunks_.resize(nChunks);
+  for (int c = 0; c < nChunks; c++) {
+    chunks_[c].offset   = readInt64(file_);
+    chunks_[c].size     = readInt64(file_);
+    chunks_[c].checksum = static_cast<unsigned int>(NRLib::ReadBinaryInt(file_, le));
+    NRLib::ReadBinaryInt(file_, le); // Unused
+  }
+}
+
+int
+CravaGridFile::getLayersInChunk(int c) const
+{
+  return(std::min(layersPerChunk_, nzp_ - getFirstLayer(c)));
+}
+
+void
+CravaGridFile::readSlab(int k0, int nk, float * values, int nThreads)
+{
+  if (k0 < 0 || nk < 0 || k0 + nk > nzp_)
+    throw NRLib::Exception("Layers " + NRLib::ToString(k0) + "-" + NRLib::ToString(k0 + nk - 1) +
+                           " are outside the grid in file '" + fileName_ + "'.");
+  if (nk == 0)
+    return;
+
+  size_t layerSize = static_cast<size_t>(rnxp_)*nyp_;
+
+  if (version_ == 1) {
+    file_.clear();
+    file_.seekg(dataOffset_ + static_cast<long long>(4*layerSize)*k0);
+    NRLib::ReadBinaryFloatArray(file_, values, nk*layerSize, NRLib::END_BIG_ENDIAN);
+    return;
+  }
+
+  nThreads = std::max(nThreads, 1);
+
+  int cFirst = k0/layersPerChunk_;
+  int cLast  = (k0 + nk - 1)/layersPerChunk_;
+
+  std::vector<std::vector<unsigned char> > bytes(nThreads);
+  std::vector<std::vector<float> >         chunkValues(nThreads);
+
+  for (int first = cFirst; first <= cLast; first += nThreads) {
+    int nBatch = std::min(nThreads, cLast - first + 1);
+
+    for (int b = 0; b < nBatch; b++)   // The file is read by one thread
+      readChunkBytes(first + b, bytes[b]);
+
+    std::string errText = "";
+#ifdef PARALLEL
+#pragma omp parallel for num_threads(nThreads)
+#endif
+    for (int b = 0; b < nBatch; b++) {
+      int c     = first + b;
+      int kFrom = std::max(k0, getFirstLayer(c));
+      int kTo   = std::min(k0 + nk, getFirstLayer(c) + getLayersInChunk(c));
+      try {
+        if (kFrom == getFirstLayer(c) && kTo - kFrom == getLayersInChunk(c)) {
+          unpackChunk(c, bytes[b], values + (kFrom - k0)*layerSize);
+        }
+        else {
+          chunkValues[b].resize(getLayersInChunk(c)*layerSize);
+          unpackChunk(c, bytes[b], &chunkValues[b][0]);
+          std::copy(chunkValues[b].begin() + (kFrom - getFirstLayer(c))*layerSize,
+                    chunkValues[b].begin() + (kTo   - getFirstLayer(c))*layerSize,
+                    values + (kFrom - k0)*layerSize);
+        }
+      }
+      catch (NRLib::Exception & e) {
+#ifdef PARALLEL
+#pragma omp critical(crava_grid_file_error)
+#endif
+        errText += e.what();
+      }
+    }
+    if (errText != "")
+      throw NRLib::Exception(errText);
+  }
+}
+
+void
+CravaGridFile::readTrace(int i, int j, int k0, int nk, float * values)
+{
+  if (i < 0 || i >= rnxp_ || j < 0 || j >= nyp_ || k0 < 0 || nk < 0 || k0 + nk > nzp_)
+    throw NRLib::Exception("Trace (" + NRLib::ToString(i) + "," + NRLib::ToString(j) + ") samples " +
+                           NRLib::ToString(k0) + "-" + NRLib::ToString(k0 + nk - 1) +
+                           " are outside the grid in file '" + fileName_ + "'.");
+
+  size_t layerSize = static_cast<size_t>(rnxp_)*nyp_;
+  size_t ij        = static_cast<size_t>(i) + static_cast<size_t>(j)*rnxp_;
+
+  if (version_ == 1 || compression_ == NO_COMPRESSION) {
+    NRLib::Endianess numberRepresentation = (version_ == 1 ? NRLib::END_BIG_ENDIAN : NRLib::END_LITTLE_ENDIAN);
+    file_.clear();
+    for (int k = 0; k < nk; k++) {
+      file_.seekg(dataOffset_ + static_cast<long long>(4*(ij + (k0 + k)*layerSize)));
+      values[k] = NRLib::ReadBinaryFloat(file_, numberRepresentation);
+    }
+  }
+  else {
+    std::vector<unsigned char> bytes;
+    std::vector<float>         chunkValues;
+    for (int c = k0/layersPerChunk_; c <= (k0 + nk - 1)/layersPerChunk_ && nk > 0; c++) {
+      readChunkBytes(c, bytes);
+      chunkValues.resize(getLayersInChunk(c)*layerSize);
+      unpackChunk(c, bytes, &chunkValues[0]);
+      int kFrom = std::max(k0, getFirstLayer(c));
+      int kTo   = std::min(k0 + nk, getFirstLayer(c) + getLayersInChunk(c));
+      for (int k = kFrom; k < kTo; k++)
+        values[k - k0] = chunkValues[ij + (k - getFirstLayer(c))*layerSize];
+    }
+  }
+}
+
+float *
+CravaGridFile::mapValues(int nThreads) const
+{
+  if (version_ != 2 || compression_ != NO_COMPRESSION || !isLittleEndianMachine())
+    return(NULL);
+
+  size_t  bytes  = static_cast<size_t>(rnxp_)*nyp_*nzp_*sizeof(float);
+  float * values = static_cast<float *>(MappedMemory::mapFile(fileName_, static_cast<size_t>(dataOffset_), bytes));
+  if (values == NULL)
+    return(NULL);
+
+  // The mapped values are never unpacked, so the checksums are checked here, once.
+  const unsigned char * mapped  = reinterpret_cast<const unsigned char *>(values);
+  int                   nChunks = static_cast<int>(chunks_.size());
+  std::string           errText = "";
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 1) num_threads(std::max(nThreads, 1))
+#endif
+  for (int c = 0; c < nChunks; c++) {
+    long long start = chunks_[c].offset - dataOffset_;
+    if (start < 0 || start + chunks_[c].size > static_cast<long long>(bytes)
+        || adler32(mapped + start, static_cast<size_t>(chunks_[c].size)) != chunks_[c].checksum) {
+#ifdef PARALLEL
+#pragma omp critical(crava_grid_file_error)
+#endif
+      errText += "Checksum error in chunk " + NRLib::ToString(c) + " of crava binary file '" + fileName_ + "'.\n";
+    }
+  }
+  if (errText != "") {
+    MappedMemory::release(values, bytes);
+    throw NRLib::Exception(errText);
+  }
+  return(values);
+}
+
+void
+CravaGridFile::readChunkBytes(int c, std::vector<unsigned char> & bytes)
+{
+  bytes.resize(static_cast<size_t>(chunks_[c].size));
+  file_.clear();
+  file_.seekg(chunks_[c].offset);
+  if (!bytes.empty() && !file_.read(reinterpret_cast<char *>(&bytes[0]), static_cast<std::streamsize>(bytes.size())))
+    throw NRLib::Exception("Unexpected end of crava binary file '" + fileName_ + "' in chunk " + NRLib::ToString(c) + ".\n");
+}
+
+void
+CravaGridFile::unpackChunk(int                                c,
+                           const std::vector<unsigned char> & bytes,
+                           float                            * values) const
+{
+  size_t n = static_cast<size_t>(getLayersInChunk(c))*rnxp_*nyp_;
+
+  if (adler32(bytes.empty() ? NULL : &bytes[0], bytes.size()) != chunks_[c].checksum)
+    throw NRLib::Exception("Checksum error in chunk " + NRLib::ToString(c) + " of crava binary file '" + fileName_ + "'.\n");
+
+  if (compression_ == FLOAT_COMPRESSOR) {
+    if (!FloatCompressor::decompress(bytes, values, n))
+      throw NRLib::Exception("Could not decompress chunk " + NRLib::ToString(c) + " of crava binary file '" + fileName_ + "'.\n");
+  }
+  else {
+    if (bytes.size() != 4*n)
+      throw NRLib::Exception("Wrong size of chunk " + NRLib::ToString(c) + " of crava binary file '" + fileName_ + "'.\n");
+    if (n > 0) {
+      memcpy(values, &bytes[0], 4*n);
+      NRLib::ParseIEEEFloatArrayLE(values, n);
+    }
+  }
+}
+
+void
+CravaGridFile::write(const std::string & fileName,
+                     const Simbox      * simbox,
+                     const float       * values,
+                     int                 rnxp,
+                     int                 nyp,
+                     int                 nzp,
+                     bool                compress,
+                     int                 nThreads)
+{
+  const NRLib::Endianess le = NRLib::END_LITTLE_ENDIAN;
+
+  nThreads = std::max(nThreads, 1);
+
+  size_t layerSize      = static_cast<size_t>(rnxp)*nyp;
+  int    layersPerChunk = static_cast<int>(std::max(static_cast<size_t>(1), CHUNK_BYTES/(4*std::max(layerSize, static_cast<size_t>(1)))));
+  layersPerChunk        = std::max(1, std::min(layersPerChunk, nzp));
+  int    nChunks        = (nzp + layersPerChunk - 1)/layersPerChunk;
+  long long dataOffset  = HEADER_SIZE + static_cast<long long>(TABLE_ENTRY)*nChunks;
+  dataOffset            = ((dataOffset + ALIGNMENT - 1)/ALIGNMENT)*ALIGNMENT;
+
+  std::ofstream binFile;
+  NRLib::OpenWrite(binFile, fileName, std::ios::out | std::ios::binary);
+
+  binFile << LABEL_V2 << "\n";
+  NRLib::WriteBinaryInt(binFile, 2, le);
+  NRLib::WriteBinaryInt(binFile, HEADER_SIZE, le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getx0(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->gety0(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getdx(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getdy(), le);
+  NRLib::WriteBinaryInt(binFile, simbox->getnx(), le);
+  NRLib::WriteBinaryInt(binFile, simbox->getny(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getIL0(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getXL0(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getILStepX(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getILStepY(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getXLStepX(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getXLStepY(), le);
+  NRLib::WriteBinaryDouble(binFile, simbox->getAngle(), le);
+  NRLib::WriteBinaryInt(binFile, rnxp, le);
+  NRLib::WriteBinaryInt(binFile, nyp, le);
+  NRLib::WriteBinaryInt(binFile, nzp, le);
+  NRLib::WriteBinaryInt(binFile, layersPerChunk, le);
+  NRLib::WriteBinaryInt(binFile, nChunks, le);
+  NRLib::WriteBinaryInt(binFile, (compress ? FLOAT_COMPRESSOR : NO_COMPRESSION), le);
+  writeInt64(binFile, dataOffset);
+
+  // The chunk table is written when the chunk sizes are known.
+  std::vector<char> zeros(static_cast<size_t>(dataOffset - static_cast<long long>(binFile.tellp())), 0);
+  if (!binFile.write(&zeros[0], static_cast<std::streamsize>(zeros.size())))
+    throw NRLib::Exception("Error writing to file '" + fileName + "'.");
+
+  std::vector<Chunk>                       chunks(nChunks);
+  std::vector<std::vector<unsigned char> > bytes(nThreads);
+  long long                                offset = dataOffset;
+
+  for (int first = 0; first < nChunks; first += nThreads) {
+    int nBatch = std::min(nThreads, nChunks - first);
+
+#ifdef PARALLEL
+#pragma omp parallel for num_threads(nThreads)
+#endif
+    for (int b = 0; b < nBatch; b++) {
+      int           c     = first + b;
+      int           k0    = c*layersPerChunk;
+      size_t        n     = static_cast<size_t>(std::min(layersPerChunk, nzp - k0))*layerSize;
+      const float * chunk = values + k0*layerSize;
+      if (compress) {
+        FloatCompressor::compress(chunk, n, bytes[b]);
+      }
+      else {
+        bytes[b].resize(4*n);
+        NRLib::WriteIEEEFloatArrayLE(reinterpret_cast<char *>(&bytes[b][0]), chunk, n);
+      }
+      chunks[c].size     = static_cast<long long>(bytes[b].size());
+      chunks[c].checksum = adler32(&bytes[b][0], bytes[b].size());
+    }
+
+    for (int b = 0; b < nBatch; b++) {   // Chunks are written in order by one thread
+      chunks[first + b].offset = offset;
+      offset                  += chunks[first + b].size;
+      if (!binFile.write(reinterpret_cast<const char *>(&bytes[b][0]), static_cast<std::streamsize>(bytes[b].size())))
+        throw NRLib::Exception("Error writing to file '" + fileName + "'.");
+    }
+  }
+
+  binFile.seekp(HEADER_SIZE);
+  for (int c = 0; c < nChunks; c++) {
+    writeInt64(binFile, chunks[c].offset);
+    writeInt64(binFile, chunks[c].size);
+    NRLib::WriteBinaryInt(binFile, static_cast<int>(chunks[c].checksum), le);
+    NRLib::WriteBinaryInt(binFile, 0, le);
+  }
+
+  binFile.close();
+}
+
+unsigned int
+CravaGridFile::adler32(const unsigned char * data,
+                       size_t                n)
+{
+  const unsigned int mod = 65521;
+  unsigned int       a   = 1;
+  unsigned int       b   = 0;
+  while (n > 0) {
+    size_t block = std::min(n, static_cast<size_t>(5552)); // Largest block without overflow in b
+    for (size_t i = 0; i < block; i++) {
+      a += data[i];
+      b += a;
+    }
+    a    %= mod;
+    b    %= mod;
+    data += block;
+    n    -= block;
+  }
+  return((b << 16) | a);
+}
+
+bool
+CravaGridFile::isLittleEndianMachine(void)
+{
+  unsigned int one = 1;
+  return(*reinterpret_cast<unsigned char *>(&one) == 1);
+}
+
+void
+CravaGridFile::writeInt64(std::ostream & stream,
+                          long long      value)
+{
+  unsigned long long u = static_cast<unsigned long long>(value);
+  NRLib::WriteBinaryInt(stream, static_cast<int>(u & 0xffffffffULL), NRLib::END_LITTLE_ENDIAN);
+  NRLib::WriteBinaryInt(stream, static_cast<int>(u >> 32), NRLib::END_LITTLE_ENDIAN);
+}
+
+long long
+CravaGridFile::readInt64(std::istream & stream)
+{
+  unsigned long long low  = static_cast<unsigned int>(NRLib::ReadBinaryInt(stream, NRLib::END_LITTLE_ENDIAN));
+  unsigned long long high = static_cast<unsigned int>(NRLib::ReadBinaryInt(stream, NRLib::END_LITTLE_ENDIAN));
+  return(static_cast<long long>((high << 32) | low));
+}
@@ -0,0 +1,151 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef CRAVAGRIDFILE_H
+#define CRAVAGRIDFILE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Simbox;
+
+// Grids on the crava binary format, which holds the padded grid of an FFTGrid.
+//
+// Version 1 ("crava_fftgrid_binary") has a header with the geometry, followed
+// by all values as big-endian floats. This version is only read.
+//
+// Version 2 ("crava_fftgrid_binary_v2") has a header of fixed size, a table of
+// chunks, and the values. Each chunk holds a slab of whole xy-layers, stored
+// either as little-endian floats or compressed by FloatCompressor, and has an
+// Adler-32 checksum of the stored bytes. Uncompressed chunks follow each other
+// from an offset that is a multiple of ALIGNMENT, so that the values can be
+// mapped directly into memory in the layout used by FFTGrid. All numbers in the
+// header and the chunk table are little-endian.
+//
+//   Offset  Bytes  Contents
+//        0     24  "crava_fftgrid_binary_v2\n"
+//       24      4  Version (2)
+//       28      4  Header size (HEADER_SIZE). The chunk table follows the header.
+//       32     32  x0, y0, dx, dy
+//       64      8  nx, ny
+//       72     56  IL0, XL0, IL step x, IL step y, XL step x, XL step y, angle
+//      128     12  rnxp, nyp, nzp
+//      140      4  Layers per chunk
+//      144      4  Number of chunks
+//      148      4  Compression (0 = none, 1 = FloatCompressor)
+//      152      8  Offset of first chunk
+//
+//   Chunk table, 24 bytes per chunk: offset (8), stored size (8), checksum (4), unused (4).
+
+class CravaGridFile
+{
+public:
+  /// Reads the header and chunk table of a file on either version.
+  /// \throw NRLib::Exception if the file can not be read.
+  CravaGridFile(const std::string & fileName);
+
+  int    getVersion(void)     const { return version_                 ;}
+  double getx0(void)          const { return x0_                      ;}
+  double gety0(void)          const { return y0_                      ;}
+  double getdx(void)          const { return dx_                      ;}
+  double getdy(void)          const { return dy_                      ;}
+  int    getnx(void)          const { return nx_                      ;}
+  int    getny(void)          const { return ny_                      ;}
+  double getIL0(void)         const { return IL0_                     ;}
+  double getXL0(void)         const { return XL0_                     ;}
+  double getILStepX(void)     const { return ILStepX_                 ;}
+  double getILStepY(void)     const { return ILStepY_                 ;}
+  double getXLStepX(void)     const { return XLStepX_                 ;}
+  double getXLStepY(void)     const { return XLStepY_                 ;}
+  double getAngle(void)       const { return angle_                   ;}
+  int    getRNXP(void)        const { return rnxp_                    ;}
+  int    getNYP(void)         const { return nyp_                     ;}
+  int    getNZP(void)         const { return nzp_                     ;}
+  bool   isCompressed(void)   const { return compression_ != NO_COMPRESSION ;}
+
+  /// Reads layers k0,...,k0+nk-1 of the padded grid into values, which must hold nk*rnxp*nyp
+  /// values. Only the chunks covering the layers are read, and they are unpacked by nThreads threads.
+  void   readSlab(int k0, int nk, float * values, int nThreads = 1);
+
+  /// Reads samples k0,...,k0+nk-1 of trace (i,j) of the padded grid.
+  void   readTrace(int i, int j, int k0, int nk, float * values);
+
+  /// Maps all values of the padded grid into memory, in the layout of FFTGrid. Changes to the
+  /// memory are not written to the file. The checksums are checked by nThreads threads when mapping.
+  /// Returns NULL if the file is compressed or of version 1, on big-endian machines, and where
+  /// mapping is not available. The memory must be released with MappedMemory::release() with
+  /// rnxp*nyp*nzp*sizeof(float) bytes.
+  /// \throw NRLib::Exception if a checksum is wrong.
+  float * mapValues(int nThreads = 1) const;
+
+  /// Writes the padded grid values on version 2, optionally compressed.
+  /// Chunks are packed by nThreads threads.
+  static void write(const std::string & fileName,
+                    const Simbox      * simbox,
+                    const float       * values,
+                    int                 rnxp,
+                    int                 nyp,
+                    int                 nzp,
+                    bool                compress,
+                    int                 nThreads = 1);
+
+private:
+  enum compressionTypes {NO_COMPRESSION = 0, FLOAT_COMPRESSOR = 1};
+
+  static const int       HEADER_SIZE = 512;
+  static const int       TABLE_ENTRY = 24;        // Bytes per chunk in table
+  static const int       ALIGNMENT   = 65536;     // Multiple of the page sizes in use
+  static const int       CHUNK_BYTES = 4194304;   // Aimed for size of uncompressed chunk
+
+  struct Chunk
+  {
+    long long            offset;
+    long long            size;
+    unsigned int         checksum;
+  };
+
+  void                   readHeaderV1(void);
+  void                   readHeaderV2(void);
+
+  void                   readChunkBytes(int c, std::vector<unsigned char> & bytes);
+  void                   unpackChunk(int c, const std::vector<unsigned char> & bytes, float * values) const;
+
+  int                    getFirstLayer(int c)  const { return c*layersPerChunk_ ;}
+  int                    getLayersInChunk(int c) const;
+
+  static unsigned int    adler32(const unsigned char * data, size_t n);
+  static bool            isLittleEndianMachine(void);
+  static void            writeInt64(std::ostream & stream, long long value);
+  static long long       readInt64(std::istream & stream);
+
+  std::string            fileName_;
+  std::ifstream          file_;
+  int                    version_;
+
+  double                 x0_;
+  double                 y0_;
+  double                 dx_;
+  double                 dy_;
+  int                    nx_;
+  int                    ny_;
+  double                 IL0_;
+  double                 XL0_;
+  double                 ILStepX_;
+  double                 ILStepY_;
+  double                 XLStepX_;
+  double                 XLStepY_;
+  double                 angle_;
+
+  int                    rnxp_;
+  int                    nyp_;
+  int                    nzp_;
+
+  int                    layersPerChunk_;
+  int                    compression_;
+  long long              dataOffset_;           // Start of values. For version 1 and uncompressed version 2, all values follow.
+  std::vector<Chunk>     chunks_;               // Empty for version 1
+};
+
+#endif
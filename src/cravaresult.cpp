@@ -8,6 +8,7 @@
 #include <math.h>
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
 
 #include "src/cravaresult.h"
 #include "src/multiintervalgrid.h"
@@ -16,8 +17,10 @@
 #include "src/seismicparametersholder.h"
 #include "src/krigingdata3d.h"
 #include "src/parameteroutput.h"
+#include "src/outputwriter.h"
 #include "src/wavelet1D.h"
 #include "src/modelavodynamic.h"
+#include "src/fftplancache.h"
 
 CravaResult::CravaResult():
 cov_vp_(NULL),
@@ -39,7 +42,10 @@ block_grid_(NULL),
 facies_prob_undef_(NULL),
 quality_grid_(NULL),
 write_crava_(false),
-n_intervals_(1)
+n_intervals_(1),
+n_threads_(1),
+simulation_model_settings_(NULL),
+simulation_common_data_(NULL)
 {
 }
 
@@ -214,6 +220,7 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
   MultiIntervalGrid * multi_interval_grid     = common_data->GetMultipleIntervalGrid();
   Simbox & output_simbox                      = common_data->GetOutputSimbox();
   n_intervals_                                = multi_interval_grid->GetNIntervals();
+  n_threads_                                  = model_settings->getNumberOfThreads();
   const std::vector<int> & erosion_priorities = multi_interval_grid->GetErosionPriorities();
 
   int nx           = output_simbox.getnx();
@@ -221,6 +228,10 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
   int nz_output    = output_simbox.getnz();
   double dz_output = output_simbox.getdz();
 
+  //Result grids are collected below, and combined in one pass over the columns
+  std::vector<StormContGrid *>         final_grids;
+  std::vector<std::vector<FFTGrid *> > interval_grids;
+
   LogKit::LogFormatted(LogKit::Low,"\nCombine Blocked Logs...");
   blocked_logs_ = common_data->GetBlockedLogsOutput(); //Logs blocked to output_simbox
   CombineBlockedLogs(blocked_logs_, blocked_logs_intervals_, multi_interval_grid, common_data, &output_simbox); //Combine and resample logs create during inversion
@@ -235,8 +246,6 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
   //WriteCravaGrids(model_settings, common_data, output_simbox, seismic_parameters_intervals[0]);
 
   if (model_settings->getWritePrediction() && !model_settings->getEstimationMode()) {
-    LogKit::LogFormatted(LogKit::Low,"\nCombine Prediction Grids...");
-
     //Post vp, vs and rho from avoinversion computePostMeanResidAndFFTCov()
     post_vp_  = new StormContGrid(output_simbox, nx, ny, nz_output);
     post_vs_  = new StormContGrid(output_simbox, nx, ny, nz_output);
@@ -262,9 +271,12 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
         post_rho_intervals[i] = seismic_parameters_intervals[i].GetPostRho();
       }
     }
-    CombineResult(post_vp_,  post_vp_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(post_vs_,  post_vs_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(post_rho_, post_rho_intervals, multi_interval_grid, erosion_priorities, dz_output);
+    final_grids.push_back(post_vp_);
+    interval_grids.push_back(post_vp_intervals);
+    final_grids.push_back(post_vs_);
+    interval_grids.push_back(post_vs_intervals);
+    final_grids.push_back(post_rho_);
+    interval_grids.push_back(post_rho_intervals);
 
     //Post vp, vs and rho from avoinversion doPredictionKriging()
     if (model_settings->getKrigingParameter() > 0) {
@@ -280,24 +292,29 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
         post_vs_kriged_intervals[i]  = seismic_parameters_intervals[i].GetPostVsKriged();
         post_rho_kriged_intervals[i] = seismic_parameters_intervals[i].GetPostRhoKriged();
       }
-      CombineResult(post_vp_kriged_,  post_vp_kriged_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-      CombineResult(post_vs_kriged_,  post_vs_kriged_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-      CombineResult(post_rho_kriged_, post_rho_kriged_intervals, multi_interval_grid, erosion_priorities, dz_output);
+      final_grids.push_back(post_vp_kriged_);
+      interval_grids.push_back(post_vp_kriged_intervals);
+      final_grids.push_back(post_vs_kriged_);
+      interval_grids.push_back(post_vs_kriged_intervals);
+      final_grids.push_back(post_rho_kriged_);
+      interval_grids.push_back(post_rho_kriged_intervals);
     }
-    LogKit::LogFormatted(LogKit::Low,"ok");
   }
 
   //Background models
+  int background_index = -1; //Background interval grids are members, and must be updated after combining
   if ((model_settings->getOutputGridsElastic() & IO::BACKGROUND) > 0) {
-    LogKit::LogFormatted(LogKit::Low,"\nCombine Background Model...");
     background_vp_  = new StormContGrid(output_simbox, nx, ny, nz_output);
     background_vs_  = new StormContGrid(output_simbox, nx, ny, nz_output);
     background_rho_ = new StormContGrid(output_simbox, nx, ny, nz_output);
 
-    CombineResult(background_vp_,  background_vp_intervals_,  multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(background_vs_,  background_vs_intervals_,  multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(background_rho_, background_rho_intervals_, multi_interval_grid, erosion_priorities, dz_output);
-    LogKit::LogFormatted(LogKit::Low,"ok");
+    background_index = static_cast<int>(final_grids.size());
+    final_grids.push_back(background_vp_);
+    interval_grids.push_back(background_vp_intervals_);
+    final_grids.push_back(background_vs_);
+    interval_grids.push_back(background_vs_intervals_);
+    final_grids.push_back(background_rho_);
+    interval_grids.push_back(background_rho_intervals_);
   }
   else { //These background grids are not used later if we are not going to write them to file
     for (size_t i = 0; i < background_vp_intervals_.size(); i++) {
@@ -336,12 +353,18 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
       //if (!model_settings->getForwardModeling())
       //  seismic_parameters_intervals[i].FFTCovGrids();
     }
-    CombineResult(cov_vp_,        cov_vp_intervals,        multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(cov_vs_,        cov_vs_intervals,        multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(cov_rho_,       cov_rho_intervals,       multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(cr_cov_vp_vs_,  cr_cov_vp_vs_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(cr_cov_vp_rho_, cr_cov_vp_rho_intervals, multi_interval_grid, erosion_priorities, dz_output);
-    CombineResult(cr_cov_vs_rho_, cr_cov_vs_rho_intervals, multi_interval_grid, erosion_priorities, dz_output);
+    final_grids.push_back(cov_vp_);
+    interval_grids.push_back(cov_vp_intervals);
+    final_grids.push_back(cov_vs_);
+    interval_grids.push_back(cov_vs_intervals);
+    final_grids.push_back(cov_rho_);
+    interval_grids.push_back(cov_rho_intervals);
+    final_grids.push_back(cr_cov_vp_vs_);
+    interval_grids.push_back(cr_cov_vp_vs_intervals);
+    final_grids.push_back(cr_cov_vp_rho_);
+    interval_grids.push_back(cr_cov_vp_rho_intervals);
+    final_grids.push_back(cr_cov_vs_rho_);
+    interval_grids.push_back(cr_cov_vs_rho_intervals);
   }
 
   //Facies prob
@@ -356,7 +379,8 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
       for (int i = 0; i < n_intervals_; i++) {
         facies_prob_intervals[i] = seismic_parameters_intervals[i].GetFaciesProb()[j];
       }
-      CombineResult(facies_prob_[j],  facies_prob_intervals,  multi_interval_grid, erosion_priorities, dz_output);
+      final_grids.push_back(facies_prob_[j]);
+      interval_grids.push_back(facies_prob_intervals);
     }
 
     //Undef
@@ -365,7 +389,8 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
     for (int i = 0; i < n_intervals_; i++) {
       facies_prob_intervals_undef[i] = seismic_parameters_intervals[i].GetFaciesProbUndefined();
     }
-    CombineResult(facies_prob_undef_,  facies_prob_intervals_undef,  multi_interval_grid, erosion_priorities, dz_output);
+    final_grids.push_back(facies_prob_undef_);
+    interval_grids.push_back(facies_prob_intervals_undef);
 
   }
   if (model_settings->getOutputGridsOther() & IO::FACIESPROB) {
@@ -379,7 +404,8 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
       for (int i = 0; i < n_intervals_; i++) {
         facies_prob_intervals[i] = seismic_parameters_intervals[i].GetFaciesProbGeomodel()[j];
       }
-      CombineResult(facies_prob_geo_[j],  facies_prob_intervals,  multi_interval_grid, erosion_priorities, dz_output);
+      final_grids.push_back(facies_prob_geo_[j]);
+      interval_grids.push_back(facies_prob_intervals);
     }
   }
 
@@ -395,7 +421,8 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
       for (int i = 0; i < n_intervals_; i++) {
         lh_cubes_intervals[i] = seismic_parameters_intervals[i].GetLHCube()[j];
       }
-      CombineResult(lh_cubes_[j], lh_cubes_intervals, multi_interval_grid, erosion_priorities, dz_output);
+      final_grids.push_back(lh_cubes_[j]);
+      interval_grids.push_back(lh_cubes_intervals);
 
     }
   }
@@ -408,7 +435,8 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
     for (int i = 0; i < n_intervals_; i++) {
       quality_grid_intervals[i] = seismic_parameters_intervals[i].GetQualityGrid();
     }
-    CombineResult(quality_grid_, quality_grid_intervals, multi_interval_grid, erosion_priorities, dz_output);
+    final_grids.push_back(quality_grid_);
+    interval_grids.push_back(quality_grid_intervals);
   }
 
   //Simulation grids
@@ -432,9 +460,12 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
         simulations_seed2_intervals[i] = seismic_parameters_intervals[i].GetSimulationSeed2(j);
       }
 
-      CombineResult(simulations_seed0_[j], simulations_seed0_intervals, multi_interval_grid, erosion_priorities, dz_output);
-      CombineResult(simulations_seed1_[j], simulations_seed1_intervals, multi_interval_grid, erosion_priorities, dz_output);
-      CombineResult(simulations_seed2_[j], simulations_seed2_intervals, multi_interval_grid, erosion_priorities, dz_output);
+      final_grids.push_back(simulations_seed0_[j]);
+      interval_grids.push_back(simulations_seed0_intervals);
+      final_grids.push_back(simulations_seed1_[j]);
+      interval_grids.push_back(simulations_seed1_intervals);
+      final_grids.push_back(simulations_seed2_[j]);
+      interval_grids.push_back(simulations_seed2_intervals);
 
     }
   }
@@ -447,9 +478,21 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
     for (int i = 0; i < n_intervals_; i++) {
       block_grid_intervals[i] = seismic_parameters_intervals[i].GetBlockGrid();
     }
-    CombineResult(block_grid_, block_grid_intervals, multi_interval_grid, erosion_priorities, dz_output);
+    final_grids.push_back(block_grid_);
+    interval_grids.push_back(block_grid_intervals);
   }
 
+  LogKit::LogFormatted(LogKit::Low,"\nCombine Result Grids...");
+  CombineResult(final_grids, interval_grids, multi_interval_grid, erosion_priorities, dz_output);
+  if (background_index >= 0) {
+    background_vp_intervals_  = interval_grids[background_index];
+    background_vs_intervals_  = interval_grids[background_index + 1];
+    background_rho_intervals_ = interval_grids[background_index + 2];
+  }
+  final_grids.clear();
+  interval_grids.clear();
+  LogKit::LogFormatted(LogKit::Low,"ok");
+
   //Correlations and post variances
   //Do not combine, store and write per interval
   for (int i = 0; i < n_intervals_; i++) {
@@ -526,8 +569,10 @@ void CravaResult::CombineResults(ModelSettings                        * model_se
           delete trend_cube;
       }
 
-      CombineResult(trend_cubes_[i],  trend_cubes_intervals,  multi_interval_grid, erosion_priorities, dz_output);
+      final_grids.push_back(trend_cubes_[i]);
+      interval_grids.push_back(trend_cubes_intervals);
     }
+    CombineResult(final_grids, interval_grids, multi_interval_grid, erosion_priorities, dz_output);
   }
 
   //Delete grids from seismicparamtersholder
@@ -545,223 +590,259 @@ void CravaResult::CombineResult(StormContGrid         *& final_grid,
                                 double                   dz_min,
                                 bool                     smooth)
 {
-  int nx = final_grid->GetNI();
-  int ny = final_grid->GetNJ();
-  int nz = final_grid->GetNK();
+  std::vector<StormContGrid *>         final_grids(1, final_grid);
+  std::vector<std::vector<FFTGrid *> > grids(1, interval_grids);
+
+  CombineResult(final_grids, grids, multi_interval_grid, erosion_priorities, dz_min, smooth);
+
+  interval_grids = grids[0];
+}
+
+void CravaResult::CombineResult(std::vector<StormContGrid *>         & final_grids,
+                                std::vector<std::vector<FFTGrid *> > & interval_grids,
+                                MultiIntervalGrid                    * multi_interval_grid,
+                                const std::vector<int>               & erosion_priorities,
+                                double                                 dz_min,
+                                bool                                   smooth)
+{
+  //All final grids are defined on the output simbox, so the interval layout of a column is
+  //found once and used for all grids. Columns are combined in parallel.
+  int n_grids = static_cast<int>(final_grids.size());
+  if (n_grids == 0)
+    return;
+
+  int nx = final_grids[0]->GetNI();
+  int ny = final_grids[0]->GetNJ();
+  int nz = final_grids[0]->GetNK();
 
-  bool writing  = false; //debugging
   float res_fac = 10.0; //Degree of refinement, must be integer.
 
   //If output simbox has the same size as the result grid there is no need to resample
-  if (n_intervals_ == 1 && static_cast<int>(final_grid->GetNK()) == multi_interval_grid->GetIntervalSimbox(0)->getnz()) {
-    CreateStormGrid(*final_grid, interval_grids[0]);
+  if (n_intervals_ == 1 && nz == multi_interval_grid->GetIntervalSimbox(0)->getnz()) {
+    for (int g = 0; g < n_grids; g++)
+      CreateStormGrid(*final_grids[g], interval_grids[g][0]);
     return;
   }
 
-  //Resample
-  for (int i = 0; i < nx; i++) {
-    for (int j = 0; j < ny; j++) {
+  //Traces are read directly from the grid values, so compressed grids are restored first.
+  //Grids kept on file are read by one thread.
+  int n_threads = n_threads_;
+  for (int g = 0; g < n_grids; g++) {
+    for (int i_interval = 0; i_interval < n_intervals_; i_interval++) {
+      if (interval_grids[g][i_interval]->isFile())
+        n_threads = 1;
+      else
+        interval_grids[g][i_interval]->decompress();
+    }
+  }
 
-      std::vector<std::vector<float> > new_traces(n_intervals_);
+  double dz_resampled = dz_min / res_fac;
+
+#ifdef PARALLEL
+#pragma omp parallel num_threads(n_threads)
+#endif
+  {
+    std::vector<int>                  nz_new(n_intervals_);
+    std::vector<double>               top_fine(n_intervals_);
+    std::vector<std::vector<double> > z_fine(n_intervals_);      //z of each sample in the resampled trace
+    std::vector<bool>                 used(n_intervals_);
+    std::vector<int>                  cell_interval(nz);        //Interval each cell takes its value from
+    std::vector<int>                  cell_index(nz);           //Sample in the resampled trace of that interval
+    std::vector<int>                  interval_indexes(nz);     //Interval selected by erosion priorities
+    std::vector<float>                tmp_trace(nz);
+    std::vector<float>                old_trace;
+    std::vector<std::vector<float> >  new_traces(n_intervals_);
+
+    fftw_real * rAmpData = NULL;
+    fftw_real * rAmpFine = NULL;
+    int         rnt_max  = 0;
+    int         rmt_max  = 0;
+
+#ifdef PARALLEL
+#pragma omp for schedule(dynamic,1)
+#endif
+    for (int i = 0; i < nx; i++) {
+      for (int j = 0; j < ny; j++) {
 
-      //Resample each trace to new nz
-      for (int i_interval = 0; i_interval < n_intervals_; i_interval++) {
+        for (int i_interval = 0; i_interval < n_intervals_; i_interval++) {
+          Simbox * interval_simbox = multi_interval_grid->GetIntervalSimbox(i_interval);
 
-        Simbox * interval_simbox = multi_interval_grid->GetIntervalSimbox(i_interval);
-        FFTGrid * interval_grid  = interval_grids[i_interval];
+          double top_value = interval_simbox->getTop(i,j);
+          double bot_value = interval_simbox->getBot(i,j);
 
-        std::vector<float> old_trace = interval_grid->getRealTrace(i, j); //old_trace is changed below.
+          //Resample to new nz based on minimum dz from all traces and intervals
+          nz_new[i_interval] = static_cast<int>( ((bot_value - top_value) / dz_min) * res_fac);
+          z_fine[i_interval].clear();
+          used[i_interval] = false;
+        }
 
-        double top_value = interval_simbox->getTop(i,j);
-        double bot_value = interval_simbox->getBot(i,j);
-        int nz_old       = interval_simbox->getnz();
+        //Find where each cell of the final trace is taken from
+        for (int k = 0; k < nz; k++) {
 
-        //Resample to new nz based on minimum dz from all traces and intervals
-        int nz_new = static_cast<int>( ((bot_value - top_value) / dz_min) * res_fac);
+          bool two_intervals = false;
 
-        new_traces[i_interval].resize(nz_new);
+          double global_x = 0.0;
+          double global_y = 0.0;
+          double global_z = 0.0;
 
-        //H-Debugging
-        if (writing) {
-          std::string file_name = "combine/old_trace";
-          std::ofstream file;
-          NRLib::OpenWrite(file, file_name);
-          file << std::fixed
-                << std::setprecision(6);
-          for (size_t k = 0; k < old_trace.size(); k++)
-            file << old_trace[k] << " ";
-          file.close();
-        }
+          final_grids[0]->FindCenterOfCell(i, j, k, global_x, global_y, global_z);
+          double dz_final = (final_grids[0]->GetBotSurface().GetZ(global_x, global_y) - final_grids[0]->GetTopSurface().GetZ(global_x, global_y)) / nz;
 
-        //Resampling of traces from CommonData::FillInData
-        //Remove trend -> fft -> pad with zeroes -> resample -> ifft -> add trend
+          int i_interval = 0;
+          for (i_interval = 0; i_interval < n_intervals_; i_interval++) {
+            Simbox * interval_simbox = multi_interval_grid->GetIntervalSimbox(i_interval);
 
-        //Remove trend from trace
-        size_t n_trace    = old_trace.size();
-        float trend_first = old_trace[0];
-        float trend_last  = old_trace[n_trace - 1];
-        float trend_inc   = (trend_last - trend_first) / (n_trace - 1);
-        for (size_t k_trace = 0; k_trace < old_trace.size(); k_trace++) {
-          old_trace[k_trace] -= trend_first + k_trace * trend_inc;
-        }
+            if (interval_simbox->IsInside(global_x, global_y, global_z))
+              break;
+          }
+          if (i_interval < (n_intervals_-1)) { //Also check if it hits the next interval, unless it is the last one.
+            Simbox * interval_simbox = multi_interval_grid->GetIntervalSimbox(i_interval+1);
 
-        //int nt = CommonData::FindClosestFactorableNumber(nz_old);
-        int nt = nz_old;
-        int mt = nz_new;
-
-        rfftwnd_plan fftplan1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
-        rfftwnd_plan fftplan2 = rfftwnd_create_plan(1, &mt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
-
-        int cnt = nt/2 + 1;
-        int rnt = 2*cnt;
-        int cmt = mt/2 + 1;
-        int rmt = 2*cmt;
-
-        fftw_real * rAmpData = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rnt));
-        fftw_real * rAmpFine = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rmt));
-
-        CommonData::ResampleTrace(old_trace,
-                                  fftplan1,
-                                  fftplan2,
-                                  rAmpData,
-                                  rAmpFine,
-                                  cnt,
-                                  rnt,
-                                  cmt,
-                                  rmt);
-
-        //Add trend
-        trend_inc = (trend_last - trend_first) / (res_fac * (nz_old - 1));
-        for (int k = 0; k < nz_new; k++) {
-          new_traces[i_interval][k] = rAmpFine[k] + (trend_first + k*trend_inc);
-        }
+            if (interval_simbox->IsInside(global_x, global_y, global_z))
+              two_intervals = true;
+          }
 
-        fftw_free(rAmpData);
-        fftw_free(rAmpFine);
-        fftwnd_destroy_plan(fftplan1);
-        fftwnd_destroy_plan(fftplan2);
-
-        //H-Debugging
-        if (writing) {
-          std::string file_name = "combine/new_trace_resampled_long";
-          std::ofstream file;
-          NRLib::OpenWrite(file, file_name);
-          file << std::fixed
-                << std::setprecision(6);
-          for (size_t k = 0; k < new_traces[i_interval].size(); k++)
-            file << new_traces[i_interval][k] << " ";
-          file.close();
-        }
+          int interval_index = i_interval;
 
-      } //n_intervals
+          if (two_intervals == true) {
+            //Use erorsion priorities to select between the two intervals
+            if (erosion_priorities[i_interval] < erosion_priorities[i_interval+1])
+              interval_index = i_interval;
+            else
+              interval_index = i_interval+1;
+          }
+          double top = multi_interval_grid->GetIntervalSimbox(i_interval)->getTop(global_x, global_y);
+
+          std::vector<double> & z = z_fine[i_interval];
+          if (z.empty() || top != top_fine[i_interval]) {
+            z.resize(nz_new[i_interval]);
+            double trace_z = top;
+            for (int l = 0; l < nz_new[i_interval]; l++) {
+              z[l]     = trace_z;
+              trace_z += dz_resampled;
+            }
+            top_fine[i_interval] = top;
+          }
 
-      std::vector<float> tmp_trace(nz);
-      std::vector<int>   interval_indexes(nz);
-      //Combine vectors for each interval to one trace in stormgrid
-      for (int k = 0; k < nz; k++) {
+          cell_interval[k]    = i_interval;
+          cell_index[k]       = GetResampledTraceIndex(z, dz_resampled, global_z, dz_final);
+          interval_indexes[k] = interval_index;
+          used[i_interval]    = true;
+        }
 
-        bool two_intervals = false;
+        for (int g = 0; g < n_grids; g++) {
 
-        double global_x = 0.0;
-        double global_y = 0.0;
-        double global_z = 0.0;
+          //Resample each trace to new nz
+          for (int i_interval = 0; i_interval < n_intervals_; i_interval++) {
+            if (used[i_interval] == false)
+              continue;
 
-        final_grid->FindCenterOfCell(i, j, k, global_x, global_y, global_z);
-        double dz_final = (final_grid->GetBotSurface().GetZ(global_x, global_y) - final_grid->GetTopSurface().GetZ(global_x, global_y)) / final_grid->GetNK();
+            FFTGrid * interval_grid = interval_grids[g][i_interval];
+            int       nz_old        = multi_interval_grid->GetIntervalSimbox(i_interval)->getnz();
 
-        int i_interval = 0;
-        for (i_interval = 0; i_interval < n_intervals_; i_interval++) {
-          Simbox * interval_simbox = multi_interval_grid->GetIntervalSimbox(i_interval);
+            old_trace.resize(interval_grid->getNz());
+            for (size_t k = 0; k < old_trace.size(); k++)
+              old_trace[k] = interval_grid->getRealValue(i, j, static_cast<int>(k));
 
-          if (interval_simbox->IsInside(global_x, global_y, global_z))
-            break;
-        }
-        if (i_interval < (n_intervals_-1)) { //Also check if it hits the next interval, unless it is the last one.
-          Simbox * interval_simbox = multi_interval_grid->GetIntervalSimbox(i_interval+1);
+            new_traces[i_interval].resize(nz_new[i_interval]);
 
-          if (interval_simbox->IsInside(global_x, global_y, global_z))
-            two_intervals = true;
-        }
+            //Resampling of traces from CommonData::FillInData
+            //Remove trend -> fft -> pad with zeroes -> resample -> ifft -> add trend
 
-        float value         = 0.0f;
-        double dz_resampled = dz_min / res_fac;
-        int interval_index  = i_interval;
+            //Remove trend from trace
+            size_t n_trace    = old_trace.size();
+            float trend_first = old_trace[0];
+            float trend_last  = old_trace[n_trace - 1];
+            float trend_inc   = (trend_last - trend_first) / (n_trace - 1);
+            for (size_t k_trace = 0; k_trace < old_trace.size(); k_trace++) {
+              old_trace[k_trace] -= trend_first + k_trace * trend_inc;
+            }
 
-        if (two_intervals == true) {
-          //Use erorsion priorities to select between the two intervals
-          if (erosion_priorities[i_interval] < erosion_priorities[i_interval+1])
-            interval_index = i_interval;
-          else
-            interval_index = i_interval+1;
-        }
-        double top = multi_interval_grid->GetIntervalSimbox(i_interval)->getTop(global_x, global_y);
-        value      = GetResampledTraceValue(new_traces[i_interval], dz_resampled, top, global_z, dz_final);
-        interval_indexes[k] = interval_index;
+            int nt = nz_old;
+            int mt = nz_new[i_interval];
 
-        if (smooth == true && n_intervals_ > 1)
-          tmp_trace[k] = value;
-        else
-          final_grid->SetValue(i, j, k, value);
-      }
+            int cnt = nt/2 + 1;
+            int rnt = 2*cnt;
+            int cmt = mt/2 + 1;
+            int rmt = 2*cmt;
 
-      if (smooth == true && n_intervals_ > 1) {
-        //SmoothTraceIntervals(tmp_trace, interval_indexes, dz_min); //H-TODO CRA-735
+            //Work arrays are kept by the thread, and only grow
+            if (rnt > rnt_max) {
+              fftw_free(rAmpData);
+              rAmpData = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rnt));
+              rnt_max  = rnt;
+            }
+            if (rmt > rmt_max) {
+              fftw_free(rAmpFine);
+              rAmpFine = static_cast<fftw_real*>(fftw_malloc(sizeof(float)*rmt));
+              rmt_max  = rmt;
+            }
 
-        for (int k = 0; k < nz; k++)
-          final_grid->SetValue(i, j, k, tmp_trace[k]);
-      }
+            CommonData::ResampleTrace(old_trace,
+                                      FFTPlanCache::getPlan1D(nt, FFTW_REAL_TO_COMPLEX),
+                                      FFTPlanCache::getPlan1D(mt, FFTW_COMPLEX_TO_REAL),
+                                      rAmpData,
+                                      rAmpFine,
+                                      cnt,
+                                      rnt,
+                                      cmt,
+                                      rmt);
+
+            //Add trend
+            trend_inc = (trend_last - trend_first) / (res_fac * (nz_old - 1));
+            for (int k = 0; k < mt; k++) {
+              new_traces[i_interval][k] = rAmpFine[k] + (trend_first + k*trend_inc);
+            }
+          } //n_intervals
 
-      //H-DEBUGGING
-      if (writing) {
-        std::vector<float> new_trace_resampled(nz);
+          //Combine vectors for each interval to one trace in stormgrid
+          for (int k = 0; k < nz; k++) {
+            float value = new_traces[cell_interval[k]][cell_index[k]];
 
-        for (int k = 0; k < nz; k++) {
-          new_trace_resampled[k] = final_grid->GetValue(i, j, k);
-        }
+            if (smooth == true && n_intervals_ > 1)
+              tmp_trace[k] = value;
+            else
+              final_grids[g]->SetValue(i, j, k, value);
+          }
 
-        std::string file_name = "combine/new_trace_resampled";
-        std::ofstream file;
-        NRLib::OpenWrite(file, file_name);
-        file << std::fixed
-              << std::setprecision(6);
-        for (size_t k = 0; k < new_trace_resampled.size(); k++)
-          file << new_trace_resampled[k] << " ";
-        file.close();
-      }
+          if (smooth == true && n_intervals_ > 1) {
+            //SmoothTraceIntervals(tmp_trace, interval_indexes, dz_min); //H-TODO CRA-735
+
+            for (int k = 0; k < nz; k++)
+              final_grids[g]->SetValue(i, j, k, tmp_trace[k]);
+          }
+        } //n_grids
 
-    } //ny
-  } //nx
+      } //ny
+    } //nx
 
-  for (size_t i = 0; i < interval_grids.size(); i++) {
-    delete interval_grids[i];
-    interval_grids[i] = NULL;
+    if (rAmpData != NULL)
+      fftw_free(rAmpData);
+    if (rAmpFine != NULL)
+      fftw_free(rAmpFine);
   }
 
+  for (int g = 0; g < n_grids; g++) {
+    for (size_t i = 0; i < interval_grids[g].size(); i++) {
+      delete interval_grids[g][i];
+      interval_grids[g][i] = NULL;
+    }
+  }
 }
 
-float CravaResult::GetResampledTraceValue(const std::vector<float> & resampled_trace, //interval
-                                          const double             & dz_resampled,
-                                          const double             & top,
-                                          const double             & global_z, //center of cell
-                                          const double             & dz_final)
+int CravaResult::GetResampledTraceIndex(const std::vector<double> & z_resampled,  //z of each sample in the resampled trace
+                                        const double              & dz_resampled,
+                                        const double              & global_z,     //center of cell
+                                        const double              & dz_final)
 {
-  int nz_resampled    = resampled_trace.size();
+  //Pick the first sample inside the cell, counted from the top of the cell. If there is none, the last sample is used.
+  int nz_resampled    = z_resampled.size();
   double global_z_top = global_z - 0.5*dz_final; //Use top of cell
 
-  //Start on top and pick the closest value in z
-  double trace_z = top;
-  int index      = 0;
-  while (index < (nz_resampled-1)) {
-    if (trace_z >= global_z_top && trace_z <= (global_z_top + dz_resampled))
-      break;
-    else {
-      trace_z += dz_resampled;
-      index++;
-    }
-  }
-
-  float value = resampled_trace[index];
-  return(value);
+  int index = static_cast<int>(std::lower_bound(z_resampled.begin(), z_resampled.end(), global_z_top) - z_resampled.begin());
+  if (index < (nz_resampled-1) && z_resampled[index] <= (global_z_top + dz_resampled))
+    return(index);
+  return(std::max(nz_resampled-1, 0));
 }
 
 double CravaResult::GetResampledTraceValue(const std::vector<double> & resampled_trace,
@@ -1074,8 +1155,8 @@ void CravaResult::ResampleTrace(std::vector<double> & old_trace, //not const, it
   int nt = nz_old;
   int mt = nz_new;
 
-  rfftwnd_plan fftplan1 = rfftwnd_create_plan(1, &nt, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE | FFTW_IN_PLACE);
-  rfftwnd_plan fftplan2 = rfftwnd_create_plan(1, &mt, FFTW_COMPLEX_TO_REAL, FFTW_ESTIMATE | FFTW_IN_PLACE);
+  rfftwnd_plan fftplan1 = FFTPlanCache::getPlan1D(nt, FFTW_REAL_TO_COMPLEX);
+  rfftwnd_plan fftplan2 = FFTPlanCache::getPlan1D(mt, FFTW_COMPLEX_TO_REAL);
 
   int cnt = nt/2 + 1;
   int rnt = 2*cnt;
@@ -1103,8 +1184,6 @@ void CravaResult::ResampleTrace(std::vector<double> & old_trace, //not const, it
 
   fftw_free(rAmpData);
   fftw_free(rAmpFine);
-  fftwnd_destroy_plan(fftplan1);
-  fftwnd_destroy_plan(fftplan2);
 
 }
 
@@ -1160,6 +1239,94 @@ void CravaResult::CombineTraces(std::vector<double>                     & final_
 }
 
 
+bool CravaResult::SetupSimulationOutput(ModelSettings * model_settings,
+                                        CommonData    * common_data)
+{
+  //Realisations from several intervals are combined, and those from several vintages share numbering,
+  //so they must all be kept until CombineResults.
+  if (common_data->GetMultipleIntervalGrid()->GetNIntervals() > 1)
+    return false;
+  if (model_settings->getDo4DInversion() || model_settings->getNumberOfTimeLapses() > 1)
+    return false;
+
+  //The time-depth mapping may be completed from the background model in WriteResults.
+  GridMapping * time_depth_mapping = common_data->GetTimeDepthMapping();
+  if ((model_settings->getOutputGridDomain() & IO::DEPTHDOMAIN) > 0 && time_depth_mapping != NULL && time_depth_mapping->getSimbox() == NULL)
+    return false;
+
+  simulation_model_settings_ = model_settings;
+  simulation_common_data_    = common_data;
+  n_threads_                 = model_settings->getNumberOfThreads();
+
+  return true;
+}
+
+void CravaResult::WriteSimulation(FFTGrid * vp,
+                                  FFTGrid * vs,
+                                  FFTGrid * rho,
+                                  int       sim_nr)
+{
+  assert(simulation_model_settings_ != NULL);
+
+  ModelSettings     * model_settings      = simulation_model_settings_;
+  MultiIntervalGrid * multi_interval_grid = simulation_common_data_->GetMultipleIntervalGrid();
+  const Simbox      & simbox              = simulation_common_data_->GetOutputSimbox();
+  GridMapping       * time_depth_mapping  = simulation_common_data_->GetTimeDepthMapping();
+  bool                kriging             = model_settings->getKrigingParameter() > 0;
+
+  OutputWriter output_writer(model_settings, n_threads_);
+
+  //Grids on file are loaded here.
+  vp ->setAccessMode(FFTGrid::RANDOMACCESS);
+  vs ->setAccessMode(FFTGrid::RANDOMACCESS);
+  rho->setAccessMode(FFTGrid::RANDOMACCESS);
+
+  //Single interval, so CRAVA-format output with padding is possible.
+  if ((model_settings->getOutputGridFormat() & IO::CRAVA) > 0) {
+    std::string prefix = IO::PrefixSimulations();
+    std::string suffix;
+    if (kriging)
+      suffix += "_Kriged_"+NRLib::ToString(sim_nr+1);
+    else
+      suffix += "_"+NRLib::ToString(sim_nr+1);
+
+    output_writer.AddCravaGrid(vp,  IO::makeFullFileName(IO::PathToInversionResults(), prefix + "Vp"  + suffix), &simbox);
+    output_writer.AddCravaGrid(vs,  IO::makeFullFileName(IO::PathToInversionResults(), prefix + "Vs"  + suffix), &simbox);
+    output_writer.AddCravaGrid(rho, IO::makeFullFileName(IO::PathToInversionResults(), prefix + "Rho" + suffix), &simbox);
+    output_writer.Flush(); //The grids are deleted below
+  }
+
+  int nx        = simbox.getnx();
+  int ny        = simbox.getny();
+  int nz_output = simbox.getnz();
+
+  std::vector<FFTGrid *>       grids(3);
+  std::vector<StormContGrid *> storm_grids(3);
+  grids[0] = vp;
+  grids[1] = vs;
+  grids[2] = rho;
+
+  std::vector<std::vector<FFTGrid *> > interval_grids(3);
+  for (int i = 0; i < 3; i++) {
+    storm_grids[i] = new StormContGrid(simbox, nx, ny, nz_output);
+    if (nz_output == multi_interval_grid->GetIntervalSimbox(0)->getnz()) {
+      CreateStormGrid(*storm_grids[i], grids[i], false);
+      delete grids[i];
+    }
+    else
+      interval_grids[i].push_back(grids[i]);
+  }
+  if (nz_output != multi_interval_grid->GetIntervalSimbox(0)->getnz())
+    CombineResult(storm_grids, interval_grids, multi_interval_grid, multi_interval_grid->GetErosionPriorities(), simbox.getdz()); //Deletes the fft-grids
+
+  ParameterOutput::WriteParameters(&simbox, time_depth_mapping, model_settings, storm_grids[0], storm_grids[1], storm_grids[2],
+                                   model_settings->getOutputGridsElastic(), sim_nr, kriging, &output_writer);
+  output_writer.Flush();
+
+  for (int i = 0; i < 3; i++)
+    delete storm_grids[i];
+}
+
 void CravaResult::WriteResults(ModelSettings           * model_settings,
                                CommonData              * common_data,
                                SeismicParametersHolder & seismic_parameters) //For crava-writing
@@ -1172,6 +1339,9 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
   int output_grids_elastic         = model_settings->getOutputGridsElastic();
   GridMapping * time_depth_mapping = common_data->GetTimeDepthMapping();
 
+  //Grids are queued here and written several at a time. All grids handed over are kept until the final Flush.
+  OutputWriter output_writer(model_settings, model_settings->getNumberOfThreads());
+
   //Write blocked wells
   if ((model_settings->getWellOutputFlag() & IO::BLOCKED_WELLS) > 0) {
     LogKit::LogFormatted(LogKit::Low,"\nWrite Blocked Logs...");
@@ -1193,39 +1363,39 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
 
     //From computePostMeanResidAndFFTCov()
     ParameterOutput::WriteParameters(&simbox, time_depth_mapping, model_settings, post_vp_, post_vs_, post_rho_,
-                                      output_grids_elastic, -1, false);
+                                      output_grids_elastic, -1, false, &output_writer);
 
     if (write_crava_) {
       std::string file_name_vp  = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixPredictions() + "Vp");
       std::string file_name_vs  = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixPredictions() + "Vs");
       std::string file_name_rho = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixPredictions() + "Rho");
-      seismic_parameters.GetPostVp()->writeCravaFile(file_name_vp,   &simbox);
-      seismic_parameters.GetPostVs()->writeCravaFile(file_name_vs,   &simbox);
-      seismic_parameters.GetPostRho()->writeCravaFile(file_name_rho, &simbox);
+      output_writer.AddCravaGrid(seismic_parameters.GetPostVp(),  file_name_vp,  &simbox);
+      output_writer.AddCravaGrid(seismic_parameters.GetPostVs(),  file_name_vs,  &simbox);
+      output_writer.AddCravaGrid(seismic_parameters.GetPostRho(), file_name_rho, &simbox);
     }
 
     //From doPredictionKriging
     if (model_settings->getKrigingParameter() > 0) {
       ParameterOutput::WriteParameters(&simbox, time_depth_mapping, model_settings, post_vp_kriged_, post_vs_kriged_, post_rho_kriged_,
-                                        output_grids_elastic, -1, true);
+                                        output_grids_elastic, -1, true, &output_writer);
 
       if (write_crava_) {
         std::string file_name_vp  = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixPredictions() + "Vp_Kriged");
         std::string file_name_vs  = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixPredictions() + "Vs_Kriged");
         std::string file_name_rho = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixPredictions() + "Rho_Kriged");
-        seismic_parameters.GetPostVpKriged()->writeCravaFile(file_name_vp,   &simbox);
-        seismic_parameters.GetPostVsKriged()->writeCravaFile(file_name_vs,   &simbox);
-        seismic_parameters.GetPostRhoKriged()->writeCravaFile(file_name_rho, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetPostVpKriged(),  file_name_vp,  &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetPostVsKriged(),  file_name_vs,  &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetPostRhoKriged(), file_name_rho, &simbox);
       }
     }
 
     //From CKrigingAdmin::KrigAll
     if (model_settings->getDebugFlag()) {
-      ParameterOutput::WriteFile(model_settings, block_grid_, "BlockGrid", IO::PathToInversionResults(), &simbox);
+      output_writer.AddStormGrid(block_grid_, false, "BlockGrid", IO::PathToInversionResults(), &simbox);
 
       if (write_crava_) {
         std::string file_name = IO::makeFullFileName(IO::PathToInversionResults(), "BlockGrid");
-        seismic_parameters.GetBlockGrid()->writeCravaFile(file_name, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetBlockGrid(), file_name, &simbox);
       }
     }
 
@@ -1302,7 +1472,9 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
                                   false,
                                   is_segy,
                                   is_storm,
-                                  true);
+                                  true,
+                                  model_settings->getNumberOfThreads(),
+                                  model_settings->getUseFFTResampling());
 
           delete nrlib_grid;
         }
@@ -1323,23 +1495,29 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
           }
         }
 
-        if ((model_settings->getOutputGridsSeismic() & IO::ORIGINAL_SEISMIC_DATA) > 0)
-          ParameterOutput::WriteFile(model_settings, seismic_storm, file_name_orig, IO::PathToSeismicData(), &simbox, true, sgri_label, offset[j], time_depth_mapping);
-
+        //The residual is computed before seismic_storm is handed to the writer, which deletes it.
+        StormContGrid * residual = NULL;
         if ((i==0) && (model_settings->getOutputGridsSeismic() & IO::SYNTHETIC_RESIDUAL) > 0) { //residuals only for first vintage.
-          StormContGrid residual(*(synt_seismic_data_[j]));
+          residual = new StormContGrid(*(synt_seismic_data_[j]));
           for (size_t k=0;k<seismic_storm->GetNK();k++) {
             for (size_t j=0;j<seismic_storm->GetNJ();j++) {
               for (size_t i=0;i<seismic_storm->GetNI();i++) {
-                residual(i,j,k) = (*seismic_storm)(i,j,k)-residual(i,j,k);
+                (*residual)(i,j,k) = (*seismic_storm)(i,j,k)-(*residual)(i,j,k);
               }
             }
           }
+        }
+
+        if ((model_settings->getOutputGridsSeismic() & IO::ORIGINAL_SEISMIC_DATA) > 0)
+          output_writer.AddStormGrid(seismic_storm, true, file_name_orig, IO::PathToSeismicData(), &simbox, true, sgri_label, offset[j], time_depth_mapping);
+        else
+          delete seismic_storm;
 
+        if (residual != NULL) {
           sgri_label = "Residual computed from synthetic seismic for incidence angle "+angle;
           std::string file_name  = IO::PrefixSyntheticResiduals() + angle;
 
-          ParameterOutput::WriteFile(model_settings, &residual, file_name, IO::PathToSeismicData(), &simbox, true, sgri_label);
+          output_writer.AddStormGrid(residual, true, file_name, IO::PathToSeismicData(), &simbox, true, sgri_label);
         }
       }
     }
@@ -1349,13 +1527,18 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
   //Write Background models
   if ((model_settings->getOutputGridsElastic() & IO::BACKGROUND) > 0) {
     LogKit::LogFormatted(LogKit::Low,"\nWrite Background Grids...");
+
+    //The depth mapping may be completed from the background, and must not change under grids already queued.
+    output_writer.Flush();
+
     WriteBackgrounds(model_settings,
                       &simbox,
                       background_vp_,
                       background_vs_,
                       background_rho_,
                       time_depth_mapping,
-                      *model_settings->getTraceHeaderFormatOutput());
+                      *model_settings->getTraceHeaderFormatOutput(),
+                      &output_writer);
 
     if (write_crava_) {
       std::string file_name_vp  = IO::makeFullFileName(IO::PathToBackground(), IO::PrefixBackground() + "Vp");
@@ -1393,7 +1576,7 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
     if (model_settings->getOutputGridsOther() & IO::CORRELATION) {
       LogKit::LogFormatted(LogKit::Low,"\nWrite Correlations...");
       WriteFilePostVariances(post_var0_[i], post_cov_vp00_[i], post_cov_vs00_[i], post_cov_rho00_[i], interval_name);
-      WriteFilePostCovGrids(model_settings, simbox, interval_name);
+      WriteFilePostCovGrids(model_settings, simbox, interval_name, &output_writer);
 
       if (write_crava_) {
         std::string file_name_vp    = IO::makeFullFileName(IO::PathToCorrelations(), IO::PrefixPosterior() + IO::PrefixCovariance() + "Vp");
@@ -1403,13 +1586,14 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
         std::string file_name_vprho = IO::makeFullFileName(IO::PathToCorrelations(), IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VpRho");
         std::string file_name_vsrho = IO::makeFullFileName(IO::PathToCorrelations(), IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VsRho");
 
-        seismic_parameters.GetCovVp()->writeCravaFile(file_name_vp,         &simbox);
-        seismic_parameters.GetCovVs()->writeCravaFile(file_name_vs,         &simbox);
-        seismic_parameters.GetCovRho()->writeCravaFile(file_name_rho,       &simbox);
-        seismic_parameters.GetCrCovVpVs()->writeCravaFile(file_name_vpvs,   &simbox);
-        seismic_parameters.GetCrCovVpRho()->writeCravaFile(file_name_vprho, &simbox);
-        seismic_parameters.GetCrCovVsRho()->writeCravaFile(file_name_vsrho, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetCovVp(),       file_name_vp,    &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetCovVs(),       file_name_vs,    &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetCovRho(),      file_name_rho,   &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetCrCovVpVs(),   file_name_vpvs,  &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetCrCovVpRho(),  file_name_vprho, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetCrCovVsRho(),  file_name_vsrho, &simbox);
       }
+      output_writer.Flush(); //The same grids are written for every interval
     LogKit::LogFormatted(LogKit::Low,"ok\n");
     }
   }
@@ -1441,50 +1625,50 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
     if (model_settings->getOutputGridsOther() & IO::FACIESPROB_WITH_UNDEF) {
       for (int i = 0; i < n_facies; i++) {
         std::string file_name = base_name +"With_Undef_"+ facies_names[i];
-        ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, facies_prob_[i], file_name, "");
+        ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, facies_prob_[i], file_name, "", false, &output_writer);
 
         if (write_crava_) {
           std::string file_name_crava = IO::makeFullFileName(IO::PathToInversionResults(), file_name);
-          seismic_parameters.GetFaciesProb()[i]->writeCravaFile(file_name_crava, &simbox);
+          output_writer.AddCravaGrid(seismic_parameters.GetFaciesProb()[i], file_name_crava, &simbox);
         }
       }
       std::string file_name = base_name + "Undef";
-      ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, facies_prob_undef_, file_name, "");
+      ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, facies_prob_undef_, file_name, "", false, &output_writer);
 
       if (write_crava_) {
         std::string file_name_crava = IO::makeFullFileName(IO::PathToInversionResults(), file_name);
-        seismic_parameters.GetFaciesProbUndefined()->writeCravaFile(file_name_crava, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetFaciesProbUndefined(), file_name_crava, &simbox);
       }
 
     }
     if (model_settings->getOutputGridsOther() & IO::FACIESPROB) {
       for (int i = 0; i < n_facies; i++) {
         std::string file_name = base_name + facies_names[i];
-        ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, facies_prob_geo_[i], file_name, "");
+        ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, facies_prob_geo_[i], file_name, "", false, &output_writer);
 
         if (write_crava_) {
           std::string file_name_crava = IO::makeFullFileName(IO::PathToInversionResults(), file_name);
-          seismic_parameters.GetFaciesProbGeomodel()[i]->writeCravaFile(file_name_crava, &simbox);
+          output_writer.AddCravaGrid(seismic_parameters.GetFaciesProbGeomodel()[i], file_name_crava, &simbox);
         }
       }
     }
     if (model_settings->getOutputGridsOther() & IO::SEISMIC_QUALITY_GRID) {
       std::string file_name = "Seismic_Quality_Grid";
-      ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, quality_grid_, file_name, "");
+      ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, quality_grid_, file_name, "", false, &output_writer);
 
       if (write_crava_) {
         std::string file_name_crava = IO::makeFullFileName(IO::PathToInversionResults(), file_name);
-        seismic_parameters.GetQualityGrid()->writeCravaFile(file_name_crava, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetQualityGrid(), file_name_crava, &simbox);
       }
     }
     if ((model_settings->getOutputGridsOther() & IO::FACIES_LIKELIHOOD) > 0) {
       for (int i = 0; i < n_facies; i++) {
         std::string file_name = IO::PrefixLikelihood() + facies_names[i];
-        ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, lh_cubes_[i], file_name, "");
+        ParameterOutput::WriteToFile(&simbox, time_depth_mapping, model_settings, lh_cubes_[i], file_name, "", false, &output_writer);
 
         if (write_crava_) {
           std::string file_name = IO::makeFullFileName(IO::PathToInversionResults(), IO::PrefixLikelihood() + facies_names[i]);
-          seismic_parameters.GetLHCube()[i]->writeCravaFile(file_name, &simbox);
+          output_writer.AddCravaGrid(seismic_parameters.GetLHCube()[i], file_name, &simbox);
         }
 
       }
@@ -1497,7 +1681,7 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
     bool kriging      = model_settings->getKrigingParameter() > 0;
     for (int i = 0; i < n_simulations; i++) {
       ParameterOutput::WriteParameters(&simbox, time_depth_mapping, model_settings, simulations_seed0_[i], simulations_seed1_[i], simulations_seed2_[i],
-                                        model_settings->getOutputGridsElastic(), i, kriging);
+                                        model_settings->getOutputGridsElastic(), i, kriging, &output_writer);
 
       if (write_crava_) {
         std::string prefix = IO::PrefixSimulations();
@@ -1510,9 +1694,9 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
         std::string file_name_vp  = IO::makeFullFileName(IO::PathToInversionResults(), prefix + "Vp" + suffix);
         std::string file_name_vs  = IO::makeFullFileName(IO::PathToInversionResults(), prefix + "Vs" + suffix);
         std::string file_name_rho = IO::makeFullFileName(IO::PathToInversionResults(), prefix + "Rho" + suffix);
-        seismic_parameters.GetSimulationSeed0(i)->writeCravaFile(file_name_vp,  &simbox);
-        seismic_parameters.GetSimulationSeed0(i)->writeCravaFile(file_name_vs,  &simbox);
-        seismic_parameters.GetSimulationSeed0(i)->writeCravaFile(file_name_rho, &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetSimulationSeed0(i), file_name_vp,  &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetSimulationSeed1(i), file_name_vs,  &simbox);
+        output_writer.AddCravaGrid(seismic_parameters.GetSimulationSeed2(i), file_name_rho, &simbox);
       }
     }
   }
@@ -1534,7 +1718,7 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
 
       if (((model_settings->getOutputGridsSeismic() & IO::SYNTHETIC_SEISMIC_DATA) > 0) ||
         (model_settings->getForwardModeling() == true))
-        ParameterOutput::WriteFile(model_settings, synt_seismic_data_[i], file_name, IO::PathToSeismicData(), &simbox, true, sgri_label);
+        output_writer.AddStormGrid(synt_seismic_data_[i], false, file_name, IO::PathToSeismicData(), &simbox, true, sgri_label);
     }
   }
 
@@ -1545,9 +1729,11 @@ void CravaResult::WriteResults(ModelSettings           * model_settings,
 
     for (size_t i = 0; i < trend_cubes_.size(); i++) {
       std::string file_name = IO::PrefixTrendCubes() + "_" + trend_cube_parameters[i];
-      ParameterOutput::WriteFile(model_settings, trend_cubes_[i], file_name, IO::PathToSeismicData(), &simbox, "trend cube");
+      output_writer.AddStormGrid(trend_cubes_[i], false, file_name, IO::PathToSeismicData(), &simbox, "trend cube");
     }
   }
+
+  output_writer.Flush();
 }
 
 
@@ -1561,6 +1747,7 @@ void CravaResult::WriteEstimationResults(ModelSettings * model_settings,
   blocked_logs_ = common_data->GetBlockedLogsOutput();
 
   n_intervals_ = common_data->GetMultipleIntervalGrid()->GetNIntervals();
+  n_threads_   = model_settings->getNumberOfThreads();
   if (n_intervals_ == 1 && ((model_settings->getOutputGridFormat() & IO::CRAVA) > 0))
     write_crava_ = true;
 
@@ -1640,9 +1827,16 @@ void CravaResult::WriteEstimationResults(ModelSettings * model_settings,
         background_rho_intervals[i] = new FFTGrid(common_data->GetBackgroundParametersInterval(i)[2], nx, ny, nz);
       }
 
-      CombineResult(background_vp_,  background_vp_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-      CombineResult(background_vs_,  background_vs_intervals,  multi_interval_grid, erosion_priorities, dz_output);
-      CombineResult(background_rho_, background_rho_intervals, multi_interval_grid, erosion_priorities, dz_output);
+      std::vector<StormContGrid *>         final_grids(3);
+      std::vector<std::vector<FFTGrid *> > interval_grids(3);
+      final_grids[0]    = background_vp_;
+      final_grids[1]    = background_vs_;
+      final_grids[2]    = background_rho_;
+      interval_grids[0] = background_vp_intervals;
+      interval_grids[1] = background_vs_intervals;
+      interval_grids[2] = background_rho_intervals;
+
+      CombineResult(final_grids, interval_grids, multi_interval_grid, erosion_priorities, dz_output);
       LogKit::LogFormatted(LogKit::Low,"Ok");
 
     }
@@ -1760,29 +1954,36 @@ void CravaResult::WriteFilePostCorrT(const std::vector<float> & post_cov,
 
 void CravaResult::WriteFilePostCovGrids(const ModelSettings * model_settings,
                                         const Simbox        & simbox,
-                                        std::string           interval_name) const
+                                        std::string           interval_name,
+                                        OutputWriter        * output_writer) const
 {
   if (interval_name != "")
     interval_name = "_" + interval_name;
 
-  std::string file_name;
-  file_name = IO::PrefixPosterior() + IO::PrefixCovariance() + "Vp" + interval_name;
-  ParameterOutput::WriteFile(model_settings, cov_vp_, file_name, IO::PathToCorrelations(), &simbox, "Posterior covariance for Vp");
-
-  file_name = IO::PrefixPosterior() + IO::PrefixCovariance() + "Vs" + interval_name;
-  ParameterOutput::WriteFile(model_settings, cov_vs_, file_name, IO::PathToCorrelations(), &simbox, "Posterior covariance for Vs");
-
-  file_name = IO::PrefixPosterior() + IO::PrefixCovariance() + "Rho" + interval_name;
-  ParameterOutput::WriteFile(model_settings, cov_rho_, file_name, IO::PathToCorrelations(), &simbox, "Posterior covariance for density");
-
-  file_name = IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VpVs" + interval_name;
-  ParameterOutput::WriteFile(model_settings, cr_cov_vp_vs_, file_name, IO::PathToCorrelations(), &simbox, "Posterior cross-covariance for (Vp,Vs)");
-
-  file_name = IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VpRho" + interval_name;
-  ParameterOutput::WriteFile(model_settings, cr_cov_vp_rho_, file_name, IO::PathToCorrelations(), &simbox, "Posterior cross-covariance for (Vp,density)");
-
-  file_name = IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VsRho" + interval_name;
-  ParameterOutput::WriteFile(model_settings, cr_cov_vs_rho_, file_name, IO::PathToCorrelations(), &simbox, "Posterior cross-covariance for (Vs,density)");
+  std::vector<StormContGrid *> grids(6);
+  std::vector<std::string>     file_names(6);
+
+  grids[0] = cov_vp_;
+  grids[1] = cov_vs_;
+  grids[2] = cov_rho_;
+  grids[3] = cr_cov_vp_vs_;
+  grids[4] = cr_cov_vp_rho_;
+  grids[5] = cr_cov_vs_rho_;
+
+  file_names[0] = IO::PrefixPosterior() + IO::PrefixCovariance() + "Vp" + interval_name;
+  file_names[1] = IO::PrefixPosterior() + IO::PrefixCovariance() + "Vs" + interval_name;
+  file_names[2] = IO::PrefixPosterior() + IO::PrefixCovariance() + "Rho" + interval_name;
+  file_names[3] = IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VpVs" + interval_name;
+  file_names[4] = IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VpRho" + interval_name;
+  file_names[5] = IO::PrefixPosterior() + IO::PrefixCrossCovariance() + "VsRho" + interval_name;
+
+  //The grids have always been written with is_seismic set.
+  for (int i = 0; i < 6; i++) {
+    if (output_writer != NULL)
+      output_writer->AddStormGrid(grids[i], false, file_names[i], IO::PathToCorrelations(), &simbox, true);
+    else
+      ParameterOutput::WriteFile(model_settings, grids[i], file_names[i], IO::PathToCorrelations(), &simbox, true);
+  }
 }
 
 void CravaResult::WriteBlockedWells(const std::map<std::string, BlockedLogsCommon *> & blocked_wells,
@@ -1909,7 +2110,8 @@ void CravaResult::WriteBackgrounds(const ModelSettings     * model_settings,
                                    StormContGrid           * background_vs,
                                    StormContGrid           * background_rho,
                                    GridMapping             * depth_mapping,
-                                   const TraceHeaderFormat & thf)
+                                   const TraceHeaderFormat & thf,
+                                   OutputWriter            * output_writer)
 {
   if (depth_mapping != NULL && depth_mapping->getSimbox() == NULL) {
     //H-CHECK
@@ -1925,13 +2127,19 @@ void CravaResult::WriteBackgrounds(const ModelSettings     * model_settings,
   std::string file_name_rho = IO::PrefixBackground() + "Rho";
 
   ExpTransf(background_vp_);
-  ParameterOutput::WriteFile(model_settings, background_vp, file_name_vp, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
-
   ExpTransf(background_vs_);
-  ParameterOutput::WriteFile(model_settings, background_vs, file_name_vs, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
-
   ExpTransf(background_rho_);
-  ParameterOutput::WriteFile(model_settings, background_rho, file_name_rho, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+
+  if (output_writer != NULL) {
+    output_writer->AddStormGrid(background_vp,  false, file_name_vp,  IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+    output_writer->AddStormGrid(background_vs,  false, file_name_vs,  IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+    output_writer->AddStormGrid(background_rho, false, file_name_rho, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+  }
+  else {
+    ParameterOutput::WriteFile(model_settings, background_vp, file_name_vp, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+    ParameterOutput::WriteFile(model_settings, background_vs, file_name_vs, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+    ParameterOutput::WriteFile(model_settings, background_rho, file_name_rho, IO::PathToBackground(), simbox, false, "NO_LABEL", 0, depth_mapping, thf);
+  }
 
   //
   // For debugging: write cubes not in ASCII, with padding, and with flat top.
@@ -21,6 +21,7 @@ class ParameterOutput;
 class Wavelet1D;
 class MultiIntervalGrid;
 class BlockedLogsCommon;
+class OutputWriter;
 
 class CravaResult
 {
@@ -40,11 +41,18 @@ public:
                      double                   dz_min,
                      bool                     smooth = false);
 
-  float GetResampledTraceValue(const std::vector<float> & resampled_trace,
-                               const double             & dz_resampled,
-                               const double             & top,
-                               const double             & global_z,
-                               const double             & dz_final);
+  //Combines several result grids in one pass over the columns. interval_grids[g] holds the interval grids of final_grids[g].
+  void CombineResult(std::vector<StormContGrid *>         & final_grids,
+                     std::vector<std::vector<FFTGrid *> > & interval_grids,
+                     MultiIntervalGrid                    * multi_interval_grid,
+                     const std::vector<int>               & erosion_priorities,
+                     double                                 dz_min,
+                     bool                                   smooth = false);
+
+  int GetResampledTraceIndex(const std::vector<double> & z_resampled,
+                             const double              & dz_resampled,
+                             const double              & global_z,
+                             const double              & dz_final);
 
   double GetResampledTraceValue(const std::vector<double> & resampled_trace,
                                 const std::vector<double> & z_pos_resampled,
@@ -88,6 +96,17 @@ public:
   void WriteEstimationResults(ModelSettings           * model_settings,
                               CommonData              * common_data);
 
+  //Realisations are written as they are simulated, instead of being kept for CombineResults, when
+  //they need not be combined with other intervals or vintages. Returns true if this is possible.
+  bool SetupSimulationOutput(ModelSettings * model_settings,
+                             CommonData    * common_data);
+
+  //Writes one realisation (vp, vs and rho on log scale), and deletes the grids.
+  void WriteSimulation(FFTGrid * vp,
+                       FFTGrid * vs,
+                       FFTGrid * rho,
+                       int       sim_nr);
+
   void WriteFilePriorCorrT(fftw_real   * prior_corr_T,
                            const int   & nzp,
                            const float & dt,
@@ -105,7 +124,8 @@ public:
 
   void WriteFilePostCovGrids(const ModelSettings * model_settings,
                              const Simbox        & simbox,
-                             std::string           interval_name = "") const;
+                             std::string           interval_name = "",
+                             OutputWriter        * output_writer = NULL) const;
 
   void WriteBlockedWells(const std::map<std::string, BlockedLogsCommon *> & blocked_wells,
                          const ModelSettings                              * model_settings,
@@ -132,7 +152,8 @@ public:
                         StormContGrid           * background_vs,
                         StormContGrid           * background_rho,
                         GridMapping             * depth_mapping,
-                        const TraceHeaderFormat & thf);
+                        const TraceHeaderFormat & thf,
+                        OutputWriter            * output_writer = NULL);
 
   void ExpTransf(StormContGrid * grid);
 
@@ -244,6 +265,10 @@ private:
 
   bool                                                     write_crava_;
   int                                                      n_intervals_;
+  int                                                      n_threads_; //Threads used when combining interval grids
+
+  ModelSettings                                          * simulation_model_settings_; //Set by SetupSimulationOutput
+  CommonData                                             * simulation_common_data_;
 };
 
 #endif
@@ -58,7 +58,8 @@ bool doTimeLapseAVOInversion(ModelSettings           * modelSettings,
                              CommonData              * commonData,
                              SeismicParametersHolder & seismicParameters,
                              int                       vintage,
-                             int                       i_interval)
+                             int                       i_interval,
+                             CravaResult             * simulationOutput)
 {
   //For intervals: Combination of doFirstAVOInversion and doTimeLapseAVOInversion
 
@@ -76,7 +77,7 @@ bool doTimeLapseAVOInversion(ModelSettings           * modelSettings,
   bool failedLoadingModel = modelAVOdynamic == NULL || modelAVOdynamic->GetFailed();
 
   if(failedLoadingModel == false) {
-    AVOInversion * avoinversion = new AVOInversion(modelSettings, modelGeneral, modelAVOstatic, modelAVOdynamic, seismicParameters);
+    AVOInversion * avoinversion = new AVOInversion(modelSettings, modelGeneral, modelAVOstatic, modelAVOdynamic, seismicParameters, simulationOutput);
 
     delete avoinversion;
   }
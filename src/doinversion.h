@@ -12,6 +12,7 @@ class ModelGeneral;
 class InputFiles;
 class Simbox;
 class SeismicParametersHolder;
+class CravaResult;
 
 void setupStaticModels(ModelGeneral            *& modelGeneral,
                        ModelAVOStatic          *& modelAVOstatic,
@@ -28,7 +29,8 @@ bool doTimeLapseAVOInversion(ModelSettings           * modelSettings,
                              CommonData              * commonData,
                              SeismicParametersHolder & seismicParameters,
                              int                       vintage,
-                             int                       i_interval);
+                             int                       i_interval,
+                             CravaResult             * simulationOutput);
 
 bool doTimeLapseTravelTimeInversion(const ModelSettings     * modelSettings,
                                     ModelGeneral            * modelGeneral,
@@ -20,16 +20,23 @@
 #include "src/fftfilegrid.h"
 #include "src/simbox.h"
 #include "src/io.h"
+#include "src/fftplancache.h"
 
 FFTFileGrid::FFTFileGrid(int nx, int ny, int nz, int nxp, int nyp, int nzp) :
-FFTGrid(nx, ny, nz, nxp, nyp, nzp)
+FFTGrid(nx, ny, nz, nxp, nyp, nzp),
+inPos_(0),
+inEnd_(0),
+outPos_(0)
 {
   genFileName();
   accMode_=NONE;
 }
 
 FFTFileGrid::FFTFileGrid(FFTFileGrid  * fftGrid, bool expTrans) :
-FFTGrid()
+FFTGrid(),
+inPos_(0),
+inEnd_(0),
+outPos_(0)
 {
   float value;
   int   i,j,k;
@@ -108,13 +115,23 @@ FFTFileGrid::setAccessMode(int mode)
   {
   case READ:
     NRLib::OpenRead(inFile_,fNameIn_,std::ios::in | std::ios::binary);
+    inBuffer_.resize(bufferSize_);
+    inPos_ = 0;
+    inEnd_ = 0;
     break;
   case WRITE:
     NRLib::OpenWrite(outFile_,fNameOut_,std::ios::out | std::ios::binary);
+    outBuffer_.resize(bufferSize_);
+    outPos_ = 0;
     break;
   case READANDWRITE:
     NRLib::OpenRead(inFile_,fNameIn_,std::ios::in | std::ios::binary);
     NRLib::OpenWrite(outFile_,fNameOut_,std::ios::out | std::ios::binary);
+    inBuffer_.resize(bufferSize_);
+    inPos_ = 0;
+    inEnd_ = 0;
+    outBuffer_.resize(bufferSize_);
+    outPos_ = 0;
     break;
   case RANDOMACCESS:
     modified_ = 0;
@@ -127,22 +144,20 @@ FFTFileGrid::setAccessMode(int mode)
 void
 FFTFileGrid::endAccess()
 {
-  std::string tmp("");
   switch(accMode_)
   {
   case READ:
     inFile_.close();
+    std::vector<char>().swap(inBuffer_);
     break;
   case READANDWRITE:
     inFile_.close(); //Intentional fallthrough to WRITE
+    std::vector<char>().swap(inBuffer_);
   case WRITE:
+    flushOutBuffer();
     outFile_.close();
-    tmp = fNameIn_;
-    fNameIn_ = fNameOut_;
-    if(tmp != "")
-      fNameOut_ = tmp;
-    else
-      fNameOut_ = fNameIn_+"b";
+    std::vector<char>().swap(outBuffer_);
+    switchFiles();
     break;
   case RANDOMACCESS:
     if(modified_ != 0)
@@ -173,8 +188,7 @@ FFTFileGrid::getNextComplex()
   assert(istransformed_==true);
   assert(accMode_ == READ || accMode_ == READANDWRITE);
   fftw_complex cVal;
-  char * buffer = reinterpret_cast<char *>(&cVal);
-  inFile_.read(buffer,sizeof(fftw_complex));
+  readNext(reinterpret_cast<char *>(&cVal), sizeof(fftw_complex));
   return(cVal);
 }
 
@@ -186,8 +200,7 @@ FFTFileGrid::getNextReal()
   assert(istransformed_ == false);
   assert(accMode_ == READ || accMode_ == READANDWRITE);
   float rVal;
-  char * buffer = reinterpret_cast<char *>(&rVal);
-  inFile_.read(buffer,sizeof(float));
+  readNext(reinterpret_cast<char *>(&rVal), sizeof(float));
   return float(rVal);
 }
 
@@ -255,8 +268,7 @@ FFTFileGrid::SetNextComplex(std::complex<double> & value)
   fftw_complex tmp;
   tmp.re = static_cast<fftw_real>(value.real());
   tmp.im = static_cast<fftw_real>(value.imag());
-  char * buffer = reinterpret_cast<char *>(&tmp);
-  outFile_.write(buffer,sizeof(fftw_complex));
+  writeNext(reinterpret_cast<const char *>(&tmp), sizeof(fftw_complex));
   return(0);
 }
 
@@ -266,8 +278,7 @@ FFTFileGrid::setNextComplex(fftw_complex value)
 {
   assert(istransformed_==true);
   assert(accMode_ == READANDWRITE || accMode_ == WRITE);
-  char * buffer = reinterpret_cast<char *>(&value);
-  outFile_.write(buffer,sizeof(fftw_complex));
+  writeNext(reinterpret_cast<const char *>(&value), sizeof(fftw_complex));
   return(0);
 }
 
@@ -277,8 +288,7 @@ FFTFileGrid::setNextReal(float  value)
 {
   assert(istransformed_== false);
   assert(accMode_ == READANDWRITE || accMode_ == WRITE);
-  char * buffer = reinterpret_cast<char *>(&value);
-  outFile_.write(buffer,sizeof(float));
+  writeNext(reinterpret_cast<const char *>(&value), sizeof(float));
   return(0);
 }
 
@@ -359,6 +369,10 @@ void
 FFTFileGrid::fftInPlace()
 {
   assert(accMode_ == NONE || accMode_ == RANDOMACCESS);
+  if(accMode_ == NONE && useOutOfCoreFFT()) {
+    outOfCoreFFT(FFTW_REAL_TO_COMPLEX);
+    return;
+  }
   if(accMode_ != RANDOMACCESS)
     load();
   else
@@ -373,6 +387,10 @@ void
 FFTFileGrid::invFFTInPlace()
 {
   assert(accMode_ == NONE || accMode_ == RANDOMACCESS);
+  if(accMode_ == NONE && useOutOfCoreFFT()) {
+    outOfCoreFFT(FFTW_COMPLEX_TO_REAL);
+    return;
+  }
   if(accMode_ != RANDOMACCESS)
     load();
   else
@@ -570,6 +588,14 @@ FFTFileGrid::conjugate()
     save();
 }
 
+void
+FFTFileGrid::prepareExpressionTarget()
+{
+  // The grid must already be loaded, as its expression may be part of the one to evaluate.
+  assert(accMode_ == RANDOMACCESS);
+  modified_ = 1;
+}
+
 void
 FFTFileGrid::fillInComplexNoise(RandomGen * ranGen)
 {
@@ -583,6 +609,19 @@ FFTFileGrid::fillInComplexNoise(RandomGen * ranGen)
     save();
 }
 
+void
+FFTFileGrid::fillInComplexNoise(unsigned int seed, int realisation, int component)
+{
+  assert(accMode_ == NONE || accMode_ == RANDOMACCESS);
+  if(accMode_ != RANDOMACCESS)
+    load();
+  else
+    modified_ = 1;
+  FFTGrid::fillInComplexNoise(seed, realisation, component);
+  if(accMode_ != RANDOMACCESS)
+    save();
+}
+
 void
 FFTFileGrid::writeFile(const std::string & fileName,
                        const std::string & subDir,
@@ -677,14 +716,9 @@ FFTFileGrid::load()
     FFTGrid::createComplexGrid();
   if(fNameIn_ != "") //Something has been saved.
   {
-    int i, nRead = 1;
     NRLib::OpenRead(inFile_,fNameIn_,std::ios::in | std::ios::binary);
     //Real/complex does not matter in next line, since same meory is used.
-    for(i=0;((i<rsize_) && (nRead == 1));i++)
-    {
-      char * buffer = reinterpret_cast<char *>(&(rvalue_[i]));
-      inFile_.read(buffer,sizeof(float));
-    }
+    inFile_.read(reinterpret_cast<char *>(rvalue_), static_cast<std::streamsize>(rsize_)*sizeof(fftw_real));
     inFile_.close();
   }
 }
@@ -695,14 +729,16 @@ FFTFileGrid::save()
   assert(accMode_ == NONE || accMode_ == RANDOMACCESS);
   NRLib::OpenWrite(outFile_,fNameOut_,std::ios::out | std::ios::binary);
   //Real/complex does not matter in next line, since same meory is used.
-  int i, nWritten = 1;
-  for(i=0;((i<rsize_) && (nWritten == 1));i++)
-  {
-    char * buffer = reinterpret_cast<char *>(&(rvalue_[i]));
-    outFile_.write(buffer,sizeof(float));
-  }
+  outFile_.write(reinterpret_cast<const char *>(rvalue_), static_cast<std::streamsize>(rsize_)*sizeof(fftw_real));
   outFile_.close();
   unload();
+  switchFiles();
+}
+
+//The file just written becomes the input file, and the old input file is reused for the next write.
+void
+FFTFileGrid::switchFiles()
+{
   std::string tmp = fNameIn_;
   fNameIn_ = fNameOut_;
   if(tmp != "")
@@ -711,14 +747,197 @@ FFTFileGrid::save()
     fNameOut_ = fNameIn_+"b";
 }
 
+bool
+FFTFileGrid::useOutOfCoreFFT() const
+{
+  return(fNameIn_ != "" && static_cast<size_t>(rsize_)*sizeof(fftw_real) > fftMemory_);
+}
+
+//The 3D transform is done as a 2D transform of each xy-plane and a 1D transform
+//of each z-column, as in FFTGrid::parallelFFT3D(). The planes are transformed
+//a slab at a time, and the columns a bundle at a time, so that no more than
+//fftMemory_ bytes of the grid are in memory. The first pass reads the input
+//file and writes the output file, and the second pass updates the output file
+//in place. Scaling is the same as in FFTGrid::fftInPlace() and invFFTInPlace().
+void
+FFTFileGrid::outOfCoreFFT(fftw_direction dir)
+{
+  time_t timestart, timeend;
+  time(&timestart);
+
+  assert(istransformed_ == (dir == FFTW_COMPLEX_TO_REAL));
+  assert(cubetype_ != CTMISSING);
+
+  float n = static_cast<float>(nxp_)*static_cast<float>(nyp_)*static_cast<float>(nzp_);
+  float scale;
+  if(dir == FFTW_REAL_TO_COMPLEX)
+    scale = (cubetype_ != COVARIANCE ? 1.0f/sqrt(n) : 1.0f);
+  else
+    scale = (cubetype_ == COVARIANCE ? 1.0f/n : 1.0f/sqrt(n));
+
+  std::ifstream src;
+  std::ofstream dst;
+  std::fstream  file;
+  NRLib::OpenRead(src, fNameIn_, std::ios::in | std::ios::binary);
+  NRLib::OpenWrite(dst, fNameOut_, std::ios::out | std::ios::binary);
+  if(dir == FFTW_REAL_TO_COMPLEX)
+    transformPlanesOnFile(src, dst, dir, scale);
+  else
+    transformColumnsOnFile(src, dst, FFTW_BACKWARD);
+  src.close();
+  dst.close();
+
+  NRLib::OpenRead(file, fNameOut_, std::ios::in | std::ios::out | std::ios::binary);
+  if(dir == FFTW_REAL_TO_COMPLEX)
+    transformColumnsOnFile(file, file, FFTW_FORWARD);
+  else
+    transformPlanesOnFile(file, file, dir, scale);
+  file.close();
+
+  switchFiles();
+  istransformed_ = (dir == FFTW_REAL_TO_COMPLEX);
+
+  time(&timeend);
+  LogKit::LogFormatted(LogKit::DebugLow,"\nOut-of-core FFT of grid type %d finished after %ld seconds \n",cubetype_, timeend-timestart);
+}
+
+//Transforms each xy-plane. Forward, the real values are scaled before the transform,
+//and backward after. In both cases a plane takes cnxp_*nyp_ complex numbers on file.
+void
+FFTFileGrid::transformPlanesOnFile(std::istream & src, std::ostream & dst, fftw_direction dir, float scale)
+{
+  int    planeSize  = cnxp_*nyp_;
+  size_t planeBytes = static_cast<size_t>(planeSize)*sizeof(fftw_complex);
+  int    nSlab      = static_cast<int>(std::max(static_cast<size_t>(1), std::min(static_cast<size_t>(nzp_), fftMemory_/planeBytes)));
+
+  rfftwnd_plan   plan   = FFTPlanCache::getPlan2D(nyp_, nxp_, dir);
+  fftw_complex * buffer = static_cast<fftw_complex *>(fftw_malloc(nSlab*planeBytes));
+
+  for(int k0 = 0; k0 < nzp_; k0 += nSlab) {
+    int            nPlanes = std::min(nSlab, nzp_ - k0);
+    std::streamoff offset  = static_cast<std::streamoff>(k0)*static_cast<std::streamoff>(planeBytes);
+    src.seekg(offset);
+    src.read(reinterpret_cast<char *>(buffer), static_cast<std::streamsize>(nPlanes*planeBytes));
+
+#ifdef PARALLEL
+#pragma omp parallel for schedule(static) num_threads(nFFTThreads_)
+#endif
+    for(int k = 0; k < nPlanes; k++) {
+      fftw_complex * plane  = buffer + static_cast<size_t>(k)*planeSize;
+      fftw_real    * rplane = reinterpret_cast<fftw_real *>(plane);
+      if(dir == FFTW_REAL_TO_COMPLEX) {
+        for(int i = 0; i < 2*planeSize; i++)
+          rplane[i] *= scale;
+        rfftwnd_one_real_to_complex(plan, rplane, plane);
+      }
+      else {
+        rfftwnd_one_complex_to_real(plan, plane, rplane);
+        for(int i = 0; i < 2*planeSize; i++)
+          rplane[i] *= scale;
+      }
+    }
+
+    dst.seekp(offset);
+    dst.write(reinterpret_cast<const char *>(buffer), static_cast<std::streamsize>(nPlanes*planeBytes));
+  }
+  fftw_free(buffer);
+}
+
+//Transforms each z-column. A bundle of neighbouring columns is read as one
+//block per xy-plane, transformed in memory, and written back to the same place.
+void
+FFTFileGrid::transformColumnsOnFile(std::istream & src, std::ostream & dst, fftw_direction dir)
+{
+  const int blockSize = 32;
+  int       planeSize = cnxp_*nyp_;
+  size_t    colBytes  = static_cast<size_t>(nzp_)*sizeof(fftw_complex);
+  int       nBundle   = static_cast<int>(std::max(static_cast<size_t>(1), std::min(static_cast<size_t>(planeSize), fftMemory_/colBytes)));
+
+  fftw_plan      plan = FFTPlanCache::getComplexPlan1D(nzp_, dir);
+  fftw_complex * rows = static_cast<fftw_complex *>(fftw_malloc(nBundle*colBytes));
+
+  for(int first = 0; first < planeSize; first += nBundle) {
+    int n = std::min(nBundle, planeSize - first);
+    for(int k = 0; k < nzp_; k++) {
+      src.seekg((static_cast<std::streamoff>(k)*planeSize + first)*static_cast<std::streamoff>(sizeof(fftw_complex)));
+      src.read(reinterpret_cast<char *>(rows + static_cast<size_t>(k)*n), static_cast<std::streamsize>(n*sizeof(fftw_complex)));
+    }
+
+    int nBlocks = (n + blockSize - 1)/blockSize;
+#ifdef PARALLEL
+#pragma omp parallel num_threads(nFFTThreads_)
+#endif
+    {
+      fftw_complex * buffer = new fftw_complex[blockSize*nzp_];
+#ifdef PARALLEL
+#pragma omp for schedule(static)
+#endif
+      for(int b = 0; b < nBlocks; b++)
+        transformZColumnBlock(rows, n, b*blockSize, std::min(blockSize, n - b*blockSize), nzp_, plan, buffer);
+      delete [] buffer;
+    }
+
+    for(int k = 0; k < nzp_; k++) {
+      dst.seekp((static_cast<std::streamoff>(k)*planeSize + first)*static_cast<std::streamoff>(sizeof(fftw_complex)));
+      dst.write(reinterpret_cast<const char *>(rows + static_cast<size_t>(k)*n), static_cast<std::streamsize>(n*sizeof(fftw_complex)));
+    }
+  }
+  fftw_free(rows);
+}
+
+//Sequential access goes through block buffers, so that the file is read and
+//written in large transfers instead of one call per cell.
+void
+FFTFileGrid::readNext(char * value, size_t size)
+{
+  if(inPos_ + size > inEnd_) {
+    fillInBuffer();
+    if(inPos_ + size > inEnd_) { //Past end of file.
+      memset(value, 0, size);
+      return;
+    }
+  }
+  memcpy(value, &inBuffer_[inPos_], size);
+  inPos_ += size;
+}
+
+void
+FFTFileGrid::writeNext(const char * value, size_t size)
+{
+  if(outPos_ + size > outBuffer_.size())
+    flushOutBuffer();
+  memcpy(&outBuffer_[outPos_], value, size);
+  outPos_ += size;
+}
+
+void
+FFTFileGrid::fillInBuffer()
+{
+  size_t remaining = inEnd_ - inPos_;
+  if(remaining > 0)
+    memmove(&inBuffer_[0], &inBuffer_[inPos_], remaining);
+  inFile_.read(&inBuffer_[remaining], static_cast<std::streamsize>(inBuffer_.size() - remaining));
+  inPos_ = 0;
+  inEnd_ = remaining + static_cast<size_t>(inFile_.gcount());
+}
+
+void
+FFTFileGrid::flushOutBuffer()
+{
+  if(outPos_ > 0)
+    outFile_.write(&outBuffer_[0], static_cast<std::streamsize>(outPos_));
+  outPos_ = 0;
+}
+
 void
 FFTFileGrid::unload()
 {
-  fftw_free(rvalue_); // changed
+  releaseGrid();
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
   nGrids_ = nGrids_ - 1;
 // LogKit::LogFormatted(LogKit::Error,"\nFFTFileGrid unload: nGrids_ = %d\n",nGrids_);
-  rvalue_ = NULL;
-  cvalue_ = NULL;
 }
 
 void
@@ -775,3 +994,4 @@ FFTFileGrid::setRealTrace(int i, int j, float *value)
 
 
 int FFTFileGrid::gNum = 0; //Starting value
+size_t FFTFileGrid::fftMemory_ = static_cast<size_t>(2048)*1024*1024;
@@ -6,6 +6,7 @@
 #define FFTFILEGRID_H
 
 #include <string>
+#include <vector>
 #include "fftw.h"
 
 #include "fftgrid.h"
@@ -42,6 +43,7 @@ public:
   void         multiply(FFTGrid* fftGrid);              // pointwise multiplication!
   void         conjugate();
   void         fillInComplexNoise(RandomGen * ranGen);
+  void         fillInComplexNoise(unsigned int seed, int realisation, int component);
   void         fftInPlace();
   void         invFFTInPlace();
   void         createRealGrid(bool add = true);
@@ -72,11 +74,25 @@ public:
   bool         isFile() {return(1);}
   void         getRealTrace(float * value, int i, int j);
   int          setRealTrace(int i, int j, float *value);
+
+  /// Grids larger than this are transformed out-of-core, with at most this much memory in use.
+  static void  setFFTMemory(size_t bytes) { fftMemory_ = bytes ;}
 private:
   void         genFileName();
+  void         prepareExpressionTarget();
   void         load();
   void         unload();
   void         save();
+  void         readNext(char * value, size_t size);
+  void         writeNext(const char * value, size_t size);
+  void         fillInBuffer();
+  void         flushOutBuffer();
+  void         switchFiles();
+
+  bool         useOutOfCoreFFT() const;
+  void         outOfCoreFFT(fftw_direction dir);
+  void         transformPlanesOnFile(std::istream & src, std::ostream & dst, fftw_direction dir, float scale);
+  void         transformColumnsOnFile(std::istream & src, std::ostream & dst, fftw_direction dir);
 
   int          accMode_;
   int          modified_;   //Tells if grid is modified during RANDOMACCESS.
@@ -85,6 +101,15 @@ private:
   std::ifstream inFile_;
   std::ofstream outFile_;
 
+  std::vector<char> inBuffer_;  //Block buffers for sequential access, allocated while the file is open.
+  std::vector<char> outBuffer_;
+  size_t       inPos_;    //Next unread byte in inBuffer_
+  size_t       inEnd_;    //End of valid data in inBuffer_
+  size_t       outPos_;   //End of unwritten data in outBuffer_
+
+  static const size_t bufferSize_ = 4194304; //Bytes per block transfer. Multiple of sizeof(fftw_complex).
+
   static int   gNum; //Number used for generating temporary files.
+  static size_t fftMemory_; //Memory available for out-of-core FFT, in bytes.
 };
 #endif
@@ -36,6 +36,10 @@
 #include "src/io.h"
 #include "src/tasklist.h"
 #include "src/seismicparametersholder.h"
+#include "src/fftplancache.h"
+#include "src/mappedmemory.h"
+#include "src/floatcompressor.h"
+#include "src/cravagridfile.h"
 
 FFTGrid::FFTGrid(int nx, int ny, int nz, int nxp, int nyp, int nzp)
 {
@@ -61,6 +65,8 @@ FFTGrid::FFTGrid(int nx, int ny, int nz, int nxp, int nyp, int nzp)
   counterForSet_  = 0;
   istransformed_  = false;
   rvalue_         = NULL;
+  mapped_         = false;
+  compressed_     = false;
   add_            = true;
 
   // index= i+rnxp_*j+k*rnxp_*nyp_;
@@ -71,6 +77,7 @@ FFTGrid::FFTGrid(int nx, int ny, int nz, int nxp, int nyp, int nzp)
 
 FFTGrid::FFTGrid(FFTGrid * fftGrid, bool expTrans)
 {
+  fftGrid->decompress();
   cubetype_       = fftGrid->cubetype_;
   theta_          = fftGrid->theta_;
   nx_             = fftGrid->nx_;
@@ -92,6 +99,8 @@ FFTGrid::FFTGrid(FFTGrid * fftGrid, bool expTrans)
 
   counterForGet_  = fftGrid->getCounterForGet();
   counterForSet_  = fftGrid->getCounterForSet();
+  mapped_         = false;
+  compressed_     = false;
   add_            = fftGrid->add_;
   istransformed_  = fftGrid->getIsTransformed();
 
@@ -146,6 +155,8 @@ FFTGrid::FFTGrid(const NRLib::Grid<float> * grid, int nxp, int nyp, int nzp)
   counterForSet_  = 0;
   istransformed_  = false;
   rvalue_         = NULL;
+  mapped_         = false;
+  compressed_     = false;
   add_            = true;
 
   // Copied from Background::createPaddedParameter
@@ -240,6 +251,8 @@ FFTGrid::FFTGrid(const StormContGrid * grid, int nxp, int nyp, int nzp)
   counterForSet_  = 0;
   istransformed_  = false;
   rvalue_         = NULL;
+  mapped_         = false;
+  compressed_     = false;
   add_            = true;
 
   // Copied from Background::createPaddedParameter
@@ -310,15 +323,22 @@ FFTGrid::FFTGrid(const StormContGrid * grid, int nxp, int nyp, int nzp)
 
 FFTGrid::~FFTGrid()
 {
-  if (rvalue_!=NULL)
+  if (rvalue_!=NULL || compressed_)
   {
-    if(add_==true)
-      nGrids_ = nGrids_ - 1;
-
-    fftw_free(rvalue_); //delete rvalue_;
-
-    FFTMemUse_ -= rsize_ * sizeof(fftw_real);
-    LogKit::LogFormatted(LogKit::DebugLow,"\nFFTGrid Destructor: nGrids_ = %d",nGrids_);
+    if (!compressed_)
+      releaseGrid();
+    int nGrids;
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
+    {
+      if(add_==true)
+        nGrids_ = nGrids_ - 1;
+      if (!compressed_)
+        FFTMemUse_ -= static_cast<double>(rsize_) * sizeof(fftw_real);
+      nGrids = nGrids_;
+    }
+    LogKit::LogFormatted(LogKit::DebugLow,"\nFFTGrid Destructor: nGrids_ = %d",nGrids);
   }
 }
 
@@ -1007,46 +1027,105 @@ FFTGrid::fillInComplexNoise(RandomGen * ranGen)
   float std = float(1/sqrt(2.0));
   for(i=0;i<csize_;i++)
   {
-    //if(xind == 0 || xind == nx-1 && nx is even)
-    if(((i % cnxp_) == 0) || (((i % cnxp_) == cnxp_-1) && ((i % 2) == 1)))
+    int cci = getConjugateNoiseIndex(i);
+    if(cci == i)                       //Number is its own cc, i. e. real
     {
-      int xshift = i % cnxp_;
-      int jkind  = (i-xshift)/cnxp_;
-      int jind   = jkind % nyp_;       //Index j along y-direction
-      int kind   = int(jkind/nyp_);    //Index k along z-direction
-      int jccind, kccind, jkccind;     //Indexes for complex conjugated
-      if(jind == 0)
-        jccind = 0;
-      else
-        jccind = nyp_-jind;
-      if(kind == 0)
-        kccind = 0;
-      else
-        kccind = nzp_-kind;
-      jkccind = jccind+kccind*nyp_;
-      if(jkccind == jkind)             //Number is its own cc, i. e. real
-      {
-        cvalue_[i].re = float(ranGen->rnorm01());
-        cvalue_[i].im = 0;
-      }
-      else if(jkccind > jkind)         //Have not simulated cc yet.
+      cvalue_[i].re = float(ranGen->rnorm01());
+      cvalue_[i].im = 0;
+    }
+    else if(cci < 0)                   //Have not simulated cc yet.
+    {
+      cvalue_[i].re = float(std*ranGen->rnorm01());
+      cvalue_[i].im = float(std*ranGen->rnorm01());
+    }
+    else                               //Look up cc value
+    {
+      cvalue_[i].re = cvalue_[cci].re;
+      cvalue_[i].im = -cvalue_[cci].im;
+    }
+  }
+}
+
+void
+FFTGrid::fillInComplexNoise(unsigned int seed,
+                            int          realisation,
+                            int          component)
+{
+  istransformed_ = true;
+  cubetype_      = PARAMETER;
+  float std      = float(1/sqrt(2.0));
+  int   nPlane   = cnxp_*nyp_;
+
+  // The cc values may be in another plane, so they are looked up when all planes are drawn.
+#ifdef PARALLEL
+#pragma omp parallel num_threads(nThreads_)
+#endif
+  {
+#ifdef PARALLEL
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for(int k=0;k<nzp_;k++)
+    {
+      RandomStream stream(seed, realisation, component, k);
+      for(int i=k*nPlane;i<(k+1)*nPlane;i++)
       {
-        cvalue_[i].re = float(std*ranGen->rnorm01());
-        cvalue_[i].im = float(std*ranGen->rnorm01());
+        int cci = getConjugateNoiseIndex(i);
+        if(cci == i)
+        {
+          cvalue_[i].re = float(stream.rnorm01());
+          cvalue_[i].im = 0;
+        }
+        else if(cci < 0)
+        {
+          cvalue_[i].re = float(std*stream.rnorm01());
+          cvalue_[i].im = float(std*stream.rnorm01());
+        }
       }
-      else                             //Look up cc value
+    }
+
+#ifdef PARALLEL
+#pragma omp for schedule(static)
+#endif
+    for(int i=0;i<csize_;i++)
+    {
+      int cci = getConjugateNoiseIndex(i);
+      if(cci >= 0 && cci != i)
       {
-        int cci = jkccind*cnxp_+xshift;
         cvalue_[i].re = cvalue_[cci].re;
         cvalue_[i].im = -cvalue_[cci].im;
       }
     }
+  }
+}
+
+// Returns i if the noise in complex cell i must be real, the index of the cell
+// holding its complex conjugate if that cell is drawn first, and -1 otherwise.
+int
+FFTGrid::getConjugateNoiseIndex(int i) const
+{
+  //if(xind == 0 || xind == nx-1 && nx is even)
+  if(((i % cnxp_) == 0) || (((i % cnxp_) == cnxp_-1) && ((i % 2) == 1)))
+  {
+    int xshift = i % cnxp_;
+    int jkind  = (i-xshift)/cnxp_;
+    int jind   = jkind % nyp_;       //Index j along y-direction
+    int kind   = int(jkind/nyp_);    //Index k along z-direction
+    int jccind, kccind, jkccind;     //Indexes for complex conjugated
+    if(jind == 0)
+      jccind = 0;
     else
-    {
-      cvalue_[i].re = float(std*ranGen->rnorm01());
-      cvalue_[i].im = float(std*ranGen->rnorm01());
-    }
+      jccind = nyp_-jind;
+    if(kind == 0)
+      kccind = 0;
+    else
+      kccind = nzp_-kind;
+    jkccind = jccind+kccind*nyp_;
+    if(jkccind == jkind)
+      return(i);
+    else if(jkccind < jkind)
+      return(jkccind*cnxp_+xshift);
   }
+  return(-1);
 }
 
 void
@@ -1054,8 +1133,12 @@ FFTGrid::createRealGrid(bool add)
 {
   istransformed_=false;
   add_ = add;
-  if(add==true)
+  if(add==true) {
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
     nGrids_ += 1;
+  }
   createGrid();
 }
 
@@ -1063,13 +1146,53 @@ void
 FFTGrid::createComplexGrid()
 {
   istransformed_  = true;
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
   nGrids_        += 1;
   createGrid();
 }
 
 void FFTGrid::createGrid()
 {
-  rvalue_         = static_cast<fftw_real*>(fftw_malloc(rsize_ * sizeof(fftw_real))); //new fftw_real[rsize_]; //static_cast<fftw_real*>(fftw_malloc(rsize_ * sizeof(fftw_real)));
+  rvalue_         = NULL;
+  mapped_         = false;
+  double bytes    = static_cast<double>(rsize_) * sizeof(fftw_real);
+  bool   useMapped;
+  int    nGrids;
+
+  // Grids may be created by several threads at once, e.g. when result grids are written
+  // in parallel. Memory is counted before it is allocated, so that all of them see it.
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
+  {
+    bool overBudget = (memoryBudget_ > 0.0 && FFTRamUse_ + bytes > memoryBudget_);
+    useMapped       = (mappedStorage_ || overBudget) && !isFile(); // Grids on file are only held in memory while accessed.
+    if (!useMapped)
+      FFTRamUse_   += bytes;
+    FFTMemUse_     += bytes;
+    if(FFTMemUse_ > maxFFTMemUse_) {
+      maxFFTMemUse_ = FFTMemUse_;
+      LogKit::LogFormatted(LogKit::DebugLow,"\nNew FFT-grid memory peak (%2d): %10.2f MB\n",nGrids_, FFTMemUse_/(1024.0*1024.0));
+    }
+    maxAllocatedGrids_ = std::max(nGrids_, maxAllocatedGrids_);
+    nGrids          = nGrids_;
+  }
+
+  if (useMapped) {
+    rvalue_       = static_cast<fftw_real*>(MappedMemory::allocate(rsize_ * sizeof(fftw_real)));
+    mapped_       = (rvalue_ != NULL);
+  }
+  if (rvalue_ == NULL) {
+    rvalue_       = static_cast<fftw_real*>(fftw_malloc(rsize_ * sizeof(fftw_real))); //new fftw_real[rsize_]; //static_cast<fftw_real*>(fftw_malloc(rsize_ * sizeof(fftw_real)));
+    if (useMapped) { // Mapping failed
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
+      FFTRamUse_ += bytes;
+    }
+  }
 
   cvalue_         = reinterpret_cast<fftw_complex*>(rvalue_); //
 
@@ -1077,7 +1200,7 @@ void FFTGrid::createGrid()
   counterForSet_  = 0;
 
  // LogKit::LogFormatted(LogKit::Error,"\nFFTGrid createGrid : nGrids = %d    maxGrids = %d\n",nGrids_,maxAllowedGrids_);
-  if (nGrids_ > maxAllowedGrids_) {
+  if (nGrids > maxAllowedGrids_) {
     std::string text;
     text += "\n\nERROR in FFTGrid createGrid. You have allocated too many FFTGrids. The fix";
     text += "\nis to increase the nGrids variable calculated in Model::checkAvailableMemory().\n";
@@ -1088,21 +1211,89 @@ void FFTGrid::createGrid()
       LogKit::LogFormatted(LogKit::Error, text);
       exit(1);
     }
-    else if(nGrids_ == maxAllowedGrids_+1) {
+    else if(nGrids == maxAllowedGrids_+1) {
       //NBNB-PAL: Commented out until memory handling is fixed in 4.0 release
       //TaskList::addTask("Crava needs more memory than expected. The results are still correct. \n Norwegian Computing Center would like to have a look at your project.");
     }
   }
-  maxAllocatedGrids_ = std::max(nGrids_, maxAllocatedGrids_);
+}
 
-  FFTMemUse_ += rsize_ * sizeof(fftw_real);
-  if(FFTMemUse_ > maxFFTMemUse_) {
-    maxFFTMemUse_ = FFTMemUse_;
-    LogKit::LogFormatted(LogKit::DebugLow,"\nNew FFT-grid memory peak (%2d): %10.2f MB\n",nGrids_, FFTMemUse_/(1024.f*1024.f));
+void FFTGrid::releaseGrid()
+{
+  if (mapped_) {
+    MappedMemory::release(rvalue_, rsize_ * sizeof(fftw_real));
   }
+  else {
+    fftw_free(rvalue_);
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
+    FFTRamUse_ -= static_cast<double>(rsize_) * sizeof(fftw_real);
+  }
+  rvalue_ = NULL;
+  cvalue_ = NULL;
+  mapped_ = false;
+}
+
+void FFTGrid::compress()
+{
+  if (!compressIdle_ || compressed_ || isFile() || rvalue_ == NULL)
+    return;
+
+  int    nSlabs   = nzp_;
+  size_t slabSize = static_cast<size_t>(rnxp_)*nyp_;
+  compressedValues_.resize(nSlabs);
 
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nThreads_)
+#endif
+  for (int k = 0; k < nSlabs; k++)
+    FloatCompressor::compress(rvalue_ + k*slabSize, slabSize, compressedValues_[k]);
+
+  double bytes = 0.0;
+  for (int k = 0; k < nSlabs; k++)
+    bytes += compressedValues_[k].size();
+  LogKit::LogFormatted(LogKit::DebugLow,"\nCompressed grid of type %d from %.2f MB to %.2f MB\n",cubetype_,
+                       rsize_*sizeof(fftw_real)/(1024.f*1024.f), bytes/(1024.0*1024.0));
+
+  releaseGrid();
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_memory)
+#endif
+  FFTMemUse_ -= static_cast<double>(rsize_) * sizeof(fftw_real);
+  compressed_ = true;
+}
 
+void FFTGrid::decompress()
+{
+  if (!compressed_)
+    return;
+
+  createGrid();
+
+  int    nSlabs   = nzp_;
+  size_t slabSize = static_cast<size_t>(rnxp_)*nyp_;
+  bool   ok       = true;
+
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nThreads_)
+#endif
+  for (int k = 0; k < nSlabs; k++) {
+    if (!FloatCompressor::decompress(compressedValues_[k], rvalue_ + k*slabSize, slabSize)) {
+#ifdef PARALLEL
+#pragma omp critical
+#endif
+      ok = false;
+    }
+    std::vector<unsigned char>().swap(compressedValues_[k]);
+  }
+  compressedValues_.clear();
+  compressed_ = false;
 
+  if (!ok) {
+    LogKit::LogFormatted(LogKit::Error,"\nERROR in FFTGrid decompress. The compressed grid values are not valid.\n");
+    exit(1);
+  }
 }
 
 int
@@ -1271,6 +1462,7 @@ FFTGrid::getRealValue(int i, int j, int k, bool extSimbox) const
 void
 FFTGrid::getRealTrace(float * value, int i, int j)
 {
+  decompress();
   for(int k = 0 ; k < nz_ ; k++)
     value[k] = FFTGrid::getRealValue(i,j,k);
 }
@@ -1368,6 +1560,7 @@ FFTGrid::getComplexValue(int i, int j, int k, bool extSimbox) const
 fftw_complex
 FFTGrid::getFirstComplexValue()
 {
+  decompress();
   assert(istransformed_);
   fftw_complex value;
 
@@ -1385,6 +1578,7 @@ FFTGrid::getFirstComplexValue()
 float
 FFTGrid::getFirstRealValue()
 {
+  decompress();
   assert(istransformed_==false);
   float value = static_cast<float>(rvalue_[0]);
   return( value );
@@ -1496,6 +1690,7 @@ FFTGrid::setComplexValue(int i, int j ,int k, fftw_complex value, bool extSimbox
 int
 FFTGrid::square()
 {
+  decompress();
   int i;
 
   if(istransformed_==true)
@@ -1536,6 +1731,7 @@ FFTGrid::square()
 int
 FFTGrid::expTransf()
 {
+  decompress();
   assert(istransformed_==false);
   int i;
   for(i = 0;i < rsize_; i++)
@@ -1556,6 +1752,7 @@ FFTGrid::expTransf()
 int
 FFTGrid::logTransf()
 {
+  decompress();
   assert(istransformed_==false);
   int i;
   for(i = 0;i < rsize_; i++)
@@ -1576,6 +1773,7 @@ FFTGrid::logTransf()
 int
 FFTGrid::collapseAndAdd(float * grid)
 {
+  decompress();
   assert(istransformed_==false);
   int   i,j;
   float value;
@@ -1593,6 +1791,7 @@ FFTGrid::collapseAndAdd(float * grid)
 void
 FFTGrid::fftInPlace()
 {
+  decompress();
   // uses norm preserving transform for parameter and data
   // in case of correlation and cross correlation it
   // scale  by 1/N on the inverse such that it maps between
@@ -1607,12 +1806,13 @@ FFTGrid::fftInPlace()
   if( cubetype_!= COVARIANCE )
     FFTGrid::multiplyByScalar(1.0f/sqrt(static_cast<float>(nxp_*nyp_*nzp_)));
 
-  int flag;
-  rfftwnd_plan plan;
-  flag = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan= rfftw3d_create_plan(nzp_,nyp_,nxp_,FFTW_REAL_TO_COMPLEX,flag);
-  rfftwnd_one_real_to_complex(plan,rvalue_,cvalue_);
-  fftwnd_destroy_plan(plan);
+  if (nFFTThreads_ > 1) {
+    parallelFFT3D(std::vector<FFTGrid *>(1, this), FFTW_REAL_TO_COMPLEX);
+  }
+  else {
+    rfftwnd_plan plan = FFTPlanCache::getPlan3D(nzp_,nyp_,nxp_,FFTW_REAL_TO_COMPLEX);
+    rfftwnd_one_real_to_complex(plan,rvalue_,cvalue_);
+  }
   istransformed_=true;
   time(&timeend);
   LogKit::LogFormatted(LogKit::DebugLow,"\nFFT of grid type %d finished after %ld seconds \n",cubetype_, timeend-timestart);
@@ -1621,6 +1821,7 @@ FFTGrid::fftInPlace()
 void
 FFTGrid::invFFTInPlace()
 {
+  decompress();
   // uses norm preserving transform for parameter and data
   // in case of correlation and cross correlation it
   // scale  by 1/N on the inverse such that it maps between
@@ -1633,17 +1834,18 @@ FFTGrid::invFFTInPlace()
   assert(cubetype_!= CTMISSING);
 
   float scale;
-  int flag;
-  rfftwnd_plan plan;
   if(cubetype_==COVARIANCE)
     scale=float( 1.0/(nxp_*nyp_*nzp_));
   else
     scale=float( 1.0/sqrt(float(nxp_*nyp_*nzp_)));
 
-  flag = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan= rfftw3d_create_plan(nzp_,nyp_,nxp_,FFTW_COMPLEX_TO_REAL,flag);
-  rfftwnd_one_complex_to_real(plan,cvalue_,rvalue_);
-  fftwnd_destroy_plan(plan);
+  if (nFFTThreads_ > 1) {
+    parallelFFT3D(std::vector<FFTGrid *>(1, this), FFTW_COMPLEX_TO_REAL);
+  }
+  else {
+    rfftwnd_plan plan = FFTPlanCache::getPlan3D(nzp_,nyp_,nxp_,FFTW_COMPLEX_TO_REAL);
+    rfftwnd_one_complex_to_real(plan,cvalue_,rvalue_);
+  }
   istransformed_=false;
 
   FFTGrid::multiplyByScalar(scale);
@@ -1651,9 +1853,196 @@ FFTGrid::invFFTInPlace()
   LogKit::LogFormatted(LogKit::DebugLow,"\nInverse FFT of grid type %d finished after %ld seconds \n",cubetype_, timeend-timestart);
 }
 
+void
+FFTGrid::fftAllInPlace(const std::vector<FFTGrid *> & grids)
+{
+  // Transforms all grids that are not already in the FFT domain. In-memory grids of the
+  // same size as the first one are transformed together, so that the threads are shared
+  // between all xy-planes and z-columns of the batch, using a single set of plans.
+  std::vector<FFTGrid *> batch = getFFTBatch(grids, false);
+
+  time_t timestart, timeend;
+  time(&timestart);
+
+  for (size_t g = 0; g < batch.size(); g++) {
+    assert(batch[g]->cubetype_ != CTMISSING);
+    if (batch[g]->cubetype_ != COVARIANCE)
+      batch[g]->multiplyByScalar(1.0f/sqrt(static_cast<float>(batch[g]->nxp_*batch[g]->nyp_*batch[g]->nzp_)));
+  }
+
+  parallelFFT3D(batch, FFTW_REAL_TO_COMPLEX);
+
+  for (size_t g = 0; g < batch.size(); g++)
+    batch[g]->istransformed_ = true;
+
+  time(&timeend);
+  if (batch.size() > 0)
+    LogKit::LogFormatted(LogKit::DebugLow,"\nFFT of %d grids finished after %ld seconds \n",static_cast<int>(batch.size()), timeend-timestart);
+}
+
+void
+FFTGrid::invFFTAllInPlace(const std::vector<FFTGrid *> & grids)
+{
+  std::vector<FFTGrid *> batch = getFFTBatch(grids, true);
+
+  time_t timestart, timeend;
+  time(&timestart);
+
+  parallelFFT3D(batch, FFTW_COMPLEX_TO_REAL);
+
+  for (size_t g = 0; g < batch.size(); g++) {
+    assert(batch[g]->cubetype_ != CTMISSING);
+    float scale;
+    if (batch[g]->cubetype_ == COVARIANCE)
+      scale = float( 1.0/(batch[g]->nxp_*batch[g]->nyp_*batch[g]->nzp_));
+    else
+      scale = float( 1.0/sqrt(float(batch[g]->nxp_*batch[g]->nyp_*batch[g]->nzp_)));
+    batch[g]->istransformed_ = false;
+    batch[g]->multiplyByScalar(scale);
+  }
+
+  time(&timeend);
+  if (batch.size() > 0)
+    LogKit::LogFormatted(LogKit::DebugLow,"\nInverse FFT of %d grids finished after %ld seconds \n",static_cast<int>(batch.size()), timeend-timestart);
+}
+
+std::vector<FFTGrid *>
+FFTGrid::getFFTBatch(const std::vector<FFTGrid *> & grids,
+                     bool                           transformed)
+{
+  // Returns the grids that can be transformed together, and transforms the
+  // remaining ones (grids on file, or of another size) one by one.
+  std::vector<FFTGrid *> batch;
+  for (size_t g = 0; g < grids.size(); g++) {
+    FFTGrid * grid = grids[g];
+    if (grid->getIsTransformed() != transformed)
+      continue;
+
+    bool fits = (nFFTThreads_ > 1 && grid->isFile() == false);
+    if (fits && batch.size() > 0)
+      fits = (grid->nxp_ == batch[0]->nxp_ && grid->nyp_ == batch[0]->nyp_ && grid->nzp_ == batch[0]->nzp_);
+
+    if (fits) {
+      grid->decompress();
+      batch.push_back(grid);
+    }
+    else if (transformed)
+      grid->invFFTInPlace();
+    else
+      grid->fftInPlace();
+  }
+  return batch;
+}
+
+void
+FFTGrid::parallelFFT3D(const std::vector<FFTGrid *> & grids,
+                       fftw_direction                 dir)
+{
+  // The 3D transform is split into a 2D real transform of each xy-plane and a
+  // 1D complex transform along each z-column, which is what rfftwnd does internally.
+  // The complex transform along z must come last in the forward direction and
+  // first in the inverse direction. All grids must have the same size.
+  if (grids.size() == 0)
+    return;
+
+  rfftwnd_plan planXY = FFTPlanCache::getPlan2D(grids[0]->nyp_, grids[0]->nxp_, dir);
+  fftw_plan    planZ;
+  if (dir == FFTW_REAL_TO_COMPLEX) {
+    planZ = FFTPlanCache::getComplexPlan1D(grids[0]->nzp_, FFTW_FORWARD);
+    transformXYPlanes(grids, planXY, dir);
+    transformZColumns(grids, planZ);
+  }
+  else {
+    planZ = FFTPlanCache::getComplexPlan1D(grids[0]->nzp_, FFTW_BACKWARD);
+    transformZColumns(grids, planZ);
+    transformXYPlanes(grids, planXY, dir);
+  }
+}
+
+void
+FFTGrid::transformXYPlanes(const std::vector<FFTGrid *> & grids,
+                           rfftwnd_plan                   plan,
+                           fftw_direction                 dir)
+{
+  // With the in-place storage, each xy-plane is itself a padded 2D in-place array
+  // (rnxp_*nyp_ reals or cnxp_*nyp_ complex numbers), so the planes are independent.
+  int nzp       = grids[0]->nzp_;
+  int planeSize = grids[0]->cnxp_*grids[0]->nyp_;
+  int nPlanes   = static_cast<int>(grids.size())*nzp;
+
+#ifdef PARALLEL
+#pragma omp parallel for schedule(static) num_threads(nFFTThreads_)
+#endif
+  for (int n = 0; n < nPlanes; n++) {
+    fftw_complex * plane = grids[n/nzp]->cvalue_ + (n%nzp)*planeSize;
+    if (dir == FFTW_REAL_TO_COMPLEX)
+      rfftwnd_one_real_to_complex(plan, reinterpret_cast<fftw_real *>(plane), plane);
+    else
+      rfftwnd_one_complex_to_real(plan, plane, reinterpret_cast<fftw_real *>(plane));
+  }
+}
+
+void
+FFTGrid::transformZColumns(const std::vector<FFTGrid *> & grids,
+                           fftw_plan                      plan)
+{
+  // The z-columns have stride cnxp_*nyp_. A block of neighbouring columns is
+  // transposed into a small buffer where each column is contiguous, transformed
+  // there, and transposed back. Each thread works on its own blocks and buffer.
+  const int blockSize = 32;
+  int nzp       = grids[0]->nzp_;
+  int planeSize = grids[0]->cnxp_*grids[0]->nyp_;
+  int nBlocks   = (planeSize + blockSize - 1)/blockSize;
+  int nTotal    = static_cast<int>(grids.size())*nBlocks;
+
+#ifdef PARALLEL
+#pragma omp parallel num_threads(nFFTThreads_)
+#endif
+  {
+    fftw_complex * buffer = new fftw_complex[blockSize*nzp];
+
+#ifdef PARALLEL
+#pragma omp for schedule(static)
+#endif
+    for (int b = 0; b < nTotal; b++) {
+      int first = (b%nBlocks)*blockSize;
+      transformZColumnBlock(grids[b/nBlocks]->cvalue_, planeSize, first, std::min(blockSize, planeSize - first), nzp, plan, buffer);
+    }
+
+    delete [] buffer;
+  }
+}
+
+void
+FFTGrid::transformZColumnBlock(fftw_complex * values,
+                               int            rowStride,
+                               int            first,
+                               int            n,
+                               int            nzp,
+                               fftw_plan      plan,
+                               fftw_complex * buffer)
+{
+  // Transforms the columns first,...,first+n-1 of values, where element k of
+  // column c is values[k*rowStride + c].
+  for (int k = 0; k < nzp; k++) {
+    fftw_complex * row = values + k*rowStride + first;
+    for (int c = 0; c < n; c++)
+      buffer[c*nzp + k] = row[c];
+  }
+
+  fftw(plan, n, buffer, 1, nzp, NULL, 0, 0);
+
+  for (int k = 0; k < nzp; k++) {
+    fftw_complex * row = values + k*rowStride + first;
+    for (int c = 0; c < n; c++)
+      row[c] = buffer[c*nzp + k];
+  }
+}
+
 void
 FFTGrid::realAbs()
 {
+  decompress();
   assert(istransformed_==true);
   int i;
   for(i=0;i<csize_;i++)
@@ -1666,6 +2055,8 @@ FFTGrid::realAbs()
 void
 FFTGrid::add(FFTGrid* fftGrid)
 {
+  decompress();
+  fftGrid->decompress();
   assert(nxp_==fftGrid->getNxp());
   if(istransformed_==true)
   {
@@ -1690,6 +2081,7 @@ FFTGrid::add(FFTGrid* fftGrid)
 void
 FFTGrid::addScalar(float scalar)
 {
+  decompress();
   // Only addition of scalar in real domain
   assert(istransformed_==false);
   int i;
@@ -1702,6 +2094,8 @@ FFTGrid::addScalar(float scalar)
 void
 FFTGrid::subtract(FFTGrid* fftGrid)
 {
+  decompress();
+  fftGrid->decompress();
   assert(nxp_==fftGrid->getNxp());
   if(istransformed_==true)
   {
@@ -1725,6 +2119,7 @@ FFTGrid::subtract(FFTGrid* fftGrid)
 void
 FFTGrid::changeSign()
 {
+  decompress();
   if(istransformed_==true)
   {
     int i;
@@ -1747,6 +2142,8 @@ FFTGrid::changeSign()
 void
 FFTGrid::multiply(FFTGrid* fftGrid)
 {
+  decompress();
+  fftGrid->decompress();
   assert(nxp_==fftGrid->getNxp());
   if(istransformed_==true)
   {
@@ -1772,6 +2169,7 @@ FFTGrid::multiply(FFTGrid* fftGrid)
 void
 FFTGrid::conjugate()
 {
+  decompress();
   assert(istransformed_==true);
   for(int i=0;i<csize_;i++)
   {
@@ -1782,6 +2180,7 @@ FFTGrid::conjugate()
 void
 FFTGrid::multiplyByScalar(float scalar)
 {
+  decompress();
   assert(istransformed_==false);
   for(int i=0;i<rsize_;i++)
   {
@@ -1795,16 +2194,11 @@ FFTGrid::fft1DzInPlace(fftw_real*  in, int nzp)
   // in is over vritten by out
   // not norm preservingtransform ifft(fft(funk))=N*funk
 
-  int flag;
-
-  rfftwnd_plan plan;
   fftw_complex* out;
   out = reinterpret_cast<fftw_complex*>(in);
 
-  flag    = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan    = rfftwnd_create_plan(1, &nzp ,FFTW_REAL_TO_COMPLEX,flag);
+  rfftwnd_plan plan = FFTPlanCache::getPlan1D(nzp, FFTW_REAL_TO_COMPLEX);
   rfftwnd_one_real_to_complex(plan,in ,out);
-  fftwnd_destroy_plan(plan);
 
   return out;
 }
@@ -1815,15 +2209,11 @@ FFTGrid::invFFT1DzInPlace(fftw_complex* in, int nzp)
   // in is over vritten by out
   // not norm preserving transform  ifft(fft(funk))=N*funk
 
-  int flag;
-  rfftwnd_plan plan;
   fftw_real*  out;
   out = reinterpret_cast<fftw_real*>(in);
 
-  flag = FFTW_ESTIMATE | FFTW_IN_PLACE;
-  plan= rfftwnd_create_plan(1,&nzp,FFTW_COMPLEX_TO_REAL,flag);
+  rfftwnd_plan plan = FFTPlanCache::getPlan1D(nzp, FFTW_COMPLEX_TO_REAL);
   rfftwnd_one_complex_to_real(plan,in,out);
-  fftwnd_destroy_plan(plan);
   return out;
 }
 
@@ -1852,6 +2242,7 @@ FFTGrid::writeFile(const std::string              & fName,
                    bool                             scientific_format,
                    const std::vector<std::string> & headerText)
 {
+  decompress();
   std::string fileName = IO::makeFullFileName(subDir, fName);
 
   if (formatFlag_ > 0) //Output format specified.
@@ -1910,6 +2301,7 @@ FFTGrid::writeStormFile(const std::string & fileName,
                         bool                flat,
                         bool                scientific_format)
 {
+  decompress();
   int nx, ny, nz;
   if(padding == true)
   {
@@ -1926,8 +2318,9 @@ FFTGrid::writeStormFile(const std::string & fileName,
 
   std::string gfName;
   std::string header = simbox->getStormHeader(cubetype_, nx, ny, nz, flat, ascii);
-  int i, j, k;
-  float value;
+
+  // The grid is written one k-layer at a time, in bulk.
+  std::vector<float> layer(nx*ny);
 
   if(ascii == false) {
     gfName = fileName + IO::SuffixStormBinary();
@@ -1935,13 +2328,10 @@ FFTGrid::writeStormFile(const std::string & fileName,
     std::ofstream binFile;
     NRLib::OpenWrite(binFile, gfName, std::ios::out | std::ios::binary);
     binFile << header;
-    for(k=0;k<nz;k++)
-      for(j=0;j<ny;j++)
-        for(i=0;i<nx;i++)
-        {
-          value = getRealValue(i,j,k,true);
-          NRLib::WriteBinaryFloat(binFile, value);
-        }
+    for(int k=0;k<nz;k++) {
+      getStormLayer(k, nx, ny, layer);
+      NRLib::WriteBinaryFloatArray(binFile, &layer[0], layer.size());
+    }
     binFile << "0\n";
     binFile.close();
   }
@@ -1951,21 +2341,12 @@ FFTGrid::writeStormFile(const std::string & fileName,
     NRLib::OpenWrite(file, gfName);
     LogKit::LogFormatted(LogKit::Low,"\nWriting STORM ascii file "+gfName+"...");
     file << header;
-    if (scientific_format){
-      file << std::scientific;
-    }
-    else{
-      file << std::fixed << std::setprecision(6);
+    // Same text as std::scientific or std::fixed with precision 6, one row per line without trailing blanks
+    const char * format = (scientific_format ? "%.6e" : "%.6f");
+    for(int k=0;k<nz;k++) {
+      getStormLayer(k, nx, ny, layer);
+      NRLib::WriteAsciiFloatArrayParallel(file, &layer[0], layer.size(), format, nx, false, nThreads_);
     }
-    for(k=0;k<nz;k++)
-      for(j=0;j<ny;j++) {
-        for(i=0;i<nx-1;i++) {
-          value = getRealValue(i,j,k,true);
-          file << value << " ";              // Rearrangement to avoid trailing blanks
-        }
-        value = getRealValue(nx-1,j,k,true); // Rearrangement to avoid trailing blanks
-        file << value << "\n";
-      }
     file << "0\n";
   }
 
@@ -1973,6 +2354,18 @@ FFTGrid::writeStormFile(const std::string & fileName,
 }
 
 
+void
+FFTGrid::getStormLayer(int                  k,
+                       int                  nx,
+                       int                  ny,
+                       std::vector<float> & layer) const
+{
+  for(int j=0;j<ny;j++)
+    for(int i=0;i<nx;i++)
+      layer[i+j*nx] = getRealValue(i,j,k,true);
+}
+
+
 int
 FFTGrid::writeSegyFile(const std::string              & fileName,
                        const Simbox                   * simbox,
@@ -1980,6 +2373,7 @@ FFTGrid::writeSegyFile(const std::string              & fileName,
                        const TraceHeaderFormat        & thf,
                        const std::vector<std::string> & headerText)
 {
+  decompress();
   //  long int timestart, timeend;
   //  time(&timestart);
 
@@ -2011,13 +2405,18 @@ FFTGrid::writeSegyFile(const std::string              & fileName,
   delete geometry; //Call above takes a copy.
   LogKit::LogFormatted(LogKit::Low,"\nWriting SEGY file "+gfName+"...");
 
-  int i,j,k;
-  double x,y,z;
-  std::vector<float> trace(segynz);//Maximum amount of data needed.
-
-  for(j=0;j<simbox->getny();j++)
+  // Traces are made by all threads. Each of them stores a trace in its own place in segy.
+  int         ny = simbox->getny();
+  std::string errText;
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 1) num_threads(nThreads_)
+#endif
+  for(int j=0;j<ny;j++)
   {
-    for(i=0;i<simbox->getnx();i++)
+    int k;
+    double x,y,z;
+    std::vector<float> trace(segynz);//Maximum amount of data needed.
+    for(int i=0;i<simbox->getnx();i++)
     {
       simbox->getCoord(i, j, 0, x, y, z);
       z = simbox->getTop(x,y);
@@ -2051,12 +2450,24 @@ FFTGrid::writeSegyFile(const std::string              & fileName,
 //          trace[k] = -1e35; //NBNB-Frode: Norsar-hack
         float xx = static_cast<float>(x);
         float yy = static_cast<float>(y);
-        segy->StoreTrace(xx, yy, trace, NULL);
+        try {
+          segy->StoreTrace(xx, yy, trace, NULL);
+        }
+        catch (std::exception & e) {
+#ifdef PARALLEL
+#pragma omp critical(fftgrid_segy_error)
+#endif
+          errText += std::string(e.what()) + "\n";
+        }
       }
     }
   }
+  if (errText != "") {
+    delete segy;
+    throw NRLib::Exception(errText);
+  }
 
-  segy->WriteAllTracesToFile();
+  segy->WriteAllTracesToFile(1, nThreads_);
 
   delete segy; //Closes file.
   // delete [] value;
@@ -2073,6 +2484,7 @@ FFTGrid::writeResampledStormCube(const GridMapping * gridmapping,
                                  const Simbox      * simbox,
                                  const int           format)
 {
+  decompress();
   // simbox is related to the cube we resample from. gridmapping contains simbox for the cube we resample to.
 
   float time, kindex;
@@ -2124,6 +2536,7 @@ FFTGrid::writeResampledStormCube(const GridMapping * gridmapping,
 int
 FFTGrid::writeSgriFile(const std::string & fileName, const Simbox *simbox, const std::string label)
 {
+  decompress();
   double vertScale = 0.001;
   double horScale  = 0.001;
   std::string fName = fileName + IO::SuffixSgriHeader();
@@ -2199,34 +2612,10 @@ FFTGrid::writeSgriFile(const std::string & fileName, const Simbox *simbox, const
 void
 FFTGrid::writeCravaFile(const std::string & fileName, const Simbox * simbox)
 {
+  decompress();
   try {
-    std::ofstream binFile;
     std::string fName = fileName + IO::SuffixCrava();
-    NRLib::OpenWrite(binFile, fName, std::ios::out | std::ios::binary);
-
-    std::string fileType = "crava_fftgrid_binary";
-    binFile << fileType << "\n";
-
-    NRLib::WriteBinaryDouble(binFile, simbox->getx0());
-    NRLib::WriteBinaryDouble(binFile, simbox->gety0());
-    NRLib::WriteBinaryDouble(binFile, simbox->getdx());
-    NRLib::WriteBinaryDouble(binFile, simbox->getdy());
-    NRLib::WriteBinaryInt(binFile, simbox->getnx());
-    NRLib::WriteBinaryInt(binFile, simbox->getny());
-    NRLib::WriteBinaryDouble(binFile, simbox->getIL0());
-    NRLib::WriteBinaryDouble(binFile, simbox->getXL0());
-    NRLib::WriteBinaryDouble(binFile, simbox->getILStepX());
-    NRLib::WriteBinaryDouble(binFile, simbox->getILStepY());
-    NRLib::WriteBinaryDouble(binFile, simbox->getXLStepX());
-    NRLib::WriteBinaryDouble(binFile, simbox->getXLStepY());
-    NRLib::WriteBinaryDouble(binFile, simbox->getAngle());
-    NRLib::WriteBinaryInt(binFile, rnxp_);
-    NRLib::WriteBinaryInt(binFile, nyp_);
-    NRLib::WriteBinaryInt(binFile, nzp_);
-    for(int i=0;i<rsize_;i++)
-      NRLib::WriteBinaryFloat(binFile, rvalue_[i]);
-
-    binFile.close();
+    CravaGridFile::write(fName, simbox, rvalue_, rnxp_, nyp_, nzp_, compressCravaFiles_, nThreads_);
   }
   catch (NRLib::Exception & e) {
     std::string message = "Error: "+std::string(e.what())+"\n";
@@ -2240,28 +2629,11 @@ FFTGrid::readCravaFile(const std::string & fileName, std::string & errText, bool
 {
   std::string error;
   try {
-    std::ifstream binFile;
-    NRLib::OpenRead(binFile, fileName, std::ios::in | std::ios::binary);
-
-    std::string fileType;
-    getline(binFile,fileType);
-
-    double dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryInt(binFile);
-    dummy = NRLib::ReadBinaryInt(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    dummy = NRLib::ReadBinaryDouble(binFile);
-    int rnxp = NRLib::ReadBinaryInt(binFile);
-    int nyp  = NRLib::ReadBinaryInt(binFile);
-    int nzp  = NRLib::ReadBinaryInt(binFile);
+    CravaGridFile file(fileName);
+
+    int rnxp = file.getRNXP();
+    int nyp  = file.getNYP();
+    int nzp  = file.getNZP();
 
     if (rnxp != rnxp_ || nyp != nyp_ || nzp != nzp_) {
       LogKit::LogFormatted(LogKit::Low,"\n\nERROR: The grid has different dimensions than the model grid. Check the padding settings");
@@ -2269,16 +2641,25 @@ FFTGrid::readCravaFile(const std::string & fileName, std::string & errText, bool
       LogKit::LogFormatted(LogKit::Low,"\n--------------------------------");
       LogKit::LogFormatted(LogKit::Low,"\nModel grid  :   %4d  %4d  %4d",rnxp_,nyp_,nzp_);
       LogKit::LogFormatted(LogKit::Low,"\nGrid on file:   %4d  %4d  %4d\n",rnxp ,nyp ,nzp );
-      binFile.close();
       throw(NRLib::Exception("Grid dimension is wrong for file '"+fileName+"'."));
     }
     createRealGrid(!nopadding);
     add_ = !nopadding;
-    int i;
-    for(i=0;i<rsize_;i++)
-      rvalue_[i] = NRLib::ReadBinaryFloat(binFile);
 
-    binFile.close();
+    // With memory mapped grids, an uncompressed file is mapped instead of read.
+    float * values = NULL;
+    if (mappedStorage_ && !isFile())
+      values = file.mapValues(nThreads_);
+
+    if (values != NULL) {
+      releaseGrid();
+      rvalue_ = values;
+      cvalue_ = reinterpret_cast<fftw_complex*>(rvalue_);
+      mapped_ = true;
+    }
+    else {
+      file.readSlab(0, nzp_, rvalue_, nThreads_);
+    }
   }
   catch (NRLib::Exception & e) {
     error = std::string("Error: ") + e.what() + "\n";
@@ -2680,5 +3061,12 @@ int FFTGrid::maxAllowedGrids_   = 1;   // One grid is allocated and deallocated
 int FFTGrid::maxAllocatedGrids_ = 0;
 int FFTGrid::nGrids_            = 0;
 bool FFTGrid::terminateOnMaxGrid_ = false;
-float FFTGrid::maxFFTMemUse_    = 0;
-float FFTGrid::FFTMemUse_       = 0;
+int FFTGrid::nFFTThreads_       = 1;
+int FFTGrid::nThreads_          = 1;
+bool FFTGrid::mappedStorage_    = false;
+double FFTGrid::memoryBudget_   = 0;
+double FFTGrid::FFTRamUse_      = 0;
+bool FFTGrid::compressIdle_     = false;
+bool FFTGrid::compressCravaFiles_ = false;
+double FFTGrid::maxFFTMemUse_   = 0;
+double FFTGrid::FFTMemUse_      = 0;
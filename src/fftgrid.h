@@ -6,12 +6,15 @@
 #define FFTGRID_H
 
 #include <assert.h>
+#include <algorithm>
 #include <complex>
 #include <string>
+#include <vector>
 
 #include "fftw.h"
 #include "rfftw.h"
 #include "definitions.h"
+#include "src/gridexpression.h"
 
 class Wavelet;
 class Simbox;
@@ -27,7 +30,7 @@ public:
   FFTGrid(FFTGrid * fftGrid, bool expTrans = false);
   FFTGrid(const NRLib::Grid<float> * grid, int nxp, int nyp, int nzp);
   FFTGrid(const StormContGrid * grid, int nxp, int nyp, int nzp);
-  FFTGrid() {} //Dummy constructor needed for FFTFileGrid
+  FFTGrid() : compressed_(false) {} //Dummy constructor needed for FFTFileGrid
   virtual ~FFTGrid();
 
   void setType(int cubeType) {cubetype_ = cubeType;}
@@ -96,6 +99,11 @@ public:
 
 
   virtual void         fillInComplexNoise(RandomGen * ranGen);   // No mode/randomaccess
+  // As above, but each plane draws from its own RandomStream. The noise only depends on
+  // the arguments, and not on the number of threads or on other use of random numbers.
+  virtual void         fillInComplexNoise(unsigned int seed,
+                                          int          realisation,
+                                          int          component);   // No mode/randomaccess
 
   void                 fillInFromArray(float *value);
   void                 calculateStatistics();                    // min,max, avg
@@ -121,6 +129,8 @@ public:
   virtual int          collapseAndAdd(float* grid);             // No mode/randomaccess
   virtual void         fftInPlace();                            // No mode/randomaccess
   virtual void         invFFTInPlace();                         // No mode/randomaccess
+  static void          fftAllInPlace(const std::vector<FFTGrid *> & grids);     // Grids already in FFT domain are skipped
+  static void          invFFTAllInPlace(const std::vector<FFTGrid *> & grids);  // Grids already in time domain are skipped
 
 
   virtual void         add(FFTGrid* fftGrid);                   // No mode/randomaccess
@@ -129,6 +139,19 @@ public:
   virtual void         changeSign();                   // No mode/randomaccess
   virtual void         multiply(FFTGrid* fftGrid);              // pointwise multiplication!
   virtual void         conjugate();                             // No mode/randomaccess
+
+  // Fused element-wise operations, see gridexpression.h. Example: a->apply(2.0*a->getRealExpression() + b->getRealExpression())
+  // Grids on file must be in RANDOMACCESS mode while their expressions are used.
+  GridExpression<RealGridLeaf>    getRealExpression()    const { assert(istransformed_ == false && rvalue_ != NULL); return makeGridExpression(rvalue_) ;}
+  GridExpression<ComplexGridLeaf> getComplexExpression() const { assert(istransformed_ == true  && cvalue_ != NULL); return makeGridExpression(cvalue_) ;}
+  template <class E>
+  void                 apply(const GridExpression<E> & expr) { prepareExpressionTarget(); applyExpression(expr, typename E::value_type()) ;}
+  static void          setNumberOfThreads(int nThreads) {nThreads_ = std::max(1, nThreads) ;}
+  static void          setMemoryMappedStorage(bool mapped) {mappedStorage_ = mapped ;}  // Values of grids created later are held in memory mapped files.
+  static void          setMemoryBudget(double bytes) {memoryBudget_ = bytes ;}          // Grids that would exceed this are memory mapped. Zero means no limit.
+  static void          setCompressIdleGrids(bool compress) {compressIdle_ = compress ;} // Allows compress() to compress grids.
+  static void          setCompressCravaFiles(bool compress) {compressCravaFiles_ = compress ;} // Grids on crava format are written compressed.
+
   bool                 consistentSize(int nx,int ny, int nz, int nxp, int nyp, int nzp);
   int                  getCounterForGet() const {return(counterForGet_);}
   int                  getCounterForSet() const {return(counterForSet_);}
@@ -157,7 +180,7 @@ public:
 
   virtual void         multiplyByScalar(float scalar);      //No mode/randomaccess
   int                  getType() const {return(cubetype_);}
-  virtual void         setAccessMode(int mode){assert(mode>=0);}
+  virtual void         setAccessMode(int mode){assert(mode>=0); decompress();}
   virtual void         endAccess(){counterForGet_ = 0; counterForSet_ = 0;}
   virtual void         writeFile(const std::string              & fileName,
                                  const std::string              & subDir,
@@ -185,6 +208,13 @@ public:
 
   virtual bool         isFile() {return(0);}    // indicates wether the grid is in memory or on disk
 
+  // A grid that will not be used for a while may be compressed, if compression of idle grids
+  // is turned on. The values are restored by the next setAccessMode(), FFT, element-wise
+  // operation or copy of the grid. Values must not be read directly before this.
+  void                 compress();                              // No mode
+  void                 decompress();                            // No effect unless compressed
+  bool                 getIsCompressed() const { return(compressed_) ;}
+
   static void          setOutputFlags(int format, int domain) {formatFlag_ = format;domainFlag_=domain;};
   static void          setOutputFormat(int format) {formatFlag_ = format;}
   int                  getOutputFormat() {return(formatFlag_);}
@@ -194,6 +224,8 @@ public:
   static int           getMaxAllowedGrids()   { return maxAllowedGrids_   ;}
   static int           getMaxAllocatedGrids() { return maxAllocatedGrids_ ;}
   static void          setTerminateOnMaxGrid(bool terminate) {terminateOnMaxGrid_ = terminate ;}
+  static void          setNumberOfFFTThreads(int nThreads) {nFFTThreads_ = std::max(1, nThreads) ;}
+  static int           getNumberOfFFTThreads() { return nFFTThreads_ ;}
   static int           findClosestFactorableNumber(int leastint);
 
   static fftw_complex* fft1DzInPlace(fftw_real*  in, int nzp);
@@ -214,16 +246,18 @@ public:
 
 
   static void          reportFFTMemoryAndWait(const std::string & msg) {
-                         LogKit::LogFormatted(LogKit::High, "%s: %2d grids, %10.2f MB\n", msg.c_str(), nGrids_, FFTMemUse_/(1024.0f*1024.0f));
+                         LogKit::LogFormatted(LogKit::High, "%s: %2d grids, %10.2f MB\n", msg.c_str(), nGrids_, FFTMemUse_/(1024.0*1024.0));
                          float tmp;
                          std::cin >> tmp;
-                         LogKit::LogFormatted(LogKit::High, "Memory used %4.0f MB, used outside grid %4.0f MB\n", tmp, tmp-FFTMemUse_/(1024.0f*1024.0f));
+                         LogKit::LogFormatted(LogKit::High, "Memory used %4.0f MB, used outside grid %4.0f MB\n", tmp, tmp-FFTMemUse_/(1024.0*1024.0));
                        }
 
   void                 createGrid();
 protected:
+  void                 releaseGrid();  // Frees rvalue_, allocated by createGrid()
   //int                setPaddingSize(int n, float p);
   int                  getFillNumber(int i, int n, int np );
+  int                  getConjugateNoiseIndex(int i) const;
 
   int                  getXSimboxIndex(int i) { return (getFillNumber(i, nx_, nxp_ )) ;}
   int                  getYSimboxIndex(int j) { return (getFillNumber(j, ny_, nyp_ )) ;}
@@ -242,6 +276,29 @@ protected:
   void                 writeSegyFromStorm(Simbox * simbox, StormContGrid *data, std::string fileName);
   void                 makeDepthCubeForSegy(Simbox *simbox,const std::string & fileName);
 
+  virtual void         prepareExpressionTarget() {}
+  template <class E>
+  void                 applyExpression(const GridExpression<E> & expr, double) {
+                         assert(istransformed_ == false);
+                         evaluateGridExpression(rvalue_, rsize_, expr, nThreads_);
+                       }
+  template <class E>
+  void                 applyExpression(const GridExpression<E> & expr, const fftw_complex &) {
+                         assert(istransformed_ == true);
+                         evaluateGridExpression(cvalue_, csize_, expr, nThreads_);
+                       }
+
+  /// Parallel alternative to the rfftwnd 3D transform, for one or more grids of the same size
+  static void          parallelFFT3D(const std::vector<FFTGrid *> & grids, fftw_direction dir);
+  static void          transformXYPlanes(const std::vector<FFTGrid *> & grids, rfftwnd_plan plan, fftw_direction dir);
+  static void          transformZColumns(const std::vector<FFTGrid *> & grids, fftw_plan plan);
+  static void          transformZColumnBlock(fftw_complex * values, int rowStride, int first, int n, int nzp,
+                                             fftw_plan plan, fftw_complex * buffer);   // buffer holds n*nzp values
+  static std::vector<FFTGrid *> getFFTBatch(const std::vector<FFTGrid *> & grids, bool transformed);
+
+  /// Values of xy-plane k of the (extended) grid, with i running fastest. Layer holds nx*ny values.
+  void                 getStormLayer(int k, int nx, int ny, std::vector<float> & layer) const;
+
   int                  cubetype_;          // see enum gridtypes above
   float                theta_;             // angle in angle gather (case of data)
   float                scale_;             // To keep track of the scalings after fourier transforms
@@ -264,6 +321,9 @@ protected:
 
   fftw_complex       * cvalue_;            // values of complex parameter in grid points
   fftw_real          * rvalue_;            // values of real parameter in grid points
+  bool                 mapped_;            // true if rvalue_ is held in a memory mapped file, see MappedMemory
+  bool                 compressed_;        // true if the values are held in compressedValues_, and rvalue_ is released
+  std::vector<std::vector<unsigned char> > compressedValues_; // One compressed block per xy-plane, see FloatCompressor
 
   float                rValMin_;           // minimum real value
   float                rValMax_;           // maximum real value
@@ -276,10 +336,17 @@ protected:
   static int           maxAllocatedGrids_; // The maximum number of grids that has actually been allocated.
   static int           nGrids_;            // The actually number of grids allocated (varies as crava runs).
   static bool          terminateOnMaxGrid_; // If true, terminate when we try to allocate more than maxAllowedGrids.
+  static int           nFFTThreads_;       // Number of threads used in 3D FFTs. One thread gives the serial rfftwnd transform.
+  static int           nThreads_;          // Number of threads used in element-wise operations.
+  static bool          mappedStorage_;     // If true, grid values are held in memory mapped files.
+  static double        memoryBudget_;      // Memory for grid values. Grids beyond this are memory mapped. Zero means no limit.
+  static double        FFTRamUse_;         // Memory used by grid values that are not memory mapped.
+  static bool          compressIdle_;      // If true, compress() compresses grids.
+  static bool          compressCravaFiles_; // If true, writeCravaFile() compresses the values.
   bool                 add_;                // Tells whether we should change nGrids_ or not
 
-  static float         maxFFTMemUse_;
-  static float         FFTMemUse_;
+  static double        maxFFTMemUse_;      // The memory counters are changed under omp critical(fftgrid_memory)
+  static double        FFTMemUse_;
 
 };
 #endif
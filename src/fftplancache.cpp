@@ -0,0 +1,186 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef PARALLEL
+#include <omp.h>
+#endif
+
+#include "fftw.h"
+#include "rfftw.h"
+
+#include "nrlib/iotools/logkit.hpp"
+
+#include "src/definitions.h"
+#include "src/fftplancache.h"
+
+std::map<std::vector<int>, rfftwnd_plan> FFTPlanCache::plans_;
+std::map<std::vector<int>, fftw_plan>    FFTPlanCache::complexPlans_;
+
+bool FFTPlanCache::measure_   = false;
+bool FFTPlanCache::useWisdom_ = false;
+
+rfftwnd_plan
+FFTPlanCache::getPlan1D(int            n,
+                        fftw_direction dir,
+                        bool           inPlace)
+{
+  return getPlan(1, &n, dir, inPlace);
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan2D(int            ny,
+                        int            nx,
+                        fftw_direction dir,
+                        bool           inPlace)
+{
+  int n[2] = {ny, nx};
+  return getPlan(2, n, dir, inPlace);
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan3D(int            nz,
+                        int            ny,
+                        int            nx,
+                        fftw_direction dir,
+                        bool           inPlace)
+{
+  // Same dimension order as rfftw3d_create_plan(), i.e. nx is the fastest running index
+  int n[3] = {nz, ny, nx};
+  return getPlan(3, n, dir, inPlace);
+}
+
+rfftwnd_plan
+FFTPlanCache::getPlan(int            rank,
+                      const int    * n,
+                      fftw_direction dir,
+                      bool           inPlace)
+{
+  std::vector<int> key(rank + 3);
+  key[0] = rank;
+  for (int i = 0; i < rank; i++)
+    key[i + 1] = n[i];
+  key[rank + 1] = static_cast<int>(dir);
+  key[rank + 2] = (inPlace ? 1 : 0);
+
+  rfftwnd_plan plan = NULL;
+
+  // The FFTW planner is not reentrant, so lookup and creation must be serialized.
+#ifdef PARALLEL
+#pragma omp critical(fftPlanCache)
+#endif
+  {
+    std::map<std::vector<int>, rfftwnd_plan>::const_iterator it = plans_.find(key);
+    if (it != plans_.end()) {
+      plan = it->second;
+    }
+    else {
+      plan = rfftwnd_create_plan(rank, n, dir, getFlags(inPlace));
+      plans_[key] = plan;
+    }
+  }
+  return plan;
+}
+
+fftw_plan
+FFTPlanCache::getComplexPlan1D(int            n,
+                               fftw_direction dir,
+                               bool           inPlace)
+{
+  std::vector<int> key(3);
+  key[0] = n;
+  key[1] = static_cast<int>(dir);
+  key[2] = (inPlace ? 1 : 0);
+
+  fftw_plan plan = NULL;
+
+#ifdef PARALLEL
+#pragma omp critical(fftPlanCache)
+#endif
+  {
+    std::map<std::vector<int>, fftw_plan>::const_iterator it = complexPlans_.find(key);
+    if (it != complexPlans_.end()) {
+      plan = it->second;
+    }
+    else {
+      plan = fftw_create_plan(n, dir, getFlags(inPlace));
+      complexPlans_[key] = plan;
+    }
+  }
+  return plan;
+}
+
+int
+FFTPlanCache::getFlags(bool inPlace)
+{
+  int flags = FFTW_THREADSAFE;
+  if (measure_)
+    flags |= FFTW_MEASURE;
+  else
+    flags |= FFTW_ESTIMATE;
+  if (inPlace)
+    flags |= FFTW_IN_PLACE;
+  if (useWisdom_)
+    flags |= FFTW_USE_WISDOM;
+  return flags;
+}
+
+bool
+FFTPlanCache::readWisdom(const std::string & fileName)
+{
+  // Wisdom is used and accumulated from now on, also if there is no file to read yet.
+  useWisdom_ = true;
+
+  bool  imported = false;
+  FILE * file    = fopen(fileName.c_str(), "r");
+  if (file != NULL) {
+    imported = (fftw_import_wisdom_from_file(file) == FFTW_SUCCESS);
+    fclose(file);
+    if (imported)
+      LogKit::LogFormatted(LogKit::Low, "\nFFT wisdom read from file %s.\n", fileName.c_str());
+    else
+      LogKit::LogFormatted(LogKit::Warning, "\nWARNING: Could not interpret FFT wisdom file %s. The file is ignored.\n", fileName.c_str());
+  }
+  return imported;
+}
+
+void
+FFTPlanCache::writeWisdom(const std::string & fileName)
+{
+  if (useWisdom_ == false)
+    return;
+
+  FILE * file = fopen(fileName.c_str(), "w");
+  if (file != NULL) {
+    fftw_export_wisdom_to_file(file);
+    fclose(file);
+    LogKit::LogFormatted(LogKit::DebugLow, "\nFFT wisdom written to file %s.\n", fileName.c_str());
+  }
+  else {
+    LogKit::LogFormatted(LogKit::Warning, "\nWARNING: Could not write FFT wisdom to file %s.\n", fileName.c_str());
+  }
+}
+
+void
+FFTPlanCache::releasePlans(void)
+{
+#ifdef PARALLEL
+#pragma omp critical(fftPlanCache)
+#endif
+  {
+    std::map<std::vector<int>, rfftwnd_plan>::iterator it;
+    for (it = plans_.begin(); it != plans_.end(); it++)
+      rfftwnd_destroy_plan(it->second);
+    plans_.clear();
+
+    std::map<std::vector<int>, fftw_plan>::iterator cit;
+    for (cit = complexPlans_.begin(); cit != complexPlans_.end(); cit++)
+      fftw_destroy_plan(cit->second);
+    complexPlans_.clear();
+  }
+}
@@ -0,0 +1,72 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef FFTPLANCACHE_H
+#define FFTPLANCACHE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "fftw.h"
+#include "rfftw.h"
+
+// Process-wide registry of rfftw plans. A plan is created the first time a
+// given (dimensions, direction, in-place) combination is asked for, and is
+// then handed out to every later caller until releasePlans() is called.
+//
+// All plans are created with FFTW_THREADSAFE, so a cached plan may be executed
+// by several threads at the same time. Plan creation itself is serialized.
+//
+// The returned plans are owned by the cache and must NOT be destroyed by the caller.
+
+class FFTPlanCache
+{
+public:
+  static rfftwnd_plan  getPlan1D(int            n,
+                                 fftw_direction dir,
+                                 bool           inPlace = true);
+
+  static rfftwnd_plan  getPlan2D(int            ny,
+                                 int            nx,
+                                 fftw_direction dir,
+                                 bool           inPlace = true);
+
+  static rfftwnd_plan  getPlan3D(int            nz,
+                                 int            ny,
+                                 int            nx,
+                                 fftw_direction dir,
+                                 bool           inPlace = true);
+
+  // Plan for complex-to-complex transforms of length n, to be executed with fftw().
+  static fftw_plan     getComplexPlan1D(int            n,
+                                        fftw_direction dir,
+                                        bool           inPlace = true);
+
+  static void          setMeasurePlans(bool measure) { measure_ = measure ;}
+  static bool          getMeasurePlans(void)         { return measure_    ;}
+
+  static bool          readWisdom(const std::string & fileName);
+  static void          writeWisdom(const std::string & fileName);
+
+  static void          releasePlans(void);
+
+private:
+  FFTPlanCache();
+
+  static rfftwnd_plan  getPlan(int            rank,
+                               const int    * n,
+                               fftw_direction dir,
+                               bool           inPlace);
+
+  static int           getFlags(bool inPlace);
+
+  static std::map<std::vector<int>, rfftwnd_plan> plans_;
+  static std::map<std::vector<int>, fftw_plan>    complexPlans_;
+
+  static bool          measure_;   // Use FFTW_MEASURE instead of FFTW_ESTIMATE when planning.
+  static bool          useWisdom_; // Wisdom has been imported, and new plans should use and extend it.
+};
+
+#endif
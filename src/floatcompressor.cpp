@@ -0,0 +1,208 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "src/floatcompressor.h"
+
+namespace {
+  const unsigned char RAW        = 0;       // Data stored as is, as compression did not pay off
+  const unsigned char SHUFFLE_LZ = 1;       // Data byte shuffled and LZ77 coded
+
+  const size_t        MIN_MATCH  = 4;
+  const size_t        MAX_OFFSET = 65535;
+  const int           HASH_BITS  = 14;
+
+  inline unsigned int read32(const unsigned char * p)
+  {
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    return(v);
+  }
+
+  inline unsigned int hash32(unsigned int v)
+  {
+    return((v*2654435761U) >> (32 - HASH_BITS));
+  }
+}
+
+void
+FloatCompressor::compress(const float                 * values,
+                          size_t                        n,
+                          std::vector<unsigned char>  & data)
+{
+  const size_t          nBytes = n*sizeof(float);
+  const unsigned char * bytes  = reinterpret_cast<const unsigned char *>(values);
+
+  std::vector<unsigned char> shuffled(nBytes);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t b = 0; b < sizeof(float); b++)
+      shuffled[b*n + i] = bytes[i*sizeof(float) + b];
+  }
+
+  data.clear();
+  data.reserve(nBytes/2 + 16);
+  data.push_back(SHUFFLE_LZ);
+  if (nBytes > 0)
+    encode(&shuffled[0], nBytes, data);
+
+  if (data.size() >= nBytes + 1) {
+    data.resize(nBytes + 1);
+    data[0] = RAW;
+    if (nBytes > 0)
+      memcpy(&data[1], bytes, nBytes);
+  }
+  std::vector<unsigned char>(data).swap(data); // Release unused capacity
+}
+
+bool
+FloatCompressor::decompress(const std::vector<unsigned char> & data,
+                            float                            * values,
+                            size_t                             n)
+{
+  const size_t    nBytes = n*sizeof(float);
+  unsigned char * bytes  = reinterpret_cast<unsigned char *>(values);
+
+  if (data.empty())
+    return(false);
+
+  if (data[0] == RAW) {
+    if (data.size() != nBytes + 1)
+      return(false);
+    if (nBytes > 0)
+      memcpy(bytes, &data[1], nBytes);
+    return(true);
+  }
+  if (data[0] != SHUFFLE_LZ)
+    return(false);
+  if (nBytes == 0)
+    return(data.size() == 1);
+
+  std::vector<unsigned char> shuffled(nBytes);
+  if (!decode(&data[1], data.size() - 1, &shuffled[0], nBytes))
+    return(false);
+
+  for (size_t i = 0; i < n; i++) {
+    for (size_t b = 0; b < sizeof(float); b++)
+      bytes[i*sizeof(float) + b] = shuffled[b*n + i];
+  }
+  return(true);
+}
+
+//
+// The coded stream is a sequence of
+//   token (literal count in high nibble, match length - MIN_MATCH in low nibble)
+//   extra literal count bytes (if high nibble is 15)
+//   literals
+//   match offset (two bytes, little endian)
+//   extra match length bytes (if low nibble is 15)
+// The last sequence has literals only.
+//
+void
+FloatCompressor::encode(const unsigned char * in, size_t n, std::vector<unsigned char> & out)
+{
+  std::vector<long> table(static_cast<size_t>(1) << HASH_BITS, -1);
+
+  size_t anchor = 0;
+  size_t pos    = 0;
+  while (pos + MIN_MATCH <= n) {
+    unsigned int seq  = read32(in + pos);
+    unsigned int h    = hash32(seq);
+    long         cand = table[h];
+    table[h]          = static_cast<long>(pos);
+
+    if (cand >= 0 && pos - cand <= MAX_OFFSET && read32(in + cand) == seq) {
+      size_t length = MIN_MATCH;
+      while (pos + length < n && in[cand + length] == in[pos + length])
+        length++;
+
+      size_t literals = pos - anchor;
+      size_t extra    = length - MIN_MATCH;
+      out.push_back(static_cast<unsigned char>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15)));
+      if (literals >= 15)
+        writeLength(literals - 15, out);
+      out.insert(out.end(), in + anchor, in + pos);
+
+      size_t offset = pos - cand;
+      out.push_back(static_cast<unsigned char>(offset & 0xff));
+      out.push_back(static_cast<unsigned char>(offset >> 8));
+      if (extra >= 15)
+        writeLength(extra - 15, out);
+
+      pos   += length;
+      anchor = pos;
+    }
+    else {
+      pos++;
+    }
+  }
+
+  size_t literals = n - anchor;
+  out.push_back(static_cast<unsigned char>(std::min<size_t>(literals, 15) << 4));
+  if (literals >= 15)
+    writeLength(literals - 15, out);
+  out.insert(out.end(), in + anchor, in + n);
+}
+
+bool
+FloatCompressor::decode(const unsigned char * in, size_t size, unsigned char * out, size_t n)
+{
+  size_t pos    = 0;
+  size_t outPos = 0;
+  while (pos < size) {
+    unsigned char token    = in[pos++];
+    size_t        literals = token >> 4;
+    if (literals == 15 && !readLength(in, size, pos, literals))
+      return(false);
+    if (literals > size - pos || literals > n - outPos)
+      return(false);
+    memcpy(out + outPos, in + pos, literals);
+    pos    += literals;
+    outPos += literals;
+
+    if (pos == size)
+      break;
+
+    if (size - pos < 2)
+      return(false);
+    size_t offset = in[pos] | (static_cast<size_t>(in[pos + 1]) << 8);
+    pos += 2;
+    size_t extra = token & 15;
+    if (extra == 15 && !readLength(in, size, pos, extra))
+      return(false);
+    size_t length = extra + MIN_MATCH;
+    if (offset == 0 || offset > outPos || length > n - outPos)
+      return(false);
+
+    const unsigned char * from = out + outPos - offset;
+    for (size_t i = 0; i < length; i++) // Byte by byte, as the match may overlap its own output
+      out[outPos + i] = from[i];
+    outPos += length;
+  }
+  return(outPos == n);
+}
+
+void
+FloatCompressor::writeLength(size_t length, std::vector<unsigned char> & out)
+{
+  while (length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back(static_cast<unsigned char>(length));
+}
+
+bool
+FloatCompressor::readLength(const unsigned char * in, size_t size, size_t & pos, size_t & length)
+{
+  unsigned char b;
+  do {
+    if (pos >= size)
+      return(false);
+    b       = in[pos++];
+    length += b;
+  } while (b == 255);
+  return(true);
+}
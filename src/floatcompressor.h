@@ -0,0 +1,39 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef FLOATCOMPRESSOR_H
+#define FLOATCOMPRESSOR_H
+
+#include <stddef.h>
+#include <vector>
+
+// Lossless compression of float arrays. The bytes of the values are shuffled so
+// that byte b of all values are stored together, and the shuffled bytes are then
+// compressed with a simple LZ77 coder. Sign and exponent bytes of smooth fields are
+// highly repetitive after shuffling, and compress well.
+
+class FloatCompressor
+{
+public:
+  /// Compresses n values into data. Data is overwritten.
+  static void compress(const float                 * values,
+                       size_t                        n,
+                       std::vector<unsigned char>  & data);
+
+  /// Restores n values compressed by compress(). Returns false if data is not valid.
+  static bool decompress(const std::vector<unsigned char> & data,
+                         float                            * values,
+                         size_t                             n);
+
+private:
+  FloatCompressor();
+
+  static void encode(const unsigned char * in, size_t n, std::vector<unsigned char> & out);
+  static bool decode(const unsigned char * in, size_t size, unsigned char * out, size_t n);
+
+  static void writeLength(size_t length, std::vector<unsigned char> & out);
+  static bool readLength(const unsigned char * in, size_t size, size_t & pos, size_t & length);
+};
+
+#endif
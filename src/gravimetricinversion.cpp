@@ -168,8 +168,8 @@ GravimetricInversion::GravimetricInversion(ModelGeneral            *  modelGener
     cov_rho_total->fftInPlace();
 
   // Convolution in the FFTdomain;
-  cov_rho_total->multiply(upscaling_kernel_abs);  // Now is expCovRhoTotal smoothed
-  cov_rho_total->multiply(upscaling_kernel_abs);  // Abs value (or use complex conjugate);
+  // Now is expCovRhoTotal smoothed. Abs value (or use complex conjugate);
+  cov_rho_total->apply(cov_rho_total->getComplexExpression()*upscaling_kernel_abs->getComplexExpression()*upscaling_kernel_abs->getComplexExpression());
 
   // Subsample in FFTDomain
   FFTGrid * upscaled_cov_rho_total;
@@ -488,8 +488,7 @@ void
 {
   assert(log_mean->getIsTransformed() == false);
 
-  log_mean->addScalar(0.5f*sigma_squared);  // \mu_{log rho^c} + 0.5*\sigma^2
-  log_mean->expTransf();  //exp{\mu_{log rho^c} + 0.5*\sigma^2}. Finished transformation.
+  log_mean->apply(exp(log_mean->getRealExpression() + 0.5f*sigma_squared));  //exp{\mu_{log rho^c} + 0.5*\sigma^2}. Finished transformation.
 }
 
 void
@@ -497,9 +496,7 @@ void
 {
   assert(log_cov->getIsTransformed() == false);
 
-  log_cov->expTransf();
-  log_cov->addScalar(-1);
-  log_cov->multiplyByScalar(mean*mean);
+  log_cov->apply((exp(log_cov->getRealExpression()) - 1.0)*(mean*mean));
 }
 
 void
@@ -507,9 +504,7 @@ void
 {
   assert(log_cov->getIsTransformed() == false);
 
-  log_cov->expTransf();
-  log_cov->addScalar(-1);
-  log_cov->multiplyByScalar(mean_a*mean_b);
+  log_cov->apply((exp(log_cov->getRealExpression()) - 1.0)*(mean_a*mean_b));
 }
 
 void
@@ -517,8 +512,7 @@ void
 {
   assert(mean->getIsTransformed() == false);
 
-  mean->logTransf();
-  mean->addScalar(-0.5f*sigma_squared);
+  mean->apply(log(mean->getRealExpression()) - 0.5f*sigma_squared);
 }
 
 void
@@ -526,9 +520,7 @@ void
 {
   assert(cov->getIsTransformed() == false);
 
-  cov->multiplyByScalar(1.0f/(mean*mean));
-  cov->addScalar(1);
-  cov->logTransf();
+  cov->apply(log(cov->getRealExpression()*(1.0f/(mean*mean)) + 1.0));
 }
 
 void
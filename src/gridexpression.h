@@ -0,0 +1,312 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef GRIDEXPRESSION_H
+#define GRIDEXPRESSION_H
+
+#include <math.h>
+#include <algorithm>
+
+#ifdef PARALLEL
+#include <omp.h>
+#endif
+
+#include "fftw.h"
+#include "src/definitions.h"
+
+// Fused element-wise arithmetic on grid arrays.
+//
+// An expression like exp(a + b) - 0.5*c is built as a tree of small objects, and is
+// evaluated in one pass over the output array by evaluateGridExpression(), instead of
+// one pass over the whole grid for each operation. Each element of the result only
+// depends on the elements with the same index, so the output array may also appear
+// in the expression.
+//
+// Real expressions are evaluated in double precision and stored as float. Complex
+// expressions (FFT domain) are evaluated with fftw_complex. Mixing the two in one
+// expression gives a compile error.
+//
+// Missing values are treated as in FFTGrid::expTransf(), FFTGrid::logTransf() and
+// FFTGrid::square(): exp() and square() keep RMISSING, while log() gives 0 for
+// RMISSING and nonpositive values. The other operations do not check for RMISSING.
+
+template <class E>
+class GridExpression
+{
+public:
+  typedef typename E::value_type value_type;
+
+  explicit   GridExpression(const E & node) : node_(node) {}
+
+  value_type operator[](int i) const { return node_[i] ;}
+  const E  & getNode(void)     const { return node_    ;}
+
+private:
+  E          node_;
+};
+
+//------------------------------------------------------------------
+// Leaves
+//------------------------------------------------------------------
+
+class RealGridLeaf
+{
+public:
+  typedef double value_type;
+
+  explicit   RealGridLeaf(const float * data) : data_(data) {}
+  double     operator[](int i) const { return data_[i] ;}
+
+private:
+  const float  * data_;
+};
+
+class ComplexGridLeaf
+{
+public:
+  typedef fftw_complex value_type;
+
+  explicit     ComplexGridLeaf(const fftw_complex * data) : data_(data) {}
+  fftw_complex operator[](int i) const { return data_[i] ;}
+
+private:
+  const fftw_complex * data_;
+};
+
+template <class T>
+class GridScalarLeaf
+{
+public:
+  typedef T  value_type;
+
+  explicit   GridScalarLeaf(const T & value) : value_(value) {}
+  T          operator[](int) const { return value_ ;}
+
+private:
+  T          value_;
+};
+
+//------------------------------------------------------------------
+// Inner nodes
+//------------------------------------------------------------------
+
+template <class A, class B, class Op>
+class GridBinaryNode
+{
+public:
+  typedef typename A::value_type value_type;
+
+  GridBinaryNode(const A & a, const B & b) : a_(a), b_(b) {}
+  value_type operator[](int i) const { return Op::apply(a_[i], b_[i]) ;}
+
+private:
+  A          a_;
+  B          b_;
+};
+
+template <class A, class Op>
+class GridUnaryNode
+{
+public:
+  typedef typename A::value_type value_type;
+
+  explicit   GridUnaryNode(const A & a) : a_(a) {}
+  value_type operator[](int i) const { return Op::apply(a_[i]) ;}
+
+private:
+  A          a_;
+};
+
+//------------------------------------------------------------------
+// Operations. Complex multiplication is written out as in FFTGrid::multiply().
+//------------------------------------------------------------------
+
+struct GridAdd
+{
+  static double       apply(double a, double b) { return a + b ;}
+  static fftw_complex apply(const fftw_complex & a, const fftw_complex & b) {
+    fftw_complex c;
+    c.re = a.re + b.re;
+    c.im = a.im + b.im;
+    return c;
+  }
+};
+
+struct GridSubtract
+{
+  static double       apply(double a, double b) { return a - b ;}
+  static fftw_complex apply(const fftw_complex & a, const fftw_complex & b) {
+    fftw_complex c;
+    c.re = a.re - b.re;
+    c.im = a.im - b.im;
+    return c;
+  }
+};
+
+struct GridMultiply
+{
+  static double       apply(double a, double b) { return a * b ;}
+  static fftw_complex apply(const fftw_complex & a, const fftw_complex & b) {
+    fftw_complex c;
+    c.re = b.re*a.re - b.im*a.im;
+    c.im = b.im*a.re + b.re*a.im;
+    return c;
+  }
+};
+
+struct GridDivide
+{
+  static double       apply(double a, double b) { return a / b ;}
+};
+
+struct GridNegate
+{
+  static double       apply(double a) { return -a ;}
+  static fftw_complex apply(const fftw_complex & a) {
+    fftw_complex c;
+    c.re = -a.re;
+    c.im = -a.im;
+    return c;
+  }
+};
+
+struct GridConjugate
+{
+  static fftw_complex apply(const fftw_complex & a) {
+    fftw_complex c;
+    c.re =  a.re;
+    c.im = -a.im;
+    return c;
+  }
+};
+
+struct GridExp
+{
+  static double       apply(double a) { return (a == RMISSING ? RMISSING : exp(a)) ;}
+};
+
+struct GridLog
+{
+  static double       apply(double a) { return (a == RMISSING || a <= 0.0 ? 0.0 : log(a)) ;}
+};
+
+struct GridAbs
+{
+  static double       apply(double a) { return fabs(a) ;}
+};
+
+struct GridSquare
+{
+  static double       apply(double a) { return (a == RMISSING ? RMISSING : a*a) ;}
+  static fftw_complex apply(const fftw_complex & a) {
+    fftw_complex c;
+    if (a.re == RMISSING || a.im == RMISSING) {
+      c.re = static_cast<float>(RMISSING);
+      c.im = static_cast<float>(RMISSING);
+    }
+    else {
+      c.re = a.re*a.re + a.im*a.im;
+      c.im = 0.0f;
+    }
+    return c;
+  }
+};
+
+//------------------------------------------------------------------
+// Construction
+//------------------------------------------------------------------
+
+inline GridExpression<RealGridLeaf>    makeGridExpression(const float        * data) { return GridExpression<RealGridLeaf>(RealGridLeaf(data))       ;}
+inline GridExpression<ComplexGridLeaf> makeGridExpression(const fftw_complex * data) { return GridExpression<ComplexGridLeaf>(ComplexGridLeaf(data)) ;}
+
+// Scalars in an expression take the value type of the other operand.
+inline double       makeGridScalar(double s, double)              { return s ;}
+inline fftw_complex makeGridScalar(double s, const fftw_complex &) {
+  fftw_complex c;
+  c.re = static_cast<float>(s);
+  c.im = 0.0f;
+  return c;
+}
+
+#define GRID_EXPRESSION_BINARY_OPERATOR(OP, NAME)                                                                   \
+template <class A, class B>                                                                                         \
+inline GridExpression<GridBinaryNode<A, B, NAME> >                                                                  \
+operator OP(const GridExpression<A> & a, const GridExpression<B> & b)                                               \
+{                                                                                                                   \
+  return GridExpression<GridBinaryNode<A, B, NAME> >(GridBinaryNode<A, B, NAME>(a.getNode(), b.getNode()));         \
+}                                                                                                                   \
+template <class A>                                                                                                  \
+inline GridExpression<GridBinaryNode<A, GridScalarLeaf<typename A::value_type>, NAME> >                             \
+operator OP(const GridExpression<A> & a, double s)                                                                  \
+{                                                                                                                   \
+  typedef GridScalarLeaf<typename A::value_type> S;                                                                 \
+  S b(makeGridScalar(s, typename A::value_type()));                                                                 \
+  return GridExpression<GridBinaryNode<A, S, NAME> >(GridBinaryNode<A, S, NAME>(a.getNode(), b));                   \
+}                                                                                                                   \
+template <class B>                                                                                                  \
+inline GridExpression<GridBinaryNode<GridScalarLeaf<typename B::value_type>, B, NAME> >                             \
+operator OP(double s, const GridExpression<B> & b)                                                                  \
+{                                                                                                                   \
+  typedef GridScalarLeaf<typename B::value_type> S;                                                                 \
+  S a(makeGridScalar(s, typename B::value_type()));                                                                 \
+  return GridExpression<GridBinaryNode<S, B, NAME> >(GridBinaryNode<S, B, NAME>(a, b.getNode()));                   \
+}
+
+GRID_EXPRESSION_BINARY_OPERATOR(+, GridAdd)
+GRID_EXPRESSION_BINARY_OPERATOR(-, GridSubtract)
+GRID_EXPRESSION_BINARY_OPERATOR(*, GridMultiply)
+GRID_EXPRESSION_BINARY_OPERATOR(/, GridDivide)
+
+#undef GRID_EXPRESSION_BINARY_OPERATOR
+
+#define GRID_EXPRESSION_UNARY_FUNCTION(FUNC, NAME)                                                                  \
+template <class A>                                                                                                  \
+inline GridExpression<GridUnaryNode<A, NAME> >                                                                      \
+FUNC(const GridExpression<A> & a)                                                                                   \
+{                                                                                                                   \
+  return GridExpression<GridUnaryNode<A, NAME> >(GridUnaryNode<A, NAME>(a.getNode()));                              \
+}
+
+GRID_EXPRESSION_UNARY_FUNCTION(operator-, GridNegate)
+GRID_EXPRESSION_UNARY_FUNCTION(conj,      GridConjugate)
+GRID_EXPRESSION_UNARY_FUNCTION(exp,       GridExp)
+GRID_EXPRESSION_UNARY_FUNCTION(log,       GridLog)
+GRID_EXPRESSION_UNARY_FUNCTION(abs,       GridAbs)
+GRID_EXPRESSION_UNARY_FUNCTION(square,    GridSquare)
+
+#undef GRID_EXPRESSION_UNARY_FUNCTION
+
+//------------------------------------------------------------------
+// Evaluation
+//------------------------------------------------------------------
+
+template <class E>
+void evaluateGridExpression(float                    * out,
+                            int                        n,
+                            const GridExpression<E>  & expr,
+                            int                        nThreads = 1)
+{
+  nThreads = std::max(1, nThreads);
+#ifdef PARALLEL
+#pragma omp parallel for schedule(static) num_threads(nThreads) if(nThreads > 1)
+#endif
+  for (int i = 0; i < n; i++)
+    out[i] = static_cast<float>(expr[i]);
+}
+
+template <class E>
+void evaluateGridExpression(fftw_complex             * out,
+                            int                        n,
+                            const GridExpression<E>  & expr,
+                            int                        nThreads = 1)
+{
+  nThreads = std::max(1, nThreads);
+#ifdef PARALLEL
+#pragma omp parallel for schedule(static) num_threads(nThreads) if(nThreads > 1)
+#endif
+  for (int i = 0; i < n; i++)
+    out[i] = expr[i];
+}
+
+#endif
@@ -45,6 +45,7 @@ public:
   inline static  std::string    FileTemporalCorr(void)             { return std::string("Temporal_Correlation")     ;}
   inline static  std::string    FileTimeToDepthVelocity(void)      { return std::string("Time-To-Depth_Velocity")   ;}
   inline static  std::string    FileTemporarySeismic(void)         { return std::string("Temp_seis")                ;}
+  inline static  std::string    FileFFTWisdom(void)                { return std::string("FFT_wisdom")               ;}
 
   // Prefixes
 
@@ -0,0 +1,111 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "nrlib/iotools/logkit.hpp"
+
+#include "src/mappedmemory.h"
+#include "src/io.h"
+
+void *
+MappedMemory::allocate(size_t bytes)
+{
+#if defined(_WIN32)
+  (void) bytes;
+  return(NULL);
+#else
+  if (bytes == 0)
+    return(NULL);
+
+  std::string       fileName = IO::makeFullFileName(IO::PathToTmpFiles(), IO::PrefixTmpGrids() + "mapped_XXXXXX");
+  std::vector<char> name(fileName.begin(), fileName.end());
+  name.push_back('\0');
+
+  int fd = mkstemp(&name[0]);
+  if (fd == -1) {
+    LogKit::LogFormatted(LogKit::Warning,"\nWARNING: Could not create file %s for memory mapped grid. Using ordinary memory.\n",fileName.c_str());
+    return(NULL);
+  }
+  unlink(&name[0]);
+
+  void * memory = NULL;
+  if (ftruncate(fd, static_cast<off_t>(bytes)) == 0) { // Sparse file. Disk space is used only for pages written to.
+    memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+      memory = NULL;
+  }
+  close(fd); // The mapping keeps the file open.
+
+  if (memory == NULL)
+    LogKit::LogFormatted(LogKit::Warning,"\nWARNING: Could not map %.1f MB for memory mapped grid. Using ordinary memory.\n",static_cast<double>(bytes)/(1024.0*1024.0));
+
+  return(memory);
+#endif
+}
+
+void *
+MappedMemory::mapFile(const std::string & fileName,
+                      size_t              offset,
+                      size_t              bytes)
+{
+#if defined(_WIN32)
+  (void) fileName;
+  (void) offset;
+  (void) bytes;
+  return(NULL);
+#else
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if (bytes == 0 || pageSize <= 0 || offset % static_cast<size_t>(pageSize) != 0)
+    return(NULL);
+
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1)
+    return(NULL);
+
+  struct stat fileInfo;
+  if (fstat(fd, &fileInfo) != 0 || static_cast<size_t>(fileInfo.st_size) < offset + bytes) { // Access beyond the end would crash
+    close(fd);
+    return(NULL);
+  }
+
+  void * memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+  if (memory == MAP_FAILED)
+    memory = NULL;
+  close(fd); // The mapping keeps the file open.
+
+  return(memory);
+#endif
+}
+
+bool
+MappedMemory::isAvailable()
+{
+#if defined(_WIN32)
+  return(false);
+#else
+  return(true);
+#endif
+}
+
+void
+MappedMemory::release(void * memory, size_t bytes)
+{
+#if defined(_WIN32)
+  (void) memory;
+  (void) bytes;
+#else
+  if (memory != NULL)
+    munmap(memory, bytes);
+#endif
+}
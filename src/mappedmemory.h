@@ -0,0 +1,40 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef MAPPEDMEMORY_H
+#define MAPPEDMEMORY_H
+
+#include <stddef.h>
+#include <string>
+
+// Memory backed by a sparse temporary file instead of RAM/swap. The file is
+// mapped into the address space, so the memory is used as ordinary memory,
+// while the operating system pages it to and from the file as needed. This
+// allows random access to more grid data than there is physical memory for.
+//
+// The file is removed as soon as it is mapped, so nothing is left behind if
+// the program terminates abnormally. Memory mapping is only available on
+// Linux/Unix. Elsewhere, and if the mapping fails, allocate() returns NULL.
+
+class MappedMemory
+{
+public:
+  /// Returns page-aligned, zero-initialized memory of the given size, or NULL.
+  static void * allocate(size_t bytes);
+
+  /// Maps bytes of an existing file from offset, which must be a multiple of the page size.
+  /// Changes to the memory are private, and not written to the file. Returns NULL on failure.
+  static void * mapFile(const std::string & fileName, size_t offset, size_t bytes);
+
+  /// Releases memory returned by allocate() or mapFile(). The size must be the one allocated.
+  static void   release(void * memory, size_t bytes);
+
+  /// False if memory mapping is not supported on this platform.
+  static bool   isAvailable();
+
+private:
+  MappedMemory();
+};
+
+#endif
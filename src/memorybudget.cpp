@@ -0,0 +1,50 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <stdio.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "src/memorybudget.h"
+
+double
+MemoryBudget::getSystemLimit()
+{
+#if defined(_WIN32)
+  return(0.0);
+#else
+  double limit = 0.0;
+
+  long pages    = sysconf(_SC_PHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if (pages > 0 && pageSize > 0)
+    limit = static_cast<double>(pages)*static_cast<double>(pageSize);
+
+  const char * cgroupFiles[] = {"/sys/fs/cgroup/memory.max",                     // cgroup v2
+                                "/sys/fs/cgroup/memory/memory.limit_in_bytes"};  // cgroup v1
+  for (int i = 0; i < 2; i++) {
+    double cgroupLimit = readLimit(cgroupFiles[i]);
+    if (cgroupLimit > 0.0 && (limit == 0.0 || cgroupLimit < limit))
+      limit = cgroupLimit;
+  }
+  return(limit);
+#endif
+}
+
+double
+MemoryBudget::readLimit(const char * fileName)
+{
+  // The file holds a number of bytes, or "max" if there is no limit.
+  double limit = 0.0;
+  FILE * file  = fopen(fileName, "r");
+  if (file != NULL) {
+    double value;
+    if (fscanf(file, "%lf", &value) == 1 && value > 0.0)
+      limit = value;
+    fclose(file);
+  }
+  return(limit);
+}
@@ -0,0 +1,24 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+// Finds how much memory the program may use, from the physical memory of the
+// machine and any limit set on the process by a control group (containers and
+// batch systems). Only available on Linux/Unix.
+
+class MemoryBudget
+{
+public:
+  /// Returns the memory limit in bytes, or 0 if it could not be found.
+  static double getSystemLimit();
+
+private:
+  MemoryBudget();
+
+  static double readLimit(const char * fileName);
+};
+
+#endif
@@ -151,7 +151,9 @@ ModelAVODynamic::ModelAVODynamic(ModelSettings          *& model_settings,
                               scale,
                               is_segy,
                               is_storm,
-                              true);
+                              true,
+                              model_settings->getNumberOfThreads(),
+                              model_settings->getUseFFTResampling());
 
       seis_cubes_[i]->endAccess();
 
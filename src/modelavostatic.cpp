@@ -23,6 +23,8 @@
 #include "src/simbox.h"
 #include "src/fftgrid.h"
 #include "src/fftfilegrid.h"
+#include "src/mappedmemory.h"
+#include "src/memorybudget.h"
 #include "src/timings.h"
 #include "src/io.h"
 #include "src/tasklist.h"
@@ -198,6 +200,8 @@ ModelAVOStatic::CheckAvailableMemory(const Simbox     * time_simbox,
 
       if (model_settings->getNumberOfSimulations() > 0) { //Second possible peak when simulating.
         int peak_2P = base_P + 3; //Three extra parameter grids for simulated parameters.
+        if (model_settings->getNumberOfSimulations() > 1 && model_settings->getPrecomputeCholesky())
+          peak_2P += 5;           //Cholesky factors of the posterior covariance.
         if (model_settings->getUseLocalNoise(0) == true &&
            (model_settings->getEstimateFaciesProb() == false || model_settings->getFaciesProbRelative() == false))
           peak_2P -= n_grid_background; //Background grids are released before simulation in this case.
@@ -256,9 +260,32 @@ ModelAVOStatic::CheckAvailableMemory(const Simbox     * time_simbox,
 
   if (mem2>mem1)
     LogKit::LogFormatted(LogKit::Low,"\n This estimate is too high because seismic data are cut to fit the internal grid\n");
-  if (!model_settings->getFileGrid()) {
+  double budget = static_cast<double>(model_settings->getMemoryBudget())*1024.0*1024.0;
+  if (budget == 0.0)
+    budget = MemoryBudget::getSystemLimit();
+
+  FFTGrid::setMemoryBudget(0.0);
+  if (!model_settings->getFileGrid() && !model_settings->getMemoryMappedGrids() && budget > 0.0) {
+    //
+    // Grids are held in memory up to the budget. Beyond it, grids are memory mapped, so
+    // that only they are paged to disk. Without memory mapping, all grids are kept on file.
+    //
+    LogKit::LogFormatted(LogKit::Low,"Memory budget:           %.1f megaBytes\n",budget/(1024.0*1024.0));
+    if (needed_mem > budget) {
+      if (MappedMemory::isAvailable()) {
+        double grid_budget = std::max(0.0, budget - mem0);
+        FFTGrid::setMemoryBudget(std::max(grid_budget, 1.0));
+        LogKit::LogFormatted(LogKit::Low,"Not enough memory to hold all grids. Grids beyond %.1f megaBytes are memory mapped.\n",grid_budget/(1024.0*1024.0));
+      }
+      else {
+        model_settings->setFileGrid(true);
+        LogKit::LogFormatted(LogKit::Low,"Not enough memory to hold all grids. Using file storage.\n");
+      }
+    }
+  }
+  else if (!model_settings->getFileGrid() && !model_settings->getMemoryMappedGrids()) {
     //
-    // Check if we can hold everything in memory.
+    // Check if we can hold everything in memory. Memory mapped grids need not fit in memory.
     //
     model_settings->setFileGrid(false);
     char ** memchunk  = new char*[n_grids];
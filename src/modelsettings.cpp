@@ -53,6 +53,7 @@ ModelSettings::ModelSettings(void)
   krigingParameter_           =        0; // Indicate kriging not set.
   nWells_                     =        0;
   nSimulations_               =        0;
+  precomputeCholesky_         =     true;
   backgroundType_             =       "";
 
   //
@@ -149,6 +150,17 @@ ModelSettings::ModelSettings(void)
   otherFlag_               =        0;
   debugFlag_               =        0;
   fileGrid_                =    false;
+  memoryMappedGrids_       =    false;
+  compressIdleGrids_       =    false;
+  compressCravaGrids_      =    false;
+  useSegyIndex_            =    false;
+  segyIndexDirectory_      =       "";
+  useFFTResampling_        =    false;
+  diskStorageFFTMemory_    =     2048;
+  memoryBudget_            =        0;
+  measureFFTPlans_         =    false;
+  useFFTWisdom_            =    false;
+  parallelFFT_             =     true;
   waveletFormatManual_     =    false;
   useVerticalVariogram_    =    false;
   do4DInversion_           =    false;
@@ -96,6 +96,7 @@ public:
   const std::vector<int>         & getIndicatorFilter(void)             const { return indFilter_                                 ;}
   int                              getNumberOfWells(void)               const { return nWells_                                    ;}
   int                              getNumberOfSimulations(void)         const { return nSimulations_                              ;}
+  bool                             getPrecomputeCholesky(void)          const { return precomputeCholesky_                        ;}
   float                            getTemporalCorrelationRange(void)    const { return temporalCorrelationRange_                  ;}
   float                            getVpMin(void)                       const { return vp_min_                                    ;}
   float                            getVpMax(void)                       const { return vp_max_                                    ;}
@@ -172,6 +173,17 @@ public:
   int                              getDebugFlag(void)                   const { return debugFlag_                                 ;}
   static int                       getDebugLevel(void)                        { return debugFlag_                                 ;}
   bool                             getFileGrid(void)                    const { return fileGrid_                                  ;}
+  bool                             getMemoryMappedGrids(void)           const { return memoryMappedGrids_                         ;}
+  bool                             getCompressIdleGrids(void)           const { return compressIdleGrids_                         ;}
+  bool                             getCompressCravaGrids(void)          const { return compressCravaGrids_                        ;}
+  bool                             getUseSegyIndex(void)                const { return useSegyIndex_                              ;}
+  const std::string              & getSegyIndexDirectory(void)          const { return segyIndexDirectory_                        ;}
+  bool                             getUseFFTResampling(void)            const { return useFFTResampling_                          ;}
+  int                              getDiskStorageFFTMemory(void)        const { return diskStorageFFTMemory_                      ;}
+  int                              getMemoryBudget(void)                const { return memoryBudget_                              ;}
+  bool                             getMeasureFFTPlans(void)             const { return measureFFTPlans_                           ;}
+  bool                             getUseFFTWisdom(void)                const { return useFFTWisdom_                              ;}
+  bool                             getParallelFFT(void)                 const { return parallelFFT_                               ;}
   bool                             getEstimationMode(void)              const { return estimationMode_                            ;}
   bool                             getForwardModeling(void)             const { return forwardModeling_                           ;}
   bool                             getGenerateSeismicAfterInv(void)     const { return generateSeismicAfterInv_                   ;}
@@ -338,6 +350,7 @@ public:
   void setNumberOfThreads(int n_threads)                  { number_of_threads_        = n_threads                ;}
   void setNumberOfWells(int nWells)                       { nWells_                   = nWells                   ;}
   void setNumberOfSimulations(int nSimulations)           { nSimulations_             = nSimulations             ;}
+  void setPrecomputeCholesky(bool precompute)             { precomputeCholesky_       = precompute               ;}
   void setVpMin(float vp_min)                             { vp_min_                   = vp_min                   ;}
   void setVpMax(float vp_max)                             { vp_max_                   = vp_max                   ;}
   void setVsMin(float vs_min)                             { vs_min_                   = vs_min                   ;}
@@ -411,6 +424,17 @@ public:
   void setOtherOutputFlag(int otherFlag)                  { otherFlag_                = otherFlag                ;}
   void setDebugFlag(int debugFlag)                        { debugFlag_                = debugFlag                ;}
   void setFileGrid(bool fileGrid)                         { fileGrid_                 = fileGrid                 ;}
+  void setMemoryMappedGrids(bool mapped)                  { memoryMappedGrids_        = mapped                   ;}
+  void setCompressIdleGrids(bool compress)                { compressIdleGrids_        = compress                 ;}
+  void setCompressCravaGrids(bool compress)               { compressCravaGrids_       = compress                 ;}
+  void setUseSegyIndex(bool useIndex)                     { useSegyIndex_             = useIndex                 ;}
+  void setSegyIndexDirectory(const std::string & dir)     { segyIndexDirectory_       = dir                      ;}
+  void setUseFFTResampling(bool useFFT)                   { useFFTResampling_         = useFFT                   ;}
+  void setDiskStorageFFTMemory(int megaBytes)             { diskStorageFFTMemory_     = megaBytes                ;}
+  void setMemoryBudget(int megaBytes)                     { memoryBudget_             = megaBytes                ;}
+  void setMeasureFFTPlans(bool measure)                   { measureFFTPlans_          = measure                  ;}
+  void setUseFFTWisdom(bool useWisdom)                    { useFFTWisdom_             = useWisdom                ;}
+  void setParallelFFT(bool parallelFFT)                   { parallelFFT_              = parallelFFT              ;}
   void setEstimationMode(bool estimationMode)             { estimationMode_           = estimationMode           ;}
   void setForwardModeling(bool forwardModeling)           { forwardModeling_          = forwardModeling          ;}
   void setGenerateSeismicAfterInv( bool generateSeismic)  { generateSeismicAfterInv_  = generateSeismic          ;}
@@ -679,6 +703,7 @@ private:
   int                               number_of_threads_;
   int                               nWells_;
   int                               nSimulations_;
+  bool                              precomputeCholesky_;         ///< Factorize the posterior covariance once for all realisations
 
   float                             vp_min_;                     ///< Vp - smallest allowed value
   float                             vp_max_;                     ///< Vp - largest allowed value
@@ -776,6 +801,17 @@ private:
   int                               waveletFormatFlag_;          ///< Decides wavelet output format
   int                               otherFlag_;                  ///< Decides output beyond grids and wells.
   bool                              fileGrid_;                   ///< Indicator telling if grids are to be kept on file
+  bool                              memoryMappedGrids_;          ///< Hold grid values in memory mapped temporary files
+  bool                              compressIdleGrids_;          ///< Compress grids in memory while they are not used
+  bool                              compressCravaGrids_;         ///< Compress grids written on crava format
+  bool                              useSegyIndex_;               ///< Keep trace headers of SEG-Y files in index files
+  std::string                       segyIndexDirectory_;         ///< Directory for SEG-Y index files. Empty means next to the SEG-Y file.
+  bool                              useFFTResampling_;           ///< Resample traces by FFT refinement instead of windowed sinc interpolation
+  int                               diskStorageFFTMemory_;       ///< Memory (MB) used when transforming grids kept on file
+  int                               memoryBudget_;               ///< Memory (MB) the run may use. Zero means find from the system.
+  bool                              measureFFTPlans_;            ///< Spend time measuring FFT plans instead of estimating them
+  bool                              useFFTWisdom_;               ///< Read and write FFT wisdom between runs
+  bool                              parallelFFT_;                ///< Use all threads in 3D FFTs of grids
   bool                              outputGridsDefault_;         ///< Indicator telling if grid output has been actively controlled
   bool                              waveletFormatManual_;        ///< True if wavelet format is decided in the model file
   bool                              useVerticalVariogram_;       ///< True if a vertical variogram is used to estimate temporal correlation
@@ -0,0 +1,167 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <time.h>
+#ifdef PARALLEL
+#include <omp.h>
+#endif
+
+#include "nrlib/exception/exception.hpp"
+#include "nrlib/iotools/logkit.hpp"
+
+#include "src/outputwriter.h"
+#include "src/parameteroutput.h"
+#include "src/fftgrid.h"
+#include "src/simbox.h"
+
+OutputWriter::OutputWriter(const ModelSettings * model_settings,
+                           int                   n_threads)
+  : model_settings_(model_settings),
+    n_threads_(n_threads > 0 ? n_threads : 1)
+{
+}
+
+OutputWriter::~OutputWriter(void)
+{
+  // Only reached with a non-empty queue when an exception stopped the output. The grids are not written.
+  for (size_t i = 0; i < jobs_.size(); i++) {
+    if (jobs_[i].delete_when_written)
+      delete jobs_[i].storm_grid;
+  }
+}
+
+void
+OutputWriter::AddStormGrid(StormContGrid           * grid,
+                           bool                      delete_when_written,
+                           const std::string       & f_name,
+                           const std::string       & sub_dir,
+                           const Simbox            * simbox,
+                           bool                      is_seismic,
+                           const std::string       & label,
+                           float                     z0,
+                           const GridMapping       * depth_map,
+                           const TraceHeaderFormat & thf)
+{
+  Job job;
+  job.storm_grid          = grid;
+  job.fft_grid            = NULL;
+  job.delete_when_written = delete_when_written;
+  job.f_name              = f_name;
+  job.sub_dir             = sub_dir;
+  job.simbox              = simbox;
+  job.is_seismic          = is_seismic;
+  job.label               = label;
+  job.z0                  = z0;
+  job.depth_map           = depth_map;
+  job.thf                 = thf;
+  job.n_bytes             = static_cast<double>(grid->GetN())*sizeof(float);
+  job.seconds             = 0.0;
+  AddJob(job);
+}
+
+void
+OutputWriter::AddCravaGrid(FFTGrid           * grid,
+                           const std::string & file_name,
+                           const Simbox      * simbox)
+{
+  Job job;
+  job.storm_grid          = NULL;
+  job.fft_grid            = grid;
+  job.delete_when_written = false;
+  job.f_name              = file_name;
+  job.simbox              = simbox;
+  job.is_seismic          = false;
+  job.z0                  = 0.0;
+  job.depth_map           = NULL;
+  job.n_bytes             = static_cast<double>(grid->getrsize())*sizeof(float);
+  job.seconds             = 0.0;
+  AddJob(job);
+}
+
+void
+OutputWriter::AddJob(const Job & job)
+{
+  jobs_.push_back(job);
+  if (static_cast<int>(jobs_.size()) >= n_threads_)
+    Flush();
+}
+
+void
+OutputWriter::Flush(void)
+{
+  if (jobs_.empty())
+    return;
+
+  int         n_jobs   = static_cast<int>(jobs_.size());
+  std::string err_text = "";
+  double      start    = GetWallTime();
+
+#ifdef PARALLEL
+#pragma omp parallel for schedule(dynamic, 1) num_threads(n_threads_)
+#endif
+  for (int i = 0; i < n_jobs; i++) {
+    try {
+      WriteJob(jobs_[i]);
+    }
+    catch (std::exception & e) {
+#ifdef PARALLEL
+#pragma omp critical(output_writer_error)
+#endif
+      err_text += std::string(e.what()) + "\n";
+    }
+  }
+
+  double seconds = GetWallTime() - start;
+  double sum     = 0.0;
+  for (int i = 0; i < n_jobs; i++) {
+    const Job & job = jobs_[i];
+    double mb       = job.n_bytes/(1024.0*1024.0);
+    LogKit::LogFormatted(LogKit::Medium, "\n  Wrote %-40s %8.1f MB in %7.2f s (%7.1f MB/s)", job.f_name.c_str(), mb, job.seconds,
+                         (job.seconds > 0.0 ? mb/job.seconds : 0.0));
+    sum += job.seconds;
+    if (job.delete_when_written)
+      delete job.storm_grid;
+  }
+  if (n_jobs > 1)
+    LogKit::LogFormatted(LogKit::Medium, "\n  %d grids written in %.2f s. Written one at a time they took %.2f s.\n", n_jobs, seconds, sum);
+  else
+    LogKit::LogFormatted(LogKit::Medium, "\n");
+
+  jobs_.clear();
+
+  if (err_text != "")
+    throw NRLib::Exception(err_text);
+}
+
+void
+OutputWriter::WriteJob(Job & job) const
+{
+  double start = GetWallTime();
+
+  if (job.fft_grid != NULL)
+    job.fft_grid->writeCravaFile(job.f_name, job.simbox);
+  else
+    ParameterOutput::WriteFile(model_settings_,
+                               job.storm_grid,
+                               job.f_name,
+                               job.sub_dir,
+                               job.simbox,
+                               job.is_seismic,
+                               job.label,
+                               job.z0,
+                               job.depth_map,
+                               job.thf);
+
+  job.seconds = GetWallTime() - start;
+}
+
+double
+OutputWriter::GetWallTime(void)
+{
+#ifdef PARALLEL
+  return(omp_get_wtime());
+#else
+  return(static_cast<double>(clock())/CLOCKS_PER_SEC); // Processor time, which is as good as we get without OpenMP
+#endif
+}
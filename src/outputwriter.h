@@ -0,0 +1,87 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "nrlib/segy/traceheader.hpp"
+
+#include "src/definitions.h"
+
+class FFTGrid;
+class Simbox;
+class GridMapping;
+class ModelSettings;
+
+// Queue of result grids waiting to be written. Each grid is written with
+// ParameterOutput::WriteFile (all requested formats, and depth if asked for)
+// or FFTGrid::writeCravaFile. The grids in the queue are written at the same
+// time, one grid per thread, when the queue is full and when Flush() is
+// called, so the time spent is about that of the largest grid in the batch.
+// The queue holds at most as many grids as there are threads.
+//
+// A grid that is handed over must not be changed before it has been written,
+// and the same grid object must not be added twice before a Flush().
+
+class OutputWriter
+{
+public:
+  OutputWriter(const ModelSettings * model_settings,
+               int                   n_threads);
+
+  ~OutputWriter(void);
+
+  // Same arguments as ParameterOutput::WriteFile. If delete_when_written is set,
+  // the writer takes over the grid.
+  void AddStormGrid(StormContGrid           * grid,
+                    bool                      delete_when_written,
+                    const std::string       & f_name,
+                    const std::string       & sub_dir,
+                    const Simbox            * simbox,
+                    bool                      is_seismic = false,
+                    const std::string       & label      = "NO_LABEL",
+                    float                     z0         = 0.0,
+                    const GridMapping       * depth_map  = NULL,
+                    const TraceHeaderFormat & thf        = TraceHeaderFormat(TraceHeaderFormat::SEISWORKS));
+
+  void AddCravaGrid(FFTGrid           * grid,
+                    const std::string & file_name,
+                    const Simbox      * simbox);
+
+  // Writes all queued grids, and reports the throughput for each of them.
+  void Flush(void);
+
+private:
+  struct Job
+  {
+    StormContGrid     * storm_grid;
+    FFTGrid           * fft_grid;
+    bool                delete_when_written;
+    std::string         f_name;
+    std::string         sub_dir;
+    const Simbox      * simbox;
+    bool                is_seismic;
+    std::string         label;
+    float               z0;
+    const GridMapping * depth_map;
+    TraceHeaderFormat   thf;
+    double              n_bytes;
+    double              seconds;
+  };
+
+  void        AddJob(const Job & job);
+
+  void        WriteJob(Job & job) const;
+
+  static double GetWallTime(void);
+
+  const ModelSettings * model_settings_;
+  int                   n_threads_;
+  std::vector<Job>      jobs_;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "src/fftgrid.h"
 #include "src/fftfilegrid.h"
 #include "src/parameteroutput.h"
+#include "src/outputwriter.h"
 #include "src/modelsettings.h"
 #include "src/simbox.h"
 #include "src/gridmapping.h"
@@ -12,6 +13,16 @@
 #include "lib/utils.h"
 #include "fft/include/fftw.h"
 
+template <class E>
+void
+ParameterOutput::Evaluate(StormContGrid             * result,
+                          const GridExpression<E>   & expr,
+                          const ModelSettings       * model_settings)
+{
+  // All grids in the expression have the same dimensions as result, and are evaluated in one pass.
+  evaluateGridExpression(&(*result)(0), static_cast<int>(result->GetN()), expr, model_settings->getNumberOfThreads());
+}
+
 void
 ParameterOutput::WriteParameters(const Simbox        * simbox,
                                  GridMapping         * time_depth_mapping,
@@ -21,7 +32,8 @@ ParameterOutput::WriteParameters(const Simbox        * simbox,
                                  StormContGrid       * rho,
                                  int                   output_flag,
                                  int                   sim_num,
-                                 bool                  kriged)
+                                 bool                  kriged,
+                                 OutputWriter        * output_writer)
 {
   std::string prefix;
   std::string suffix;
@@ -41,41 +53,41 @@ ParameterOutput::WriteParameters(const Simbox        * simbox,
 
   if((output_flag & IO::MURHO) > 0) {
     file_name = prefix+"MuRho"+suffix;
-    ComputeMuRho(simbox, time_depth_mapping, model_settings, vp, vs, rho, file_name);
+    ComputeMuRho(simbox, time_depth_mapping, model_settings, vp, vs, rho, file_name, output_writer);
   }
   if((output_flag & IO::LAMBDARHO) > 0) {
     file_name = prefix+"LambdaRho"+suffix;
-    ComputeLambdaRho(simbox, time_depth_mapping, model_settings, vp, vs, rho, file_name);
+    ComputeLambdaRho(simbox, time_depth_mapping, model_settings, vp, vs, rho, file_name, output_writer);
   }
   if((output_flag & IO::LAMELAMBDA) > 0) {
     file_name = prefix+"LameLambda"+suffix;
-    ComputeLameLambda(simbox, time_depth_mapping, model_settings, vp, vs, rho, file_name);
+    ComputeLameLambda(simbox, time_depth_mapping, model_settings, vp, vs, rho, file_name, output_writer);
   }
   if((output_flag & IO::LAMEMU) > 0) {
     file_name = prefix+"LameMu"+suffix;
-    ComputeLameMu(simbox, time_depth_mapping,  model_settings, vs, rho, file_name);
+    ComputeLameMu(simbox, time_depth_mapping,  model_settings, vs, rho, file_name, output_writer);
   }
   if((output_flag & IO::POISSONRATIO) > 0) {
     file_name = prefix+"PoissonRatio"+suffix;
-    ComputePoissonRatio(simbox, time_depth_mapping, model_settings, vp, vs, file_name);
+    ComputePoissonRatio(simbox, time_depth_mapping, model_settings, vp, vs, file_name, output_writer);
   }
   if((output_flag & IO::AI) > 0) {
     file_name = prefix+"AI"+suffix;
-    ComputeAcousticImpedance(simbox, time_depth_mapping, model_settings, vp, rho, file_name);
+    ComputeAcousticImpedance(simbox, time_depth_mapping, model_settings, vp, rho, file_name, output_writer);
   }
   if((output_flag & IO::SI) > 0) {
     file_name = prefix+"SI"+suffix;
-    ComputeShearImpedance(simbox, time_depth_mapping, model_settings, vs, rho, file_name);
+    ComputeShearImpedance(simbox, time_depth_mapping, model_settings, vs, rho, file_name, output_writer);
   }
   if((output_flag & IO::VPVSRATIO) > 0) {
     file_name = prefix+"VpVsRatio"+suffix;
-    ComputeVpVsRatio(simbox, time_depth_mapping, model_settings, vp, vs, file_name);
+    ComputeVpVsRatio(simbox, time_depth_mapping, model_settings, vp, vs, file_name, output_writer);
   }
   if((output_flag & IO::VP) > 0) {
     file_name = prefix+"Vp"+suffix;
 
-    ExpTransf(vp);
-    WriteToFile(simbox, time_depth_mapping, model_settings, vp, file_name, "Inverted Vp");
+    ExpTransf(vp, model_settings);
+    WriteToFile(simbox, time_depth_mapping, model_settings, vp, file_name, "Inverted Vp", false, output_writer);
     //if (sim_num < 0) //prediction, need grid unharmed.
     //  vp->logTransf();
 
@@ -83,8 +95,8 @@ ParameterOutput::WriteParameters(const Simbox        * simbox,
   if((output_flag & IO::VS) > 0) {
     file_name = prefix+"Vs"+suffix;
 
-    ExpTransf(vs);
-    WriteToFile(simbox, time_depth_mapping, model_settings, vs, file_name, "Inverted Vs");
+    ExpTransf(vs, model_settings);
+    WriteToFile(simbox, time_depth_mapping, model_settings, vs, file_name, "Inverted Vs", false, output_writer);
     //if (sim_num < 0) //prediction, need grid unharmed.
     //  vs->logTransf();
 
@@ -92,8 +104,8 @@ ParameterOutput::WriteParameters(const Simbox        * simbox,
   if((output_flag & IO::RHO) > 0) {
     file_name = prefix+"Rho"+suffix;
 
-    ExpTransf(rho);
-    WriteToFile(simbox, time_depth_mapping, model_settings, rho, file_name, "Inverted density");
+    ExpTransf(rho, model_settings);
+    WriteToFile(simbox, time_depth_mapping, model_settings, rho, file_name, "Inverted density", false, output_writer);
     //if (sim_num < 0) //prediction, need grid unharmed.
     //  rho->logTransf();
 
@@ -106,31 +118,14 @@ ParameterOutput::ComputeAcousticImpedance(const Simbox        * simbox,
                                           const ModelSettings * model_settings,
                                           StormContGrid       * vp,
                                           StormContGrid       * rho,
-                                          const std::string   & file_name)
+                                          const std::string   & file_name,
+                                          OutputWriter        * output_writer)
 {
   StormContGrid * pr_impedance = new StormContGrid(*vp);
 
-  float ijk_a    = 0.0f;
-  float ijk_r    = 0.0f;
-  float comp_val = 0.0f;
-
-  for (size_t i = 0; i < vp->GetNI(); i++) {
-    for (size_t j = 0; j < vp->GetNJ(); j++) {
-      for (size_t k = 0; k < vp->GetNK(); k++) {
+  Evaluate(pr_impedance, exp(GetExpression(vp) + GetExpression(rho)), model_settings);
 
-        ijk_a    = vp->GetValue(i, j, k);
-        ijk_r    = rho->GetValue(i, j, k);
-        comp_val = exp(ijk_a + ijk_r);
-
-        pr_impedance->SetValue(i, j, k, comp_val);
-
-      }
-    }
-  }
-
-  WriteToFile(simbox, time_depth_mapping, model_settings, pr_impedance, file_name, "Acoustic Impedance");
-
-  delete pr_impedance;
+  WriteToFile(simbox, time_depth_mapping, model_settings, pr_impedance, file_name, "Acoustic Impedance", false, output_writer, true);
 }
 
 
@@ -140,31 +135,14 @@ ParameterOutput::ComputeShearImpedance(const Simbox        * simbox,
                                        const ModelSettings * model_settings,
                                        StormContGrid       * vs,
                                        StormContGrid       * rho,
-                                       const std::string   & file_name)
+                                       const std::string   & file_name,
+                                       OutputWriter        * output_writer)
 {
   StormContGrid * sh_impedance = new StormContGrid(*vs);
 
-  float ijk_b    = 0.0f;
-  float ijk_r    = 0.0f;
-  float comp_val = 0.0f;
-
-  for (size_t i = 0; i < vs->GetNI(); i++) {
-    for (size_t j = 0; j < vs->GetNJ(); j++) {
-      for (size_t k = 0; k < vs->GetNK(); k++) {
-
-        ijk_b    = vs->GetValue(i, j, k);
-        ijk_r    = rho->GetValue(i, j, k);
-        comp_val = exp(ijk_b + ijk_r);
-
-        sh_impedance->SetValue(i, j, k, comp_val);
-
-      }
-    }
-  }
-
-  WriteToFile(simbox, time_depth_mapping, model_settings, sh_impedance, file_name, "Shear impedance");
+  Evaluate(sh_impedance, exp(GetExpression(vs) + GetExpression(rho)), model_settings);
 
-  delete sh_impedance;
+  WriteToFile(simbox, time_depth_mapping, model_settings, sh_impedance, file_name, "Shear impedance", false, output_writer, true);
 }
 
 
@@ -174,31 +152,14 @@ ParameterOutput::ComputeVpVsRatio(const Simbox        * simbox,
                                   const ModelSettings * model_settings,
                                   StormContGrid       * vp,
                                   StormContGrid       * vs,
-                                  const std::string   & file_name)
+                                  const std::string   & file_name,
+                                  OutputWriter        * output_writer)
 {
   StormContGrid * ratio_vp_vs = new StormContGrid(*vp);
 
-  float ijk_a    = 0.0f;
-  float ijk_b    = 0.0f;
-  float comp_val = 0.0f;
-
-  for (size_t i = 0; i < vp->GetNI(); i++) {
-    for (size_t j = 0; j < vp->GetNJ(); j++) {
-      for (size_t k = 0; k < vp->GetNK(); k++) {
-
-        ijk_a    = vp->GetValue(i, j, k);
-        ijk_b    = vs->GetValue(i, j, k);
-        comp_val = exp(ijk_a - ijk_b);
-
-        ratio_vp_vs->SetValue(i, j, k, comp_val);
-
-      }
-    }
-  }
+  Evaluate(ratio_vp_vs, exp(GetExpression(vp) - GetExpression(vs)), model_settings);
 
-  WriteToFile(simbox, time_depth_mapping, model_settings, ratio_vp_vs, file_name, "Vp-Vs ratio");
-
-  delete ratio_vp_vs;
+  WriteToFile(simbox, time_depth_mapping, model_settings, ratio_vp_vs, file_name, "Vp-Vs ratio", false, output_writer, true);
 }
 
 void
@@ -207,33 +168,15 @@ ParameterOutput::ComputePoissonRatio(const Simbox        * simbox,
                                      const ModelSettings * model_settings,
                                      StormContGrid       * vp,
                                      StormContGrid       * vs,
-                                     const std::string   & file_name)
+                                     const std::string   & file_name,
+                                     OutputWriter        * output_writer)
 {
   StormContGrid * poi_rat = new StormContGrid(*vp);
 
-  float ijk_a      = 0.0f;
-  float ijk_b      = 0.0f;
-  float comp_val   = 0.0f;
-  float v_ratio_sq = 0.0f;
-
-  for (size_t i = 0; i < vp->GetNI(); i++) {
-    for (size_t j = 0; j < vp->GetNJ(); j++) {
-      for (size_t k = 0; k < vp->GetNK(); k++) {
+  // 0.5*(r - 2)/(r - 1) with r = (vp/vs)^2, written so that r is only computed once.
+  Evaluate(poi_rat, 0.5 - 0.5/(exp(2.0*(GetExpression(vp) - GetExpression(vs))) - 1.0), model_settings);
 
-        ijk_a      = vp->GetValue(i, j, k);
-        ijk_b      = vs->GetValue(i, j, k);
-        v_ratio_sq = exp(2*(ijk_a-ijk_b));
-        comp_val   = static_cast<float>(0.5*(v_ratio_sq - 2)/(v_ratio_sq - 1));
-
-        poi_rat->SetValue(i, j, k, comp_val);
-
-      }
-    }
-  }
-
-  WriteToFile(simbox, time_depth_mapping, model_settings, poi_rat, file_name, "Poisson ratio");
-
-  delete poi_rat;
+  WriteToFile(simbox, time_depth_mapping, model_settings, poi_rat, file_name, "Poisson ratio", false, output_writer, true);
 }
 
 void
@@ -242,31 +185,15 @@ ParameterOutput::ComputeLameMu(const Simbox        * simbox,
                                const ModelSettings * model_settings,
                                StormContGrid       * vs,
                                StormContGrid       * rho,
-                               const std::string   & file_name)
+                               const std::string   & file_name,
+                               OutputWriter        * output_writer)
 {
   StormContGrid * mu = new StormContGrid(*vs);
 
-  float ijk_b    = 0.0f;
-  float ijk_r    = 0.0f;
-  float comp_val = 0.0f;
-
-  for (size_t i = 0; i < vs->GetNI(); i++) {
-    for (size_t j = 0; j < vs->GetNJ(); j++) {
-      for (size_t k = 0; k < vs->GetNK(); k++) {
-
-        ijk_b    = vs->GetValue(i, j, k);
-        ijk_r    = rho->GetValue(i, j, k);
-        comp_val = static_cast<float>(exp(ijk_r+2*ijk_b-13.81551)); // -13.81551 in the exponent divides by 1 000 000
+  // -13.81551 in the exponent divides by 1 000 000
+  Evaluate(mu, exp(GetExpression(rho) + 2.0*GetExpression(vs) - 13.81551), model_settings);
 
-        mu->SetValue(i, j, k, comp_val);
-
-      }
-    }
-  }
-
-  WriteToFile(simbox, time_depth_mapping, model_settings, mu, file_name, "Lame mu");
-
-  delete mu;
+  WriteToFile(simbox, time_depth_mapping, model_settings, mu, file_name, "Lame mu", false, output_writer, true);
 }
 
 void
@@ -276,32 +203,15 @@ ParameterOutput::ComputeLameLambda(const Simbox        * simbox,
                                    StormContGrid       * vp,
                                    StormContGrid       * vs,
                                    StormContGrid       * rho,
-                                   const std::string   & file_name)
+                                   const std::string   & file_name,
+                                   OutputWriter        * output_writer)
 {
   StormContGrid * lambda = new StormContGrid(*vp);
 
-  float ijk_a    = 0.0f;
-  float ijk_b    = 0.0f;
-  float ijk_r    = 0.0f;
-  float comp_val = 0.0f;
-
-  for (size_t i = 0; i < vp->GetNI(); i++) {
-    for (size_t j = 0; j < vp->GetNJ(); j++) {
-      for (size_t k = 0; k < vp->GetNK(); k++) {
-
-        ijk_a    = vp->GetValue(i, j, k);
-        ijk_b    = vs->GetValue(i, j, k);
-        ijk_r    = rho->GetValue(i, j, k);
-        comp_val = static_cast<float>(exp(ijk_r)*(exp(2*ijk_a-13.81551)-2*exp(2*ijk_b-13.81551))); // -13.81551 in the exponent divides by 1 000 000
+  // -13.81551 in the exponent divides by 1 000 000
+  Evaluate(lambda, exp(GetExpression(rho))*(exp(2.0*GetExpression(vp) - 13.81551) - 2.0*exp(2.0*GetExpression(vs) - 13.81551)), model_settings);
 
-        lambda->SetValue(i, j, k, comp_val);
-      }
-    }
-  }
-
-  WriteToFile(simbox, time_depth_mapping, model_settings, lambda, file_name, "Lame lambda");
-
-  delete lambda;
+  WriteToFile(simbox, time_depth_mapping, model_settings, lambda, file_name, "Lame lambda", false, output_writer, true);
 }
 
 void
@@ -311,33 +221,15 @@ ParameterOutput::ComputeLambdaRho(const Simbox        * simbox,
                                   StormContGrid       * vp,
                                   StormContGrid       * vs,
                                   StormContGrid       * rho,
-                                  const std::string   & file_name)
+                                  const std::string   & file_name,
+                                  OutputWriter        * output_writer)
 {
   StormContGrid * lambda_rho = new StormContGrid(*vp);
 
-  float ijk_a    = 0.0f;
-  float ijk_b    = 0.0f;
-  float ijk_r    = 0.0f;
-  float comp_val = 0.0f;
-
-  for (size_t i = 0; i < vp->GetNI(); i++) {
-    for (size_t j = 0; j < vp->GetNJ(); j++) {
-      for (size_t k = 0; k < vp->GetNK(); k++) {
-
-        ijk_a    = vp->GetValue(i, j, k);
-        ijk_b    = vs->GetValue(i, j, k);
-        ijk_r    = rho->GetValue(i, j, k);
-        comp_val = static_cast<float>(exp(2.0*(ijk_a +ijk_r)-13.81551)-2.0*exp(2.0*(ijk_b +ijk_r)-13.81551)); // -13.81551 in the exponent divides by 1e6=(1 000 000)
-
-        lambda_rho->SetValue(i, j, k, comp_val);
-
-      }
-    }
-  }
-
-  WriteToFile(simbox, time_depth_mapping, model_settings, lambda_rho, file_name, "Lambda rho");
+  // -13.81551 in the exponent divides by 1e6=(1 000 000)
+  Evaluate(lambda_rho, exp(2.0*(GetExpression(vp) + GetExpression(rho)) - 13.81551) - 2.0*exp(2.0*(GetExpression(vs) + GetExpression(rho)) - 13.81551), model_settings);
 
-  delete lambda_rho;
+  WriteToFile(simbox, time_depth_mapping, model_settings, lambda_rho, file_name, "Lambda rho", false, output_writer, true);
 }
 
 void
@@ -347,31 +239,16 @@ ParameterOutput::ComputeMuRho(const Simbox        * simbox,
                               StormContGrid       * vp,
                               StormContGrid       * vs,
                               StormContGrid       * rho,
-                              const std::string   & file_name)
+                              const std::string   & file_name,
+                              OutputWriter        * output_writer)
 {
   StormContGrid * mu_rho;
   mu_rho = new StormContGrid(*vp);
 
-  float ijk_b    = 0.0f;
-  float ijk_r    = 0.0f;
-  float comp_val = 0.0f;
-  for (size_t i = 0; i < vp->GetNI(); i++) {
-    for (size_t j = 0; j < vp->GetNJ(); j++) {
-      for (size_t k = 0; k < vp->GetNK(); k++) {
-
-        ijk_b    = vs->GetValue(i,j,k);
-        ijk_r    = rho->GetValue(i,j,k);
-        comp_val = static_cast<float>(exp(2.0*(ijk_b +ijk_r)-13.81551)); // -13.81551 in the exponent divides by 1e6=(1 000 000)
-
-        mu_rho->SetValue(i,j,k, comp_val);
-
-      }
-    }
-  }
+  // -13.81551 in the exponent divides by 1e6=(1 000 000)
+  Evaluate(mu_rho, exp(2.0*(GetExpression(vs) + GetExpression(rho)) - 13.81551), model_settings);
 
-  WriteToFile(simbox, time_depth_mapping, model_settings, mu_rho, file_name, "Mu rho");
-
-  delete mu_rho;
+  WriteToFile(simbox, time_depth_mapping, model_settings, mu_rho, file_name, "Mu rho", false, output_writer, true);
 }
 
 //FFTGrid*
@@ -425,12 +302,28 @@ ParameterOutput::WriteToFile(const Simbox        * simbox,
                              StormContGrid       * grid,
                              const std::string   & file_name,
                              const std::string   & sgri_label,
-                             bool                  padding)
+                             bool                  padding,
+                             OutputWriter        * output_writer,
+                             bool                  delete_when_written)
 {
 
   float seismic_start_time   = 0.0; //Hack for Sebastian, was: model->getModelSettings()->getSegyOffset();
   TraceHeaderFormat * format = model_settings->getTraceHeaderFormatOutput();
 
+  if (output_writer != NULL) {
+    output_writer->AddStormGrid(grid,
+                                delete_when_written,
+                                file_name,
+                                IO::PathToInversionResults(),
+                                simbox,
+                                false,
+                                sgri_label,
+                                seismic_start_time,
+                                time_depth_mapping,
+                                *format);
+    return;
+  }
+
   WriteFile(model_settings,
             grid,
             file_name,
@@ -442,26 +335,17 @@ ParameterOutput::WriteToFile(const Simbox        * simbox,
             time_depth_mapping,
             *format,
             padding);
+
+  if (delete_when_written)
+    delete grid;
 }
 
 void
-ParameterOutput::ExpTransf(StormContGrid * grid)
+ParameterOutput::ExpTransf(StormContGrid       * grid,
+                           const ModelSettings * model_settings)
 {
-  float value = 0.0f;
-  for (size_t i = 0; i < grid->GetNI(); i++) {
-    for (size_t j = 0; j < grid->GetNJ(); j++) {
-      for (size_t k = 0; k < grid->GetNK(); k++) {
-
-        value = grid->GetValue(i, j, k);
-
-        if (value != RMISSING) {
-          value = exp(value);
-          grid->SetValue(i, j, k, value);
-        }
-
-      }
-    }
-  }
+  // Missing values are kept as they are
+  Evaluate(grid, exp(GetExpression(grid)), model_settings);
 }
 
 void
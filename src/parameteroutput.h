@@ -8,6 +8,7 @@
 #include <string>
 
 #include "src/definitions.h"
+#include "src/gridexpression.h"
 #include "libs/fft/include/fftw.h"
 
 //class FFTFileGrid;
@@ -15,6 +16,7 @@
 class Simbox;
 class ModelSettings;
 class GridMapping;
+class OutputWriter;
 
 class ParameterOutput
 {
@@ -22,6 +24,7 @@ public:
   //Conventions for writeParameters:
   // simNum = -1 indicates prediction, otherwise filename ends with n+1.
   // All grids are in normal domain, and on log scale.
+  // With an output_writer, the grids are queued there, and vp, vs and rho must be kept until it is flushed.
   static void      WriteParameters(const Simbox        * simbox,
                                    GridMapping         * time_depth_mapping,
                                    const ModelSettings * model_settings,
@@ -30,15 +33,19 @@ public:
                                    StormContGrid       * rho,
                                    int                   output_flag,
                                    int                   sim_num,
-                                   bool                  kriged);
+                                   bool                  kriged,
+                                   OutputWriter        * output_writer = NULL);
 
+  // If delete_when_written is set, grid is deleted here or by output_writer.
   static void      WriteToFile(const Simbox        * simbox,
                                GridMapping         * time_depth_mapping,
                                const ModelSettings * model_settings,
                                StormContGrid       * grid,
                                const std::string   & file_name,
                                const std::string   & sgri_label,
-                               bool                  padding = false);
+                               bool                  padding             = false,
+                               OutputWriter        * output_writer       = NULL,
+                               bool                  delete_when_written = false);
 
   //static void      WriteToFile(const Simbox        * simbox,
   //                             GridMapping         * time_depth_mapping,
@@ -69,35 +76,40 @@ private:
                                             const ModelSettings * model_settings,
                                             StormContGrid       * vp,
                                             StormContGrid       * rho,
-                                            const std::string   & file_name);
+                                            const std::string   & file_name,
+                                            OutputWriter        * output_writer);
 
   static void      ComputeShearImpedance(const Simbox        * simbox,
                                          GridMapping         * time_depth_mapping,
                                          const ModelSettings * model_settings,
                                          StormContGrid       * vs,
                                          StormContGrid       * rho,
-                                         const std::string   & file_name);
+                                         const std::string   & file_name,
+                                         OutputWriter        * output_writer);
 
   static void     ComputeVpVsRatio(const Simbox        * simbox,
                                    GridMapping         * time_depth_mapping,
                                    const ModelSettings * model_settings,
                                    StormContGrid       * vp,
                                    StormContGrid       * vs,
-                                   const std::string   & file_name);
+                                   const std::string   & file_name,
+                                   OutputWriter        * output_writer);
 
   static void      ComputePoissonRatio(const Simbox        * simbox,
                                        GridMapping         * time_depth_mapping,
                                        const ModelSettings * model_settings,
                                        StormContGrid       * vp,
                                        StormContGrid       * vs,
-                                       const std::string   & file_name);
+                                       const std::string   & file_name,
+                                       OutputWriter        * output_writer);
 
   static void      ComputeLameMu(const Simbox        * simbox,
                                  GridMapping         * time_depth_mapping,
                                  const ModelSettings * model_settings,
                                  StormContGrid       * vs,
                                  StormContGrid       * rho,
-                                 const std::string   & file_name);
+                                 const std::string   & file_name,
+                                 OutputWriter        * output_writer);
 
   static void      ComputeLameLambda(const Simbox        * simbox,
                                      GridMapping         * time_depth_mapping,
@@ -105,7 +117,8 @@ private:
                                      StormContGrid       * vp,
                                      StormContGrid       * vs,
                                      StormContGrid       * rho,
-                                     const std::string   & file_name);
+                                     const std::string   & file_name,
+                                     OutputWriter        * output_writer);
 
   static void      ComputeMuRho(const Simbox        * simbox,
                                 GridMapping         * time_depth_mapping,
@@ -113,7 +126,8 @@ private:
                                 StormContGrid       * vp,
                                 StormContGrid       * vs,
                                 StormContGrid       * rho,
-                                const std::string   & file_name);
+                                const std::string   & file_name,
+                                OutputWriter        * output_writer);
 
   static void      ComputeLambdaRho(const Simbox        * simbox,
                                     GridMapping         * time_depth_mapping,
@@ -121,11 +135,20 @@ private:
                                     StormContGrid       * vp,
                                     StormContGrid       * vs,
                                     StormContGrid       * rho,
-                                    const std::string   & file_name);
+                                    const std::string   & file_name,
+                                    OutputWriter        * output_writer);
 
   //static FFTGrid * createFFTGrid(FFTGrid * referenceGrid, bool fileGrid);
 
-  static void      ExpTransf(StormContGrid * grid);
+  static void      ExpTransf(StormContGrid       * grid,
+                             const ModelSettings * model_settings);
+
+  static GridExpression<RealGridLeaf> GetExpression(const StormContGrid * grid) { return makeGridExpression(&(*grid)(0)) ;}
+
+  template <class E>
+  static void      Evaluate(StormContGrid             * result,
+                            const GridExpression<E>   & expr,
+                            const ModelSettings       * model_settings);
 
   static void      WriteResampledStormCube(const StormContGrid * storm_grid,
                                            const GridMapping   * gridmapping,
@@ -414,14 +414,7 @@ SeismicParametersHolder::invFFTAllGrids()
 {
   LogKit::LogFormatted(LogKit::High,"\nBacktransforming background grids from FFT domain to time domain...");
 
-  if(meanVp_->getIsTransformed())
-    meanVp_->invFFTInPlace();
-
-  if(meanVs_->getIsTransformed())
-    meanVs_->invFFTInPlace();
-
-  if(meanRho_->getIsTransformed())
-    meanRho_->invFFTInPlace();
+  FFTGrid::invFFTAllInPlace(getMeanGrids());
   LogKit::LogFormatted(LogKit::High,"...done\n");
 
   invFFTCovGrids();
@@ -433,14 +426,7 @@ SeismicParametersHolder::FFTAllGrids()
 {
   LogKit::LogFormatted(LogKit::High,"\nTransforming background grids from time domain to FFT domain ...");
 
-  if(!meanVp_->getIsTransformed())
-    meanVp_->fftInPlace();
-
-  if(!meanVs_->getIsTransformed())
-    meanVs_->fftInPlace();
-
-  if(!meanRho_->getIsTransformed())
-    meanRho_->fftInPlace();
+  FFTGrid::fftAllInPlace(getMeanGrids());
   LogKit::LogFormatted(LogKit::High,"...done\n");
 
   FFTCovGrids();
@@ -453,23 +439,7 @@ SeismicParametersHolder::invFFTCovGrids()
 {
   LogKit::LogFormatted(LogKit::High,"\nBacktransforming correlation grids from FFT domain to time domain...");
 
-  if (covVp_->getIsTransformed())
-    covVp_->invFFTInPlace();
-
-  if (covVs_->getIsTransformed())
-    covVs_->invFFTInPlace();
-
-  if (covRho_->getIsTransformed())
-    covRho_->invFFTInPlace();
-
-  if (crCovVpVs_->getIsTransformed())
-    crCovVpVs_->invFFTInPlace();
-
-  if (crCovVpRho_->getIsTransformed())
-    crCovVpRho_->invFFTInPlace();
-
-  if (crCovVsRho_->getIsTransformed())
-    crCovVsRho_->invFFTInPlace();
+  FFTGrid::invFFTAllInPlace(getCovGrids());
 
   LogKit::LogFormatted(LogKit::High,"...done\n");
 }
@@ -479,32 +449,78 @@ SeismicParametersHolder::FFTCovGrids()
 {
   LogKit::LogFormatted(LogKit::High,"\nTransforming correlation grids in seismic parameters holder from time domain to FFT domain...");
 
-  if (!covVp_->getIsTransformed())
-    covVp_->fftInPlace();
+  FFTGrid::fftAllInPlace(getCovGrids());
 
-  if (!covVs_->getIsTransformed())
-    covVs_->fftInPlace();
-
-  if (!covRho_->getIsTransformed())
-    covRho_->fftInPlace();
+  LogKit::LogFormatted(LogKit::High,"...done\n");
+}
 
-  if (!crCovVpVs_->getIsTransformed())
-    crCovVpVs_->fftInPlace();
+//--------------------------------------------------------------------
+std::vector<FFTGrid *>
+SeismicParametersHolder::getMeanGrids() const
+{
+  std::vector<FFTGrid *> grids(3);
+  grids[0] = meanVp_;
+  grids[1] = meanVs_;
+  grids[2] = meanRho_;
+  return grids;
+}
 
-  if (!crCovVpRho_->getIsTransformed())
-    crCovVpRho_->fftInPlace();
+//--------------------------------------------------------------------
+std::vector<FFTGrid *>
+SeismicParametersHolder::getCovGrids() const
+{
+  std::vector<FFTGrid *> grids(6);
+  grids[0] = covVp_;
+  grids[1] = covVs_;
+  grids[2] = covRho_;
+  grids[3] = crCovVpVs_;
+  grids[4] = crCovVpRho_;
+  grids[5] = crCovVsRho_;
+  return grids;
+}
 
-  if (!crCovVsRho_->getIsTransformed())
-    crCovVsRho_->fftInPlace();
+//--------------------------------------------------------------------------------------------------
+void
+SeismicParametersHolder::getNextParameterCovariance(fftw_complex **& parVar) const
+{
+  fftw_complex iiTmp = covVp_     ->getNextComplex();
+  fftw_complex jjTmp = covVs_     ->getNextComplex();
+  fftw_complex kkTmp = covRho_    ->getNextComplex();
+  fftw_complex ijTmp = crCovVpVs_ ->getNextComplex();
+  fftw_complex ikTmp = crCovVpRho_->getNextComplex();
+  fftw_complex jkTmp = crCovVsRho_->getNextComplex();
 
-  LogKit::LogFormatted(LogKit::High,"...done\n");
+  setParameterCovariance(parVar, iiTmp, jjTmp, kkTmp, ijTmp, ikTmp, jkTmp);
 }
 
 //--------------------------------------------------------------------------------------------------
 void
-SeismicParametersHolder::getNextParameterCovariance(fftw_complex **& parVar) const
+SeismicParametersHolder::getParameterCovariance(fftw_complex **& parVar,
+                                                int              i,
+                                                int              j,
+                                                int              k) const
 {
+  // Random access version of getNextParameterCovariance(). Requires grids held in memory.
+  fftw_complex iiTmp = covVp_     ->getComplexValue(i, j, k, true);
+  fftw_complex jjTmp = covVs_     ->getComplexValue(i, j, k, true);
+  fftw_complex kkTmp = covRho_    ->getComplexValue(i, j, k, true);
+  fftw_complex ijTmp = crCovVpVs_ ->getComplexValue(i, j, k, true);
+  fftw_complex ikTmp = crCovVpRho_->getComplexValue(i, j, k, true);
+  fftw_complex jkTmp = crCovVsRho_->getComplexValue(i, j, k, true);
+
+  setParameterCovariance(parVar, iiTmp, jjTmp, kkTmp, ijTmp, ikTmp, jkTmp);
+}
 
+//--------------------------------------------------------------------------------------------------
+void
+SeismicParametersHolder::setParameterCovariance(fftw_complex **& parVar,
+                                                fftw_complex     iiTmp,
+                                                fftw_complex     jjTmp,
+                                                fftw_complex     kkTmp,
+                                                fftw_complex     ijTmp,
+                                                fftw_complex     ikTmp,
+                                                fftw_complex     jkTmp) const
+{
   fftw_complex ii;
   fftw_complex jj;
   fftw_complex kk;
@@ -512,13 +528,6 @@ SeismicParametersHolder::getNextParameterCovariance(fftw_complex **& parVar) con
   fftw_complex ik;
   fftw_complex jk;
 
-  fftw_complex iiTmp = covVp_     ->getNextComplex();
-  fftw_complex jjTmp = covVs_     ->getNextComplex();
-  fftw_complex kkTmp = covRho_    ->getNextComplex();
-  fftw_complex ijTmp = crCovVpVs_ ->getNextComplex();
-  fftw_complex ikTmp = crCovVpRho_->getNextComplex();
-  fftw_complex jkTmp = crCovVsRho_->getNextComplex();
-
   if(priorVar0_(0,0) != 0)
     iiTmp.re = iiTmp.re / static_cast<float>(priorVar0_(0,0));
 
@@ -168,6 +168,11 @@ public:
 
   void                          getNextParameterCovariance(fftw_complex **& parVar) const;
 
+  void                          getParameterCovariance(fftw_complex **& parVar,
+                                                       int              i,
+                                                       int              j,
+                                                       int              k) const;
+
   void                          writeFilePriorVariances(const ModelSettings      * modelSettings,
                                                         const std::vector<float> & priorCorrT,
                                                         const Surface            * priorCorrXY,
@@ -193,8 +198,19 @@ public:
   void                          releaseExpGrids() const;
 
 private:
+  void                          setParameterCovariance(fftw_complex **& parVar,
+                                                       fftw_complex     iiTmp,
+                                                       fftw_complex     jjTmp,
+                                                       fftw_complex     kkTmp,
+                                                       fftw_complex     ijTmp,
+                                                       fftw_complex     ikTmp,
+                                                       fftw_complex     jkTmp) const;
+
   void                          createCorrGrids(int nx, int ny, int nz, int nxp, int nyp, int nzp, bool fileGrid);
 
+  std::vector<FFTGrid *>        getMeanGrids() const;
+  std::vector<FFTGrid *>        getCovGrids() const;
+
   void                          InitializeCorrelations(bool                                  cov_estimated,
                                                        const Surface                       * priorCorrXY,
                                                        const std::vector<NRLib::Matrix>    & auto_cov,
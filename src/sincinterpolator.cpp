@@ -0,0 +1,73 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include "nrlib/math/constants.hpp"
+
+#include "src/sincinterpolator.h"
+
+SincInterpolator::SincInterpolator()
+  : table_((N_PHASES + 1)*2*HALF_WIDTH)
+{
+  const double beta  = 6.5;  // Kaiser window shape. Accurate to 1e-3 up to about 70% of Nyquist.
+  const double scale = 1.0/besselI0(beta);
+
+  for (int p = 0; p <= N_PHASES; p++) {
+    double frac = static_cast<double>(p)/static_cast<double>(N_PHASES);
+    float * w   = &table_[p*2*HALF_WIDTH];
+    double  sum = 0.0;
+    for (int m = 0; m < 2*HALF_WIDTH; m++) {
+      double x    = frac + HALF_WIDTH - 1 - m;   // Distance from sample to interpolation point
+      double r    = x/HALF_WIDTH;
+      double sinc = (x == 0.0 ? 1.0 : sin(NRLib::Pi*x)/(NRLib::Pi*x));
+      double win  = (r*r < 1.0 ? scale*besselI0(beta*sqrt(1.0 - r*r)) : 0.0);
+      w[m]        = static_cast<float>(sinc*win);
+      sum        += w[m];
+    }
+    for (int m = 0; m < 2*HALF_WIDTH; m++) // Reproduce a constant exactly
+      w[m] = static_cast<float>(w[m]/sum);
+  }
+}
+
+float
+SincInterpolator::interpolate(const float * data,
+                              int           n,
+                              double        t) const
+{
+  int i0 = static_cast<int>(floor(t));
+  if (i0 + HALF_WIDTH < 0 || i0 - HALF_WIDTH + 1 > n - 1)
+    return(0.0f);
+
+  double p  = (t - i0)*N_PHASES;
+  int    ip = std::min(static_cast<int>(p), N_PHASES - 1);
+  float  a  = static_cast<float>(p - ip);
+
+  const float * w0 = &table_[ip*2*HALF_WIDTH];
+  const float * w1 = w0 + 2*HALF_WIDTH;
+
+  int first = i0 - HALF_WIDTH + 1;
+  int mMin  = std::max(0, -first);
+  int mMax  = std::min(2*HALF_WIDTH, n - first);
+
+  float value = 0.0f;
+  for (int m = mMin; m < mMax; m++)
+    value += (w0[m] + a*(w1[m] - w0[m]))*data[first + m];
+  return(value);
+}
+
+double
+SincInterpolator::besselI0(double x)
+{
+  // Power series, which converges quickly for the arguments used here
+  double sum  = 1.0;
+  double term = 1.0;
+  double y    = 0.25*x*x;
+  for (int k = 1; k < 50 && term > 1.0e-12*sum; k++) {
+    term *= y/(static_cast<double>(k)*static_cast<double>(k));
+    sum  += term;
+  }
+  return(sum);
+}
@@ -0,0 +1,39 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef SINCINTERPOLATOR_H
+#define SINCINTERPOLATOR_H
+
+#include <vector>
+
+// Band-limited interpolation of regularly sampled traces with a Kaiser windowed
+// sinc kernel. The kernel is tabulated for a set of fractional sample offsets
+// once, and weights in between are found by linear interpolation in the table.
+// Samples outside the trace are taken to be zero.
+//
+// The interpolator keeps no state besides the table, so one object may be used
+// by several threads at the same time.
+
+class SincInterpolator
+{
+public:
+  SincInterpolator();
+
+  /// Value at fractional sample position t of the band-limited function through data[0..n-1].
+  float interpolate(const float * data,
+                    int           n,
+                    double        t) const;
+
+  static int getHalfWidth(void) { return HALF_WIDTH ;}
+
+private:
+  static const int HALF_WIDTH = 8;   // Samples used on each side of the interpolation point
+  static const int N_PHASES   = 256; // Number of tabulated fractional offsets
+
+  static double besselI0(double x);
+
+  std::vector<float> table_;         // (N_PHASES + 1) rows of 2*HALF_WIDTH weights
+};
+
+#endif
@@ -0,0 +1,107 @@
+/***************************************************************************
+*      Copyright (C) 2008 by Norwegian Computing Center and Statoil        *
+***************************************************************************/
+
+#ifndef SMALLCOMPLEXMATRIX_H
+#define SMALLCOMPLEXMATRIX_H
+
+#include <math.h>
+
+#include "fftw.h"
+
+// Complex matrix kernels for matrices whose dimensions are known at compile time,
+// stored as plain arrays on the stack. They replace the lib_matr*Cpx functions in
+// per-cell loops, where the fftw_complex** matrices of lib_matr must be heap
+// allocated and all loops have runtime bounds.
+//
+// Each function does the same floating point operations in the same order as the
+// lib_matr function it is named after, so results are identical to lib_matr.
+
+class SmallComplexMatrix
+{
+public:
+  /// As lib_matrCholCpx: L*L' factorization of a Hermitian positive definite matrix.
+  /// L is written to the lower triangle. Returns 0 if ok, 1 if the matrix is not valid.
+  template <int N>
+  static int  cholesky(fftw_complex (&x)[N][N]);
+
+  /// As lib_matrProdCholVec: vec = L*vec
+  template <int N>
+  static void prodCholVec(const fftw_complex (&L)[N][N], fftw_complex * vec);
+
+private:
+  SmallComplexMatrix();
+};
+
+template <int N>
+int
+SmallComplexMatrix::cholesky(fftw_complex (&x)[N][N])
+{
+  float factor = x[0][0].re;
+  if (factor <= 0)
+    return(1);
+
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      x[i][j].re = x[i][j].re/factor;
+      x[i][j].im = x[i][j].im/factor;
+    }
+  }
+
+  const double tol = 1e-20;
+  for (int i = 0; i < N; i++) {
+    if (x[i][i].re <= tol)
+      return(1);
+
+    fftw_complex r;
+    for (int j = 0; j < i; j++) {
+      r.re = 0.0;
+      r.im = 0.0;
+      for (int k = 0; k < j; k++) {
+        r.re +=  (x[i][k].re * x[j][k].re) + (x[i][k].im * x[j][k].im);
+        r.im += -(x[i][k].re * x[j][k].im) + (x[i][k].im * x[j][k].re);
+      }
+      float help = x[j][j].re*x[j][j].re + x[j][j].im*x[j][j].im;
+      // As in lib_matrCholCpx, the imaginary part is computed from the updated real part.
+      x[i][j].re = ((x[i][j].re - r.re)*x[j][j].re + (x[i][j].im - r.im)*x[j][j].im)/help;
+      x[i][j].im = ((x[i][j].im - r.im)*x[j][j].re - (x[i][j].re - r.re)*x[j][j].im)/help;
+    }
+    r.re = 0.0;
+    for (int k = 0; k < i; k++)
+      r.re += (x[i][k].re * x[i][k].re) + (x[i][k].im * x[i][k].im);
+    r.re = x[i][i].re - r.re;
+    if (r.re <= tol)
+      return(1);
+
+    x[i][i].re = static_cast<float>(sqrt(r.re));
+    x[i][i].im = 0.0;
+  }
+
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j <= i; j++) {
+      x[i][j].re *= static_cast<float>(sqrt(factor));
+      x[i][j].im *= static_cast<float>(sqrt(factor));
+    }
+  }
+  return(0);
+}
+
+template <int N>
+void
+SmallComplexMatrix::prodCholVec(const fftw_complex (&L)[N][N], fftw_complex * vec)
+{
+  fftw_complex in[N];
+  for (int i = 0; i < N; i++) {
+    in[i]      = vec[i];
+    vec[i].re  = 0.0;
+    vec[i].im  = 0.0;
+  }
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < i + 1; j++) {
+      vec[i].re += L[i][j].re * in[j].re - L[i][j].im * in[j].im;
+      vec[i].im += L[i][j].re * in[j].im + L[i][j].im * in[j].re;
+    }
+  }
+}
+
+#endif
@@ -1030,52 +1030,59 @@ State4D::allGridsAreTransformed()
 void
 State4D::FFT()
 {
-  for(int i = 0; i<3; i++)
-    mu_static_[i]->fftInPlace();
-  for(int i = 0; i<3; i++)
-    mu_dynamic_[i]->fftInPlace();
-  for(int i = 0; i<6; i++)
-    sigma_static_static_[i]->fftInPlace();
-  for(int i = 0; i<6; i++)
-    sigma_dynamic_dynamic_[i]->fftInPlace();
-  for(int i = 0; i<9; i++)
-    sigma_static_dynamic_[i]->fftInPlace();
+  std::vector<FFTGrid *> grids = getMeanGrids();
+  std::vector<FFTGrid *> cov   = getCovGrids();
+  grids.insert(grids.end(), cov.begin(), cov.end());
+  for(size_t i = 0; i<grids.size(); i++)
+    assert(grids[i]->getIsTransformed()==false);
+  FFTGrid::fftAllInPlace(grids);
 }
 
 void
 State4D::iFFT()
 {
-  for(int i = 0; i<3; i++)
-    mu_static_[i]->invFFTInPlace();
-  for(int i = 0; i<3; i++)
-    mu_dynamic_[i]->invFFTInPlace();
-  for(int i = 0; i<6; i++)
-    sigma_static_static_[i]->invFFTInPlace();
-  for(int i = 0; i<6; i++)
-    sigma_dynamic_dynamic_[i]->invFFTInPlace();
-  for(int i = 0; i<9; i++)
-    sigma_static_dynamic_[i]->invFFTInPlace();
+  std::vector<FFTGrid *> grids = getMeanGrids();
+  std::vector<FFTGrid *> cov   = getCovGrids();
+  grids.insert(grids.end(), cov.begin(), cov.end());
+  for(size_t i = 0; i<grids.size(); i++)
+    assert(grids[i]->getIsTransformed()==true);
+  FFTGrid::invFFTAllInPlace(grids);
 }
 
 
 void
 State4D::iFFTMean()
 {
-  for(int i = 0; i<3; i++)
-    mu_static_[i]->invFFTInPlace();
-  for(int i = 0; i<3; i++)
-    mu_dynamic_[i]->invFFTInPlace();
+  std::vector<FFTGrid *> grids = getMeanGrids();
+  for(size_t i = 0; i<grids.size(); i++)
+    assert(grids[i]->getIsTransformed()==true);
+  FFTGrid::invFFTAllInPlace(grids);
 }
 
 void
 State4D::iFFTCov()
 {
-  for(int i = 0; i<6; i++)
-    sigma_static_static_[i]->invFFTInPlace();
-  for(int i = 0; i<6; i++)
-    sigma_dynamic_dynamic_[i]->invFFTInPlace();
-  for(int i = 0; i<9; i++)
-    sigma_static_dynamic_[i]->invFFTInPlace();
+  std::vector<FFTGrid *> grids = getCovGrids();
+  for(size_t i = 0; i<grids.size(); i++)
+    assert(grids[i]->getIsTransformed()==true);
+  FFTGrid::invFFTAllInPlace(grids);
+}
+
+std::vector<FFTGrid *>
+State4D::getMeanGrids() const
+{
+  std::vector<FFTGrid *> grids(mu_static_);
+  grids.insert(grids.end(), mu_dynamic_.begin(), mu_dynamic_.end());
+  return grids;
+}
+
+std::vector<FFTGrid *>
+State4D::getCovGrids() const
+{
+  std::vector<FFTGrid *> grids(sigma_static_static_);
+  grids.insert(grids.end(), sigma_dynamic_dynamic_.begin(), sigma_dynamic_dynamic_.end());
+  grids.insert(grids.end(), sigma_static_dynamic_.begin(), sigma_static_dynamic_.end());
+  return grids;
 }
 
 
@@ -100,6 +100,8 @@ public:
 
 private:
   bool allGridsAreTransformed();
+  std::vector<FFTGrid *> getMeanGrids() const;
+  std::vector<FFTGrid *> getCovGrids() const;
   FFTGrid *              velocity_relative_to_base_;  //  V_current/V_initial
   std::vector<FFTGrid *> mu_static_;            // [0] = vp, [1] = vs, [2] = rho
   std::vector<FFTGrid *> mu_dynamic_;           // [0] = vp, [1] = vs, [2] = rho
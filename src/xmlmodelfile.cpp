@@ -246,6 +246,7 @@ XmlModelFile::parseSimulation(TiXmlNode * node, std::string & errTxt)
   legalCommands.push_back("seed");
   legalCommands.push_back("seed-file");
   legalCommands.push_back("number-of-simulations");
+  legalCommands.push_back("precompute-cholesky-factors");
 
   int seed;
   bool seedGiven = parseValue(root, "seed", seed, errTxt);
@@ -267,6 +268,10 @@ XmlModelFile::parseSimulation(TiXmlNode * node, std::string & errTxt)
   else
     modelSettings_->setNumberOfSimulations(1);
 
+  bool precompute;
+  if(parseBool(root, "precompute-cholesky-factors", precompute, errTxt) == true)
+    modelSettings_->setPrecomputeCholesky(precompute);
+
   checkForJunk(root, errTxt, legalCommands);
   return(true);
 }
@@ -5504,6 +5509,17 @@ XmlModelFile::parseAdvancedSettings(TiXmlNode * node, std::string & errTxt)
   legalCommands.push_back("vp-vs-ratio");
   legalCommands.push_back("vp-vs-ratio-from-wells");
   legalCommands.push_back("use-intermediate-disk-storage");
+  legalCommands.push_back("use-memory-mapped-grids");
+  legalCommands.push_back("compress-idle-grids");
+  legalCommands.push_back("compress-crava-grids");
+  legalCommands.push_back("use-segy-index");
+  legalCommands.push_back("segy-index-directory");
+  legalCommands.push_back("use-fft-resampling");
+  legalCommands.push_back("disk-storage-fft-memory");
+  legalCommands.push_back("memory-budget");
+  legalCommands.push_back("measure-fft-plans");
+  legalCommands.push_back("use-fft-wisdom");
+  legalCommands.push_back("parallel-fft");
   legalCommands.push_back("maximum-relative-thickness-difference");
   legalCommands.push_back("frequency-band");
   legalCommands.push_back("energy-threshold");
@@ -5550,6 +5566,58 @@ XmlModelFile::parseAdvancedSettings(TiXmlNode * node, std::string & errTxt)
   if(parseBool(root, "use-intermediate-disk-storage", fileGrid, errTxt) == true)
     modelSettings_->setFileGrid(fileGrid);
 
+  bool memoryMapped;
+  if(parseBool(root, "use-memory-mapped-grids", memoryMapped, errTxt) == true)
+    modelSettings_->setMemoryMappedGrids(memoryMapped);
+
+  bool compressIdle;
+  if(parseBool(root, "compress-idle-grids", compressIdle, errTxt) == true)
+    modelSettings_->setCompressIdleGrids(compressIdle);
+
+  bool compressCrava;
+  if(parseBool(root, "compress-crava-grids", compressCrava, errTxt) == true)
+    modelSettings_->setCompressCravaGrids(compressCrava);
+
+  bool useSegyIndex;
+  if(parseBool(root, "use-segy-index", useSegyIndex, errTxt) == true)
+    modelSettings_->setUseSegyIndex(useSegyIndex);
+
+  std::string segyIndexDir;
+  if(parseValue(root, "segy-index-directory", segyIndexDir, errTxt) == true)
+    modelSettings_->setSegyIndexDirectory(segyIndexDir);
+
+  bool useFFTResampling;
+  if(parseBool(root, "use-fft-resampling", useFFTResampling, errTxt) == true)
+    modelSettings_->setUseFFTResampling(useFFTResampling);
+
+  int fftMemory = 0;
+  if(parseValue(root, "disk-storage-fft-memory", fftMemory, errTxt) == true) {
+    if(fftMemory > 0)
+      modelSettings_->setDiskStorageFFTMemory(fftMemory);
+    else
+      errTxt += "The memory used for FFTs with intermediate disk storage must be larger than zero\n";
+  }
+
+  int memoryBudget = 0;
+  if(parseValue(root, "memory-budget", memoryBudget, errTxt) == true) {
+    if(memoryBudget > 0)
+      modelSettings_->setMemoryBudget(memoryBudget);
+    else
+      errTxt += "The memory budget must be larger than zero\n";
+  }
+
+  bool measurePlans;
+  if(parseBool(root, "measure-fft-plans", measurePlans, errTxt) == true)
+    modelSettings_->setMeasureFFTPlans(measurePlans);
+
+  bool useWisdom;
+  if(parseBool(root, "use-fft-wisdom", useWisdom, errTxt) == true)
+    modelSettings_->setUseFFTWisdom(useWisdom);
+
+  bool parallelFFT;
+  if(parseBool(root, "parallel-fft", parallelFFT, errTxt) == true)
+    modelSettings_->setParallelFFT(parallelFFT);
+
   double limit;
   if(parseValue(root,"maximum-relative-thickness-difference", limit, errTxt) == true)
     modelSettings_->setLzLimit(limit);